@@ -1,705 +1,8569 @@
-/*
-  Naziv programa:  FTTH/GPON Simulator
-
-Program:
-    - čita datoteku sa topologijom optičke mreže (OLT-SPLITTER-ONT)
-    - računa optičke gubitke i RX snagu za svaki ONT (za svakog korisnika)
-    - sakuplja i grupira statistiku po splitteru
-    - stvara datoteke ont_results.csv i splitter_results.csv iz kojih dobivamo vizualini prikaz pomoću grafova
-    - stvara datoteku report.txt kojom izvještava status optičke mreže
-*/
-
-#define _CRT_SECURE_NO_WARNINGS
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <math.h>
-
-#define MAX_ONT 1024
-#define TOP_N   5
-
-typedef enum { NODE_OLT, 
-    NODE_SPLITTER, 
-    NODE_ONT 
-} NodeType;
-
-typedef struct Node {
-    NodeType type;
-
-    // Link parametri od roditelja
-    double len_km;
-    int connectors;
-    int splices;
-
-    // Splitter parametri
-    int splitter_ratio;         // npr. 8/16/32/64 dijelitelja
-    char name[64];              
-
-    // ONT parametri
-    int ont_id;
-
-    // OLT parametri
-    double olt_tx_dbm;          // snaga pokretanja
-    double gpon_rxmin_dbm;      // minimalna RX snaga (prag)
-
-    // Greška prijenosa
-    int faulty;                 // ako je 1, dodaje extra_loss_db i označava granu "down-like"
-    double extra_loss_db;       // dodatno gubljenje optičkog signala
-
-    struct Node* child;
-    struct Node* sibling;
-} Node;
-
-typedef struct {
-    int ont_count;
-    int ok_count;
-    int fail_count;  // ispod RX min
-    int down_count;  // prisiljen na down zbog krivog patha
-    double sum_rx;
-    double sum_loss;
-    double best_rx;
-    double worst_rx;
-} SubtreeStats;
-
-typedef struct {
-    char name[64];
-    int ratio;
-    int ont_count;
-    int ok_count;
-    int fail_count;
-    int down_count;
-    double avg_rx;
-    double avg_loss;
-    double worst_rx;
-} SplitterRecord;
-
-typedef struct {
-    SplitterRecord* arr;
-    size_t n;
-    size_t cap;
-} SplitterList;
-
-typedef struct {
-    int ont_id;
-    double rx_dbm;
-    double margin_db;
-    char path[512];
-} OntResult;
-
-OntResult ont_results[MAX_ONT];
-int ont_results_count = 0;
-
-// --------- constante optičke mreže ----------
-static const double ATTEN_DB_PER_KM = 0.35;   
-static const double CONN_LOSS_DB    = 0.50;
-static const double SPLICE_LOSS_DB  = 0.10;
-static const double SPLITTER_INS_DB = 1.00;   // insertion loss (uz idealni 10log10)
-// ------------------------------------------------
-
-static void die(const char* msg);
-static Node* node_new(NodeType t);
-static void node_add_child(Node* parent, Node* child);
-static void splitter_list_init(SplitterList* sl);
-static void splitter_list_push(SplitterList* sl, const SplitterRecord* rec);
-static char* ltrim(char* s);
-static void rtrim(char* s);
-static int leading_spaces(const char* s);
-static NodeType parse_type(const char* tok);
-static int parse_int(const char* v);
-static double parse_double(const char* v);
-static void apply_kv(Node* n, const char* key, const char* val);
-static void parse_line(Node* n, char* line_no_indent);
-static double splitter_loss_db(int ratio);
-static double node_link_loss_db(const Node* n);
-static SubtreeStats stats_init(void);
-static void stats_merge(SubtreeStats* a, const SubtreeStats* b);
-static void path_append(char* path, size_t cap, const char* part);
-static SubtreeStats walk_and_compute(const Node* n, double parent_tx_dbm, double rxmin_dbm, double acc_loss_db,
-    double acc_dist_km, int down_flag, FILE* ont_csv, SplitterList* splitters, char* path, size_t path_cap);
-static void write_splitter_csv(const char* filename, const SplitterList* sl);
-static void print_summary(const SubtreeStats* all, double tx, double rxmin);
-int cmp_margin(const void* a, const void* b);
-static Node* read_topology(const char* filename);
-void generate_report(const SubtreeStats* stats, Node* root);
-static void free_tree(Node* n);
-
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        printf("Koristimo %s ftth_topology.txt\n", argv[0]);
-        return 1;
-    }
-
-    const char* topo_file = argv[1];
-    Node* root = read_topology(topo_file);
-
-    FILE* ont_csv = fopen("ont_results.csv", "w");
-    if (!ont_csv) {
-        die("Nemoguce je otvoriti ont_results.csv za pisanje");
-    }
-    fprintf(ont_csv, "ont_id,total_dist_km,total_loss_db,rx_dbm,margin_db,status,path\n");
-
-    SplitterList splitters;
-    splitter_list_init(&splitters);
-
-    char path[512] = {0};
-
-    // pocinjemo rekurziju od root
-    SubtreeStats all = walk_and_compute(
-        root,
-        root->olt_tx_dbm,
-        root->gpon_rxmin_dbm,
-        0.0, 0.0, 0,
-        ont_csv,
-        &splitters,
-        path, sizeof(path)
-    );
-
-    fclose(ont_csv);
-
-    write_splitter_csv("splitter_results.csv", &splitters);
-
-    print_summary(&all, root->olt_tx_dbm, root->gpon_rxmin_dbm);
-
-    qsort(ont_results, ont_results_count, sizeof(OntResult), cmp_margin);
-
-    printf("\nTOP %d najgorih ONT-ova (po margin):\n", TOP_N);
-    for (int i = 0; i < TOP_N && i < ont_results_count; i++) {
-        printf(
-            "ONT %d | margin = %.2f dB | RX = %.2f dBm | path = %s\n",
-            ont_results[i].ont_id,
-            ont_results[i].margin_db,
-            ont_results[i].rx_dbm,
-            ont_results[i].path
-        );
-    }
-
-    printf("\nStvorene datoteke:\n");
-    printf(" - ont_results.csv\n");
-    printf(" - splitter_results.csv\n");
-
-    generate_report(&all, root);
-    printf("\nStvoren report.txt\n");
-
-    free(splitters.arr);
-    free_tree(root);
-    return 0;
-}
-
-static void die(const char* msg) {
-    fprintf(stderr, "Error: %s\n", msg);
-    exit(1);
-}
-
-static Node* node_new(NodeType t) {
-    Node* n = (Node*)calloc(1, sizeof(Node));
-    if (!n) {
-        die("Nema slobodne memorije");
-    }
-    n->type = t;
-    n->splitter_ratio = 0;
-    n->ont_id = -1;
-    n->olt_tx_dbm = 3.0;
-    n->gpon_rxmin_dbm = -27.0;
-    n->faulty = 0;
-    n->extra_loss_db = 0.0;
-    n->name[0] = '\0';
-    return n;
-}
-
-static void node_add_child(Node* parent, Node* child) {
-    if (!parent->child) {
-        parent->child = child;
-        return;
-    }
-    Node* cur = parent->child;
-    while (cur->sibling) {
-        cur = cur->sibling;
-    }
-    cur->sibling = child;
-}
-
-static void splitter_list_init(SplitterList* sl) {
-    sl->arr = NULL; 
-    sl->n = 0; 
-    sl->cap = 0;
-}
-
-static void splitter_list_push(SplitterList* sl, const SplitterRecord* rec) {
-    if (sl->n == sl->cap) {
-        size_t newcap = sl->cap ? sl->cap * 2 : 16;
-        SplitterRecord* p = (SplitterRecord*)realloc(sl->arr, newcap * sizeof(SplitterRecord));
-
-        if (!p) {
-            die("Nema slobodne memorije (realloc)");
-        }
-        sl->arr = p;
-        sl->cap = newcap;
-    }
-    sl->arr[sl->n++] = *rec;
-}
-
-// brisanje razmaka s lijeve strane stringa
-static char* ltrim(char* s) {
-    while (*s && isspace((unsigned char)*s)) {
-        s++;
-    }
-    return s;
-}
-
-// brisanje razmaka s desne strane stringa
-static void rtrim(char* s) {
-    size_t n = strlen(s);
-    while (n && isspace((unsigned char)s[n - 1])) {
-        s[--n] = '\0';
-    }
-}
-
-// broji razmake (određuje dubinu stabla)
-static int leading_spaces(const char* s) {
-    int c = 0;
-    while (*s == ' ') { 
-        c++; 
-        s++; 
-    }
-    return c;
-}
-
-// uvlaka mora biti paran broj razmaka (2 po razini - određuje dubinu stabla)
-static NodeType parse_type(const char* tok) {
-    if (strcmp(tok, "OLT") == 0) {
-        return NODE_OLT;
-    }
-    if (strcmp(tok, "SPLITTER") == 0) {
-        return NODE_SPLITTER;
-    }
-    if (strcmp(tok, "ONT") == 0) {
-        return NODE_ONT;
-    }
-    die("Nepoznati node type (ocekivani su OLT/SPLITTER/ONT)");
-    return NODE_ONT;
-}
-
-static int parse_int(const char* v) { 
-    return (int)strtol(v, NULL, 10); 
-}
-
-static double parse_double(const char* v) { 
-    return strtod(v, NULL); 
-}
-
-// key=value
-static void apply_kv(Node* n, const char* key, const char* val) {
-    if (strcmp(key, "len") == 0) {
-        n->len_km = parse_double(val);
-    } else if (strcmp(key, "km") == 0) {
-        n->len_km = parse_double(val);
-    } else if (strcmp(key, "conn") == 0) {
-        n->connectors = parse_int(val);
-    } else if (strcmp(key, "sp") == 0) {
-        n->splices = parse_int(val);
-    } else if (strcmp(key, "ratio") == 0) {
-        n->splitter_ratio = parse_int(val);
-    } else if (strcmp(key, "name") == 0) {
-        strncpy(n->name, val, sizeof(n->name) - 1);
-        n->name[sizeof(n->name) - 1] = '\0';
-    } else if (strcmp(key, "id") == 0) {
-        n->ont_id = parse_int(val);
-    } else if (strcmp(key, "tx") == 0) {
-        n->olt_tx_dbm = parse_double(val);
-    } else if (strcmp(key, "rxmin") == 0) {
-        n->gpon_rxmin_dbm = parse_double(val);
-    } else if (strcmp(key, "faulty") == 0) {
-        n->faulty = parse_int(val) ? 1 : 0;
-    } else if (strcmp(key, "extra") == 0) {
-        n->extra_loss_db = parse_double(val);
-    }
-    // nepoznati "key" su ignorirani
-}
-
-// parsira 1 liniju topologije
-static void parse_line(Node* n, char* line_no_indent) {
-    // Tokenizira po razmaku: TYPE key=val key=val ...
-    char* save = NULL;
-    char* tok = strtok_r(line_no_indent, " \t", &save);
-    if (!tok) {
-        die("Prazna linija topologije");
-    }
-    n->type = parse_type(tok);
-
-    while ((tok = strtok_r(NULL, " \t", &save)) != NULL) {
-        char* eq = strchr(tok, '=');
-        if (!eq) continue; // ignorira neispravne tokene
-        *eq = '\0';
-
-        const char* key = tok;
-        const char* val = eq + 1;
-        apply_kv(n, key, val);
-    }
-}
-
-// računa gubitak splittera
-static double splitter_loss_db(int ratio) {
-    if (ratio <= 1) return 0.0;
-    // idealni split gubitak(10log10) + insertion loss - npr. 1:8  -> ~9 dB + insertion
-    return 10.0 * log10((double)ratio) + SPLITTER_INS_DB;
-}
-
-// računa gubitke fizičkog optičkog linka 
-static double node_link_loss_db(const Node* n) {
-    double loss = 0.0;
-    loss += n->len_km * ATTEN_DB_PER_KM;
-    loss += (double)n->connectors * CONN_LOSS_DB;
-    loss += (double)n->splices * SPLICE_LOSS_DB;
-
-    if (n->type == NODE_SPLITTER) {
-        loss += splitter_loss_db(n->splitter_ratio);
-    }
-    if (n->faulty) {
-        loss += n->extra_loss_db;
-    }
-    return loss;
-}
-
-// inicijalizacija strukutre statistike
-static SubtreeStats stats_init(void) {
-    SubtreeStats s;
-
-    s.ont_count = 0;
-    s.ok_count = 0;
-    s.fail_count = 0;
-    s.down_count = 0;
-    s.sum_rx = 0.0;
-    s.sum_loss = 0.0;
-    s.best_rx = -1e9;
-    s.worst_rx =  1e9;
-    return s;
-}
-
-// spaja statistiku djece u roditelja
-static void stats_merge(SubtreeStats* a, const SubtreeStats* b) {
-    a->ont_count += b->ont_count;
-    a->ok_count += b->ok_count;
-    a->fail_count += b->fail_count;
-    a->down_count += b->down_count;
-    a->sum_rx += b->sum_rx;
-    a->sum_loss += b->sum_loss;
-    if (b->best_rx > a->best_rx) {
-        a->best_rx = b->best_rx;
-    }
-    if (b->worst_rx < a->worst_rx) {
-        a->worst_rx = b->worst_rx;
-    }
-}
-
-// dodaje putanje (OLT-SPLITTER-ONT)
-static void path_append(char* path, size_t cap, const char* part) {
-    if (path[0] != '\0') {
-        strncat(path, "/", cap - strlen(path) - 1);
-    }
-    strncat(path, part, cap - strlen(path) - 1);
-}
-
-// rekurzivno prolazi topologiju od OLT-a prema ONT-ovima
-static SubtreeStats walk_and_compute(
-    const Node* n,
-    double parent_tx_dbm,
-    double rxmin_dbm,
-    double acc_loss_db,
-    double acc_dist_km,
-    int down_flag,
-    FILE* ont_csv,
-    SplitterList* splitters,
-    char* path,
-    size_t path_cap
-) {
-    if (!n) return stats_init();
-
-    // nasljeđuje OLT tx/rxmin ako je čvor OLT
-    double tx_dbm = parent_tx_dbm;
-    double my_rxmin = rxmin_dbm;
-
-    if (n->type == NODE_OLT) {
-        tx_dbm = n->olt_tx_dbm;
-        my_rxmin = n->gpon_rxmin_dbm;
-    }
-
-    // za čvorove koji nisu OLT, dodaje njihov link loss u akumulirani loss
-    double new_loss = acc_loss_db;
-    double new_dist = acc_dist_km;
-    int new_down = down_flag;
-
-    if (n->type != NODE_OLT) {
-        new_loss += node_link_loss_db(n);
-        new_dist += n->len_km;
-        if (n->faulty) {
-            new_down = 1; // ako je neki element na putu faulty, svi ONT-ovi ispod se smatraju DOWN(idalje računa rx, ali je down)
-        }
-    }
-
-    // ažurira path
-    char old_path[512];
-    strncpy(old_path, path, sizeof(old_path) - 1);
-    old_path[sizeof(old_path) - 1] = '\0';
-
-    char part[128];
-    part[0] = '\0';
-    if (n->type == NODE_OLT) {
-        snprintf(part, sizeof(part), "OLT");
-    } else if (n->type == NODE_SPLITTER) {
-        if (n->name[0]) {
-            snprintf(part, sizeof(part), "%s(1:%d)", n->name, n->splitter_ratio);
-        } else {
-            snprintf(part, sizeof(part), "S(1:%d)", n->splitter_ratio);
-        }
-    } else if (n->type == NODE_ONT) {
-        snprintf(part, sizeof(part), "ONT#%d", n->ont_id);
-    }
-
-    if (part[0]) {
-        path_append(path, path_cap, part);
-    }
-
-    SubtreeStats here = stats_init();
-
-    if (n->type == NODE_ONT) {
-        // racuna RX na ONT-u
-        double rx_dbm = tx_dbm - new_loss;
-        double margin = rx_dbm - my_rxmin;
-
-        if (ont_results_count < MAX_ONT) {
-            ont_results[ont_results_count].ont_id = n->ont_id;
-            ont_results[ont_results_count].rx_dbm = rx_dbm;
-            ont_results[ont_results_count].margin_db = margin;
-            strncpy(ont_results[ont_results_count].path, path, 511);
-            ont_results_count++;
-        }
-
-        const char* status;
-        int ok = 0;
-        if (new_down) {
-            status = "DOWN";
-        } else if (rx_dbm >= my_rxmin) {
-            status = "OK";
-            ok = 1;
-        } else {
-            status = "FAIL";
-        }
-
-        fprintf(ont_csv, "%d,%.4f,%.4f,%.4f,%.4f,%s,\"%s\"\n",
-            n->ont_id, new_dist, new_loss, rx_dbm, margin, status, path);
-
-        here.ont_count = 1;
-        here.sum_rx = rx_dbm;
-        here.sum_loss = new_loss;
-        here.best_rx = rx_dbm;
-        here.worst_rx = rx_dbm;
-
-        if (new_down) {
-            here.down_count = 1;
-        } else if (ok) {
-            here.ok_count = 1;
-        } else {
-            here.fail_count = 1;
-        }
-
-        // vracamo path
-        strncpy(path, old_path, path_cap - 1);
-        path[path_cap - 1] = '\0';
-        return here;
-    }
-
-    // rekurzija djece
-    const Node* child = n->child;
-    while (child) {
-        SubtreeStats cs = walk_and_compute(child, tx_dbm, my_rxmin, new_loss, new_dist, new_down, ont_csv, splitters, path, path_cap);
-        stats_merge(&here, &cs);
-        child = child->sibling;
-    }
-
-    // ako je čvor splitter, spremi podatke te grane (ONT-ovi su ispod)
-    if (n->type == NODE_SPLITTER) {
-        SplitterRecord rec;
-        memset(&rec, 0, sizeof(rec));
-        if (n->name[0]) {
-            strncpy(rec.name, n->name, sizeof(rec.name) - 1);
-        } else {
-            strncpy(rec.name, "(unnamed)", sizeof(rec.name) - 1);
-        }
-
-        rec.ratio = n->splitter_ratio;
-        rec.ont_count = here.ont_count;
-        rec.ok_count = here.ok_count;
-        rec.fail_count = here.fail_count;
-        rec.down_count = here.down_count;
-        rec.avg_rx = (here.ont_count > 0) ? (here.sum_rx / here.ont_count) : 0.0;
-        rec.avg_loss = (here.ont_count > 0) ? (here.sum_loss / here.ont_count) : 0.0;
-        rec.worst_rx = (here.ont_count > 0) ? here.worst_rx : 0.0;
-
-        splitter_list_push(splitters, &rec);
-    }
-
-    // vracamo path
-    strncpy(path, old_path, path_cap - 1);
-    path[path_cap - 1] = '\0';
-    return here;
-}
-
-// generiranje csv datoteke za splittere
-static void write_splitter_csv(const char* filename, const SplitterList* sl) {
-    FILE* f = fopen(filename, "w");
-    if (!f) {
-        die("Nemoguce je otvoriti splitter_results.csv za pisanje.");
-    }
-
-    fprintf(f, "name,ratio,ont_count,ok_count,fail_count,down_count,avg_rx_dbm,avg_loss_db,worst_rx_dbm\n");
-    for (size_t i = 0; i < sl->n; i++) {
-        const SplitterRecord* r = &sl->arr[i];
-        fprintf(f, "\"%s\",%d,%d,%d,%d,%d,%.4f,%.4f,%.4f\n",
-            r->name, r->ratio, r->ont_count, r->ok_count, r->fail_count, r->down_count, r->avg_rx, r->avg_loss, r->worst_rx);
-    }
-    fclose(f);
-}
-
-// ispis na konzolu
-static void print_summary(const SubtreeStats* all, double tx, double rxmin) {
-    printf("\n=== SUMMARY ===\n");
-    printf("OLT TX: %.2f dBm | GPON RXmin: %.2f dBm\n", tx, rxmin);
-    printf("ONT total: %d\n", all->ont_count);
-    printf("OK:   %d\n", all->ok_count);
-    printf("FAIL: %d\n", all->fail_count);
-    printf("DOWN: %d\n", all->down_count);
-
-    if (all->ont_count > 0) {
-        printf("AVG RX:   %.2f dBm\n", all->sum_rx / all->ont_count);
-        printf("AVG LOSS: %.2f dB\n", all->sum_loss / all->ont_count);
-        printf("BEST RX:  %.2f dBm\n", all->best_rx);
-        printf("WORST RX: %.2f dBm\n", all->worst_rx);
-        printf("Note: Margin = RX - RXmin; PASS if RX >= RXmin and not DOWN.\n");
-    }
-}
-
-// sortiranje ONT-ova uzlazno po optičkoj margini
-int cmp_margin(const void* a, const void* b) {
-    OntResult* x = (OntResult*)a;
-    OntResult* y = (OntResult*)b;
-
-    if (x->margin_db < y->margin_db) return -1;
-    if (x->margin_db > y->margin_db) return 1;
-    return 0;
-}
-
-// čitanje datoteke topologije
-static Node* read_topology(const char* filename) {
-    FILE* f = fopen(filename, "r");
-    if (!f) {
-        die("Nemoguce je otvoriti datoteku ftth_topology.txt");
-    }
-    Node* root = NULL;
-    Node* stack[64] = {0};  //stack[depth] = zadnji cvor na depth
-
-    char line[1024];
-    int auto_ont_id = 1;
-
-    while (fgets(line, sizeof(line), f)) {
-        rtrim(line);
-        char* p = ltrim(line);
-
-        if (*p == '\0') continue;
-        if (*p == '#') continue;
-
-        int spaces = leading_spaces(line);
-        if (spaces % 2 != 0) {
-            die("Uvlaka mora biti paran broj razmaka");
-        }
-
-        int depth = spaces / 2;
-        char tmp[1024];
-        strncpy(tmp, p, sizeof(tmp) - 1);
-        tmp[sizeof(tmp) - 1] = '\0';
-
-        Node* n = node_new(NODE_ONT); // vrstu postavlja parse_line
-        parse_line(n, tmp);
-
-        if (n->type == NODE_ONT) {
-            if (n->ont_id < 0) {
-                n->ont_id = auto_ont_id++;
-            }
-        }
-
-        if (depth == 0) {
-            // OLT mora biti na samom vrhu
-            if (n->type != NODE_OLT) {
-                die("Najgornji cvor mora biti OLT!");
-            }
-            root = n;
-            stack[0] = n;
-        } else {
-            Node* parent = stack[depth - 1];
-            if (!parent) {
-                die("Kriva identacija / Fali roditelj");
-            }
-            node_add_child(parent, n);
-            stack[depth] = n;
-        }
-
-        // omogućava oslobadaje dubljeg satcka
-        for (int i = depth + 1; i < 64; i++) {
-            stack[i] = NULL;
-        }
-    }
-
-    fclose(f);
-
-    if (!root) {
-        die("Nema OLT cvora u ftth_topology.txt");
-    }
-
-    return root;
-}
-
-void generate_report(const SubtreeStats* stats, Node* root) {
-    FILE* f = fopen("report.txt", "w");
-    if (!f) return;
-
-    fprintf(f, "FTTH/GPON SIMULATION REPORT\n\n");
-    fprintf(f, "OLT TX power: %.2f dBm\n", root->olt_tx_dbm);
-    fprintf(f, "GPON RX minimum: %.2f dBm\n\n", root->gpon_rxmin_dbm);
-
-    fprintf(f, "Total ONT count: %d\n", stats->ont_count);
-    fprintf(f, "OK connections: %d\n", stats->ok_count);
-    fprintf(f, "FAIL connections: %d\n", stats->fail_count);
-    fprintf(f, "DOWN connections: %d\n\n", stats->down_count);
-
-    fprintf(f, "Best RX power: %.2f dBm\n", stats->best_rx);
-    fprintf(f, "Worst RX power: %.2f dBm\n", stats->worst_rx);
-    fprintf(f, "Average RX power: %.2f dBm\n\n",
-            stats->sum_rx / stats->ont_count);
-
-    fprintf(f, "TOP %d worst ONT connections (by margin):\n", TOP_N);
-    for (int i = 0; i < TOP_N && i < ont_results_count; i++) {
-        fprintf(
-            f,
-            "ONT %d | margin = %.2f dB | RX = %.2f dBm | %s\n",
-            ont_results[i].ont_id,
-            ont_results[i].margin_db,
-            ont_results[i].rx_dbm,
-            ont_results[i].path
-        );
-    }
-
-    fprintf(f, "\nZakljucak:\n");
-    fprintf(f, "Veliki omjer dijeljenja(split ratio) i dugacke opticke udaljenosti smanjuju opticku marginu.\n");
-    fprintf(f, "Kriticni dijelovi mreze bi se trebali pratiti i sanirti po potrebi!\n");
-
-    fclose(f);
-}
-
-static void free_tree(Node* n) {
-    if (!n) return;
-
-    free_tree(n->child);
-    free_tree(n->sibling);
-    free(n);
-}
\ No newline at end of file
+/*
+  Naziv programa:  FTTH/GPON Simulator
+
+Program:
+    - čita datoteku sa topologijom optičke mreže (OLT-SPLITTER-ONT)
+    - računa optičke gubitke i RX snagu za svaki ONT (za svakog korisnika)
+    - sakuplja i grupira statistiku po splitteru
+    - stvara datoteke ont_results.csv i splitter_results.csv iz kojih dobivamo vizualini prikaz pomoću grafova
+    - stvara datoteku report.txt kojom izvještava status optičke mreže
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FTTH_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// gubici se moraju računati bez spajanja a*b+c u FMA, inače SIMD i skalarni put
+// (i CSV ispis) mogu odstupati u zadnjem bitu
+#if defined(__GNUC__) && !defined(__clang__)
+#define FTTH_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define FTTH_NO_FP_CONTRACT
+#endif
+
+// dohvat u cache unaprijed (telemetrija: nasumični pristupi po ONT id-u)
+#if defined(__GNUC__)
+#define FTTH_PREFETCH(p) __builtin_prefetch(p, 1)
+#else
+#define FTTH_PREFETCH(p) ((void)(p))
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define TOP_N   5
+#define CSV_FLUSH_BYTES (1 << 20)   // CSV izlaz se piše u blokovima od 1 MiB
+#define TEL_BATCH 64                // uzoraka telemetrije po skupini (dohvat unaprijed pa obrada)
+#define TEL_RX_LIMIT_DBM 100.0      // |RX| iznad ovoga (ili nan/inf) nije mjerenje nego neispravna linija
+#define PARSE_CHUNK_MIN (1 << 20)   // paralelno čitanje: manji komadi ne isplate nit
+#define FIXED4_MAX 320              // najdulji "%.4f" zapis (DBL_MAX ima 309 znamenki)
+#define MC_LANES 16                 // Monte Carlo: pokusa po bloku (SIMD trake)
+#define SERVE_LINE_MAX (64 * 1024)  // --serve: najdulja linija naredbe; dulja zatvara vezu
+#define OPT_GAIN_SCALE 1e9          // --optimize: gain se zbraja u cijelim nano-dB (zbroj ne ovisi o redoslijedu)
+#define OPT_TABLE_MAX (4ULL << 30)  // --optimize: najviše bajtova DP tablica (inače greška umjesto OOM-a)
+#define GEN_MAX_DEPTH 60            // --gen: najviše razina splittera (ime raste ~11 znakova po razini)
+#define GEN_NAME_MAX (12 + 11 * GEN_MAX_DEPTH)  // "O<olt>" + "S<n>" + "_<c>" po razini + '\0'
+#ifdef _WIN32
+#define BENCH_NULL_FILE "NUL"       // --bench: izlazne datoteke se pišu, ali ne ostaju u radnom direktoriju
+#else
+#define BENCH_NULL_FILE "/dev/null"
+#endif
+
+// instrumentacija (--stats ili FTTH_STATS=datoteka.json); -DFTTH_STATS=0 je potpuno uklanja
+#ifndef FTTH_STATS
+#define FTTH_STATS 1
+#endif
+
+typedef enum { NODE_OLT, 
+    NODE_SPLITTER, 
+    NODE_ONT 
+} NodeType;
+
+typedef struct Node {
+    NodeType type;
+
+    // Link parametri od roditelja
+    double len_km;
+    int connectors;
+    int splices;
+
+    // Splitter parametri
+    int splitter_ratio;         // npr. 8/16/32/64 dijelitelja
+    const char* name;           // pogled u mapiranu datoteku topologije (nije NUL-terminiran)
+    int name_len;
+
+    // ONT parametri
+    int ont_id;
+
+    // OLT parametri
+    double olt_tx_dbm;          // snaga pokretanja
+    double gpon_rxmin_dbm;      // minimalna RX snaga (prag)
+
+    // Greška prijenosa
+    int faulty;                 // ako je 1, dodaje extra_loss_db i označava granu "down-like"
+    double extra_loss_db;       // dodatno gubljenje optičkog signala
+
+    struct Node* child;
+    struct Node* last_child;    // zadnje dijete - dodavanje djeteta je O(1)
+    struct Node* sibling;
+} Node;
+
+// čvor referentnog čitanja (--bench-parse): izvorni oblik prije arene i mapiranja, ime se kopira
+typedef struct RefNode {
+    NodeType type;
+    double len_km;
+    int connectors;
+    int splices;
+    int splitter_ratio;
+    char name[64];
+    int ont_id;
+    double olt_tx_dbm;
+    double gpon_rxmin_dbm;
+    int faulty;
+    double extra_loss_db;
+    struct RefNode* child;
+    struct RefNode* sibling;
+} RefNode;
+
+// blok arene: čvorovi se alociraju uzastopno, bez zasebnog calloc poziva po čvoru
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t cap;
+    Node nodes[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    size_t count;
+} NodeArena;
+
+typedef struct {
+    int ont_count;
+    int ok_count;
+    int fail_count;  // ispod RX min
+    int down_count;  // prisiljen na down zbog krivog patha
+    double sum_rx;
+    double sum_loss;
+    double best_rx;
+    double worst_rx;
+} SubtreeStats;
+
+typedef struct {
+    char name[64];
+    int ratio;
+    int ont_count;
+    int ok_count;
+    int fail_count;
+    int down_count;
+    double avg_rx;
+    double avg_loss;
+    double worst_rx;
+} SplitterRecord;
+
+typedef struct {
+    SplitterRecord* arr;
+    size_t n;
+    size_t cap;
+} SplitterList;
+
+// okvir iterativnog obilaska Node stabla (walk_and_compute): vrijednosti čvora dok se obilaze djeca
+typedef struct {
+    const Node* n;
+    const Node* next_child;     // sljedeće dijete koje treba obići (NULL = sva obiđena)
+    double tx_dbm;
+    double rxmin_dbm;
+    double loss_db;
+    double dist_km;
+    int down;
+    size_t path_len;            // duljina putanje prije ovog čvora - na nju se putanja skraćuje
+    SubtreeStats acc;
+} WalkFrame;
+
+// stog okvira za walk_and_compute (raste po potrebi, ne ovisi o C stogu)
+typedef struct {
+    WalkFrame* arr;
+    size_t n;
+    size_t cap;
+} WalkStack;
+
+// kompaktan rezultat po ONT-u; putanja se ne sprema nego se gradi iz FlatTopo tek kod ispisa
+typedef struct {
+    int32_t node;               // indeks čvora u FlatTopo
+    int ont_id;
+    double rx_dbm;
+    double margin_db;
+} OntResult;
+
+// ograničena max-hrpa s N najgorih ONT-ova (najmanja margina); na vrhu je "najbolji od najgorih"
+typedef struct {
+    OntResult* arr;
+    int n;
+    int cap;
+} TopN;
+
+// najgorih K ONT-ova ispod jednog splittera
+typedef struct {
+    int32_t splitter;           // čvor splittera
+    int rank;
+    OntResult r;
+} SplitterWorst;
+
+typedef struct {
+    SplitterWorst* arr;
+    size_t n;
+    size_t cap;
+} SplitterWorstList;
+
+// datoteka topologije mapirana u memoriju (mmap / MapViewOfFile); cijev, FIFO i ostale datoteke
+// koje se ne mogu mapirati učitavaju se u alocirani buffer (owned = 1)
+typedef struct {
+    const char* data;
+    size_t len;
+    int owned;
+} MappedFile;
+
+// učitana topologija: imena čvorova pokazuju u src pa ona mora živjeti koliko i stablo
+typedef struct {
+    Node* root;                 // prvi OLT na vrhu; ostali OLT-ovi na vrhu su mu braća
+    NodeArena arena;
+    MappedFile src;
+    size_t line_count;
+    size_t node_count;
+} Topology;
+
+// kompilirani oblik stabla: čvorovi u DFS preorder redoslijedu, svaki atribut u svom nizu.
+// Podstablo čvora i su točno čvorovi [i, end[i]) pa se evaluacija svodi na linearni prolaz.
+typedef struct {
+    int32_t n;                  // broj čvorova
+    int32_t ont_count;
+    uint8_t* type;              // NodeType
+    uint8_t* faulty;
+    int32_t* parent;            // -1 za OLT na vrhu
+    int32_t* end;               // kraj podstabla (isključivo)
+    double* link_loss;          // node_link_loss_db() linka od roditelja
+    double* len_km;
+    int32_t* conn;              // sirovi parametri linka (za ponovni izračun link_loss)
+    int32_t* splices;
+    double* extra;
+    int32_t* ont_id;
+    int32_t* ratio;
+    const char** name;          // pogled u mapiranu datoteku
+    int32_t* name_len;
+
+    // ONT stupci (indeks = redni broj ONT-a u preorderu) za batch kernel
+    int32_t* ont_node;
+    int32_t* ont_parent;
+    double* ont_len;
+    int32_t* ont_conn;
+    int32_t* ont_sp;
+    double* ont_extra;          // extra_loss_db ako je ONT faulty, inače 0
+    int32_t* ont_faulty;
+
+    // OLT parametri, po redu pojavljivanja OLT čvorova u preorderu
+    int32_t olt_count;
+    double* olt_tx_dbm;
+    double* olt_rxmin_dbm;
+
+    // indeksi (otvoreno adresiranje, linearno probanje): ont_id -> čvor i ime splittera -> čvor
+    // (ime je jedinstveno unutar OLT-a na vrhu, isto ime pod drugim OLT-om je drugi splitter).
+    // Ključ se ne sprema, čita se iz ont_id/name čvora u slotu; -1 = prazan slot
+    int32_t* ont_slot;
+    int32_t* spl_slot;
+    uint32_t ont_mask;
+    uint32_t spl_mask;
+
+    int mapped;                 // nizovi pokazuju u mapirani snapshot (flat_free ih ne oslobađa)
+} FlatTopo;
+
+typedef enum {
+    ONT_OK,
+    ONT_FAIL,
+    ONT_DOWN
+} OntStatus;
+
+static const char* const ONT_STATUS_NAME[] = { "OK", "FAIL", "DOWN" };
+
+// konstante gubitaka kao parametri evaluacije
+typedef struct {
+    double atten_db_per_km;
+    double conn_loss_db;
+    double splice_loss_db;
+    double splitter_ins_db;     // ONT kernel ga ne koristi (ONT nije splitter)
+} LossParams;
+
+typedef struct EvalState EvalState;
+typedef void (*OntKernelFn)(const FlatTopo* ft, const LossParams* lp, EvalState* es, int32_t k0, int32_t k1);
+
+// međurezultati evaluacije: kontekst po čvoru (koristi se samo za ne-ONT čvorove) i rezultati po ONT-u
+struct EvalState {
+    double* path_loss;          // akumulirani gubitak od OLT-a do čvora (uklj. njegov link)
+    double* path_dist;
+    double* tx_dbm;
+    double* rxmin_dbm;
+    int32_t* down;
+
+    double* ont_loss;
+    double* ont_dist;
+    double* ont_rx;
+    double* ont_margin;
+    uint8_t* ont_status;        // OntStatus
+
+    LossParams lp;
+    OntKernelFn kernel;
+};
+
+// rastući tekstualni buffer (izlaz zadatka paralelne evaluacije)
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} TextBuf;
+
+// CSV izlaz: redci se formatiraju u vlastiti buffer i pišu u velikim blokovima,
+// po želji iz pozadinske niti (dok ona piše jedan blok, evaluacija puni drugi)
+typedef struct {
+    FILE* f;
+    TextBuf buf;                // blok koji se trenutno puni
+    int bg;                     // 1 = pisanje u pozadinskoj niti
+    pthread_t thread;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    TextBuf pending;            // blok predan niti
+    int has_pending;
+    int done;
+    const char* name;
+    uint64_t written;           // bajtova predano na pisanje
+} CsvWriter;
+
+// ONT rezultati po stupcima (indeks = redni broj ONT-a u preorderu) za binarni izlaz
+typedef struct {
+    int32_t* ont_id;
+    double* dist;
+    double* loss;
+    double* rx;
+    double* margin;
+    uint8_t* status;            // OntStatus
+} OntColumns;
+
+// opis stupca u zaglavlju .bin datoteke (dtype je numpy oznaka, npr. "<f8"; poredak bajtova je onaj stroja)
+typedef struct {
+    char name[16];
+    char dtype[8];
+    uint64_t offset;            // od početka datoteke, poravnato na 64 B
+} BinColumn;
+
+// zaglavlje .bin datoteke; iza njega slijedi column_count BinColumn opisa pa stupci
+typedef struct {
+    char magic[8];              // "FTTHONT1" / "FTTHSPL1"
+    uint32_t version;
+    uint32_t column_count;
+    uint64_t row_count;
+    uint64_t reserved;
+} BinHeader;
+
+// zaglavlje snapshota (--save-snapshot); iza njega je tablica pomaka nizova pa nizovi,
+// svaki poravnat na 64 B, redom kao u SNAP_ARRAYS
+typedef struct {
+    char magic[8];              // "FTTHSNAP"
+    uint32_t version;
+    uint32_t endian;            // 0x01020304 zapisan redoslijedom bajtova stroja koji je spremio
+    uint64_t file_size;
+    uint64_t checksum;          // snap_checksum cijele datoteke, s ovim poljem postavljenim na 0
+    int32_t n;
+    int32_t ont_count;
+    int32_t olt_count;
+    int32_t array_count;
+    uint32_t ont_mask;
+    uint32_t spl_mask;
+    uint64_t name_bytes;        // tablica imena (svako ime jednom)
+} SnapHeader;
+
+// inkrementalni motor: kontekst i SubtreeStats svakog čvora ostaju u memoriji pa promjena
+// čvora u traži samo ponovni izračun [u, end[u]) i agregata njegovih predaka
+typedef struct {
+    FlatTopo* ft;
+    EvalState es;
+    SubtreeStats* st;           // agregat podstabla po čvoru
+    int32_t* ont_before;        // broj ONT-ova prije čvora i (n + 1 elemenata)
+    int32_t* olt_before;        // broj OLT-ova prije čvora i
+    SubtreeStats all;
+} IncEngine;
+
+// --serve: jedna replika stabla (vlastiti FlatTopo nizovi + inkrementalni motor)
+typedef struct {
+    FlatTopo ft;
+    IncEngine e;
+    atomic_int readers;         // upiti koji trenutno čitaju ovu repliku
+} ServeReplica;
+
+// left-right: upiti čitaju aktivnu repliku bez zaključavanja; promjena se primijeni na neaktivnu,
+// replike se zamijene, a kad stari čitatelji izađu ista promjena ide i na drugu repliku
+typedef struct {
+    ServeReplica rep[2];
+    atomic_int active;
+    atomic_int stop;
+    pthread_mutex_t write_mu;   // promjene se izvode jedna po jedna
+    int listen_fd;
+} ServeState;
+
+typedef struct {
+    ServeState* st;
+    int fd;
+} ServeConn;
+
+// --stream: otvoreni predak na trenutnoj putanji (samo njih se pamti, nikad cijelo stablo)
+typedef struct {
+    NodeType type;
+    int skip;                   // čvor ispod ONT-a - flat_fill ga preskače pa se preskače i ovdje
+    char name[64];              // dovoljno za SplitterRecord
+    int name_len;
+    int ratio;
+    double tx_dbm;
+    double rxmin_dbm;
+    double loss_db;             // akumulirano od OLT-a do čvora (uklj. njegov link)
+    double dist_km;
+    int down;
+    size_t path_len;            // duljina putanje roditelja - na nju se putanja vraća pri zatvaranju
+    SubtreeStats acc;
+} StreamFrame;
+
+// sažetak jednog OLT-a na vrhu (redak olt_results.csv)
+typedef struct {
+    int32_t olt;                // redni broj OLT-a na vrhu unutar datoteke (od 1)
+    double tx_dbm;
+    double rxmin_dbm;
+    SubtreeStats st;
+} OltSummary;
+
+// putanja ONT-a koji je trenutno u TOP N hrpi (hrpa sama pamti samo preorder indeks)
+typedef struct {
+    int32_t node;
+    char path[512];
+} StreamTopPath;
+
+// --stream: stanje jednoprolaznog parsiranja i evaluacije; memorija O(dubina + N) uz skup
+// ONT id-ova (4-8 B po ONT-u) za otkrivanje duplikata
+typedef struct {
+    StreamFrame* stk;           // otvoreni preci, raste s dubinom
+    int stk_cap;
+    int top;                    // -1 = nema otvorenih čvorova
+    char path[512];
+    size_t plen;
+    CsvWriter ont_csv;
+    CsvWriter spl_csv;
+    StreamTopPath* worst_path;  // ont_top.cap mjesta (hrpa je globalna ont_top, kao u običnom pokretanju)
+    int worst_path_n;
+    SubtreeStats all;
+    int32_t next_index;         // preorder indeks sljedećeg čvora (isti kao u FlatTopo)
+    size_t line_count;
+    size_t node_count;
+    int auto_ont_id;
+    int olt_count;
+    OltSummary olt;             // jedini OLT na vrhu (za sažetak, kao u običnom pokretanju)
+    int olt_n;
+    int32_t* id_set;            // viđeni ONT id-ovi, otvoreno adresiranje, -1 = prazno
+    uint32_t id_mask;
+    int32_t id_n;
+} StreamState;
+
+// obrada jedne linije ulaza čitanog u blokovima (read_lines); eol pokazuje na '\n' ili kraj
+typedef void (*LineFn)(void* ctx, const char* line, const char* eol);
+
+// --localize: indeksi izračunati jednom nad FlatTopo; upit (skup alarma) ih samo čita.
+// Podstablo čvora i je interval [i, end[i]) preordera pa su "ONT-ovi ispod" i LCA intervalni upiti.
+typedef struct {
+    const FlatTopo* ft;
+    int32_t* ont_before;        // broj ONT-ova prije čvora i (n + 1 elemenata)
+    uint32_t* mark;             // zadnji upit koji je čvor dodao među kandidate
+    uint32_t stamp;
+} LocIndex;
+
+// kandidat za kvar: čvor (link prema njemu ili sam element) i koliko alarma objašnjava
+typedef struct {
+    int32_t node;
+    int32_t onts;               // ONT-ova u podstablu
+    int32_t alarmed;            // alarmiranih ONT-ova u podstablu
+    double score;               // alarmed / (alarma + onts - alarmed) (Jaccard)
+} LocCandidate;
+
+// parametri --telemetry / --bench-telemetry (--telemetry-opts)
+typedef struct {
+    double alpha;               // težina novog uzorka u EWMA
+    double drift;               // prag odstupanja (dB) za oznaku splittera
+    int min_samples;            // splitter se ne označava prije ovoliko uzoraka
+    long samples;               // --bench-telemetry: broj generiranih uzoraka
+    uint64_t seed;
+    int degraded;               // --bench-telemetry: splittera s dodanim gubitkom
+} TelParams;
+
+// sve što uzorak čita i mijenja za jedan ONT, u jednoj cache liniji
+typedef struct {
+    double pred_rx;             // predviđeni RX (iz EvalState)
+    double ewma;
+    double max_dev;             // najveće |odstupanje| pojedinog uzorka
+    double last_rx;
+    double last_ts;
+    uint32_t samples;
+    int32_t spl;                // roditeljski splitter (čvor) ili -1
+} TelOnt;
+
+typedef struct {
+    double ewma;
+    double max;                 // najveći |EWMA| dosegnut tijekom ulaza
+    uint32_t samples;
+    uint8_t flag;               // trenutno iznad praga (s histerezom na pola praga)
+} TelSplitter;
+
+// ONT id -> redni broj ONT-a; ključ je u slotu pa pogodak ne dira FlatTopo nizove
+typedef struct {
+    int32_t id;
+    int32_t k;                  // -1 = prazan slot
+} TelSlot;
+
+// stanje usporedbe izmjereno/predviđeno. Svi nizovi se alociraju unaprijed pa uzorak ne alocira ništa.
+// Odstupanje je predviđeni - izmjereni RX: pozitivno znači više gubitka nego u modelu.
+typedef struct {
+    const FlatTopo* ft;
+    TelParams tp;
+    EvalState es;               // predviđeni ont_rx / ont_margin
+    int32_t* ont_before;        // čvor -> redni broj ONT-a (n + 1 elemenata)
+    TelOnt* ont;                // po rednom broju ONT-a
+    TelSplitter* spl;           // po čvoru, za splittere koji su izravni roditelji ONT-ova
+    TelSlot* slot;
+    uint32_t mask;
+
+    // uzorci se skupljaju u skupinu: prvo se dohvate svi slotovi pa svi ONT zapisi, tek onda obrada,
+    // tako da se promašaji cachea preklapaju umjesto da svaki uzorak čeka svoje
+    double b_ts[TEL_BATCH];
+    double b_rx[TEL_BATCH];
+    int32_t b_id[TEL_BATCH];
+    int32_t b_k[TEL_BATCH];
+    int b_n;
+
+    uint64_t total;             // prihvaćenih uzoraka
+    uint64_t unknown;           // nepoznat ONT id
+    uint64_t late;              // stariji od zadnjeg uzorka istog ONT-a (preskočeni)
+    uint64_t bad;               // neispravne linije
+    uint64_t raised;            // prelazaka praga
+    int quiet;                  // ne ispisuj prelaske praga (benchmark)
+} TelState;
+
+// --optimize: parametri pretrage (--optimize B, --optimize-opts)
+typedef struct {
+    int budget;                 // najviše promijenjenih splittera
+    int goal;                   // 0 = najmanje FAIL ONT-ova, 1 = najveća najmanja margina
+    int ratios[8];              // dopušteni omjeri
+    int ratio_n;
+} OptParams;
+
+// rezultat podstabla uz zadani budžet: FAIL ONT-ova i najmanja margina (DOWN ONT-ovi se ne broje)
+typedef struct {
+    int32_t fails;
+    double margin;              // HUGE_VAL ako u podstablu nema ONT-a koji nije DOWN
+} OptValue;
+
+// tablice dinamičkog programiranja po čvoru. Podstablo ovisi o promijenjenim precima samo kroz
+// ukupno smanjenje gubitka iznad njega, pa je stanje čvora u indeks u sortiranom skupu različitih
+// zbrojeva gain_q promijenjenih predaka (najviše budget promjena). Tablica čuva najbolji rezultat
+// podstabla za svako stanje i svaki budžet 0..cap[u] (najviše toliko promjena).
+typedef struct {
+    const FlatTopo* ft;
+    const EvalState* es;
+    const int32_t* ont_before;
+    OptParams op;
+    int32_t* new_ratio;         // manji dopušteni omjer ili 0 ako splitter nije kandidat
+    double* gain;               // smanjenje gubitka uz new_ratio (dB)
+    int64_t* gain_q;            // gain * OPT_GAIN_SCALE
+    int64_t* sums;              // spremište skupova zbrojeva (svaki sortiran, bez ponavljanja)
+    int32_t* sum_k;             // najmanje promjena kojima se zbroj postiže
+    size_t sum_n, sum_cap;
+    int64_t* set_off;           // stanja čvora: sums[set_off[u] .. + set_len[u]]
+    int32_t* set_len;
+    int64_t* kid_off;           // stanja djece čvora (za kandidata skup uz "promijeni", inače isti)
+    int32_t* kid_len;
+    int32_t* cap;               // najviše korisnih promjena u podstablu (<= budget)
+    OptValue** table;           // po ne-ONT čvoru: [stanje * (cap + 1) + b]
+    uint8_t** chosen;           // je li čvor promijenjen u optimumu za [stanje][b]
+    int32_t* tasks;             // podstabla ispod OLT-ova (posao za niti)
+    int task_n;
+    atomic_int next;
+} OptState;
+
+// radni nizovi jedne niti (budget + 1 elemenata)
+typedef struct {
+    OptValue* acc;
+    OptValue* tmp;
+    OptValue* res0;
+    OptValue* res1;
+} OptScratch;
+
+// rekonstrukcija optimuma: čvor, stanje predaka i budžet podstabla
+typedef struct {
+    int32_t node;
+    int32_t state;
+    int32_t budget;
+} OptFrame;
+
+// --diff: jedna strana usporedbe (evaluirano stablo + hash ulaza svakog podstabla)
+typedef struct {
+    Topology topo;
+    FlatTopo ft;
+    IncEngine e;
+    uint64_t* hash;             // flat_subtree_hash
+    int32_t* olt_node;          // čvor k-tog OLT-a na vrhu
+} DiffTree;
+
+// --diff: izlazne datoteke i brojači
+typedef struct {
+    FILE* ont_csv;
+    FILE* spl_csv;
+    size_t visited;             // čvorova koje je usporedba stvarno obišla
+    int ont_changed, ont_added, ont_removed;
+    int spl_changed, spl_added, spl_removed;
+} DiffOut;
+
+// jedna promjena čvora u scenariju: key=val tokeni [kv, kv_end) iz mapirane datoteke scenarija
+typedef struct {
+    int32_t node;
+    const char* kv;
+    const char* kv_end;
+} ScenarioEdit;
+
+// scenarij = parametri gubitaka + raspon promjena u ScenarioSet.edits
+typedef struct {
+    char name[64];
+    LossParams lp;
+    size_t edit_first;
+    size_t edit_count;
+} Scenario;
+
+typedef struct {
+    Scenario* arr;
+    size_t n;
+    size_t cap;
+    ScenarioEdit* edits;
+    size_t edit_n;
+    size_t edit_cap;
+} ScenarioSet;
+
+// sažetak jednog scenarija (jedan redak scenario_results.csv)
+typedef struct {
+    SubtreeStats st;
+    double worst_margin;
+    int worst_ont_id;
+} ScenarioResult;
+
+// radni prostor niti: pogled na FlatTopo s privatnim kopijama nizova koje scenarij mijenja
+typedef struct {
+    FlatTopo view;
+    EvalState es;
+    LossParams cur_lp;          // s njima je izračunat view.link_loss
+    int32_t* slot;              // čvor -> indeks u nodes (-1 ako ga scenarij ne mijenja)
+    Node* nodes;                // izmijenjeni čvorovi trenutnog scenarija
+    int32_t* touched;
+    size_t touched_n;
+    size_t touched_cap;
+} ScenarioScratch;
+
+// P² procjena jednog kvantila bez spremanja uzoraka (Jain & Chlamtac): 5 markera
+typedef struct {
+    double q[5];                // visine markera
+    int32_t n[5];               // pozicije markera (od 0)
+    int32_t count;
+} P2Quantile;
+
+// standardne devijacije komponenti gubitka za Monte Carlo (srednje vrijednosti su LossParams)
+typedef struct {
+    double atten_sd;            // dB/km
+    double conn_sd;             // dB po konektoru
+    double splice_sd;           // dB po spoju
+    double ins_sd;              // dB insertion loss splittera
+} McDist;
+
+// Monte Carlo akumulatori (ONT-ovi po rednom broju, splitteri po retku u splitter_results)
+typedef struct {
+    int64_t* ont_fail;          // pokusa ispod RXmin (ili DOWN)
+    P2Quantile* ont_q;          // 3 po ONT-u: p05, p50, p95 margine
+    int64_t* spl_any;           // pokusa s barem jednim neispravnim ONT-om ispod splittera
+    int64_t* spl_fail;          // zbroj neispravnih ONT-ova po pokusima
+    P2Quantile* spl_q;          // 3 po splitteru: kvantili najgore margine ispod splittera
+} McAcc;
+
+// zadatak = podstablo jednog djeteta OLT-a na vrhu; svi pokusi za to podstablo
+typedef struct {
+    int32_t lo, hi;
+    int32_t root;
+    int32_t root_olt;           // redni broj OLT-a root
+    int32_t ont_k;              // prvi ONT u [lo, hi)
+    int32_t olt_k;              // prvi OLT u [lo, hi)
+} McTask;
+
+typedef struct {
+    const FlatTopo* ft;
+    const double* mean;         // očekivani gubitak linka po čvoru
+    const double* sd;           // standardna devijacija gubitka linka po čvoru
+    const int32_t* spl_row;
+    long trials;
+    uint64_t seed;
+    McTask* tasks;
+    int task_count;
+    McAcc* acc;
+    atomic_int next;
+} McPool;
+
+// otvoreni predak u MC prolazu; vrijednosti po trakama bloka
+typedef struct {
+    int32_t node;
+    int down;
+    double tx, rxmin;
+    double path[MC_LANES];
+    int32_t fail[MC_LANES];     // neispravni ONT-ovi u podstablu
+    double min_margin[MC_LANES];
+} McFrame;
+
+// popis ulaznih datoteka topologije (shardova)
+typedef struct {
+    char** arr;
+    size_t n;
+    size_t cap;
+} PathList;
+
+// jedan od N najgorih ONT-ova sharda; putanja se gradi dok je shard još učitan
+typedef struct {
+    OntResult r;
+    int32_t shard;
+    char* path;                 // točne duljine (xmalloc), oslobađa run_shards
+} ShardTop;
+
+// sve što od sharda ostaje nakon što se njegova topologija oslobodi
+typedef struct {
+    size_t node_count;
+    SubtreeStats st;
+    OltSummary* olts;
+    int olt_n;
+    ShardTop* top;
+    int top_n;
+} ShardResult;
+
+typedef struct {
+    const PathList* files;
+    ShardResult* res;
+    int top_cap;
+    atomic_int next;
+} ShardPool;
+
+// komad datoteke topologije za paralelno parsiranje; počinje linijom dubine 0 ili 1
+typedef struct {
+    const char* begin;
+    const char* end;
+    NodeArena arena;            // vlastita arena komada (na kraju se spaja u arenu topologije)
+    Node head;                  // zamjenski roditelj linija dubine 1 prije prvog OLT-a u komadu
+    Node* root;                 // OLT-ovi na vrhu u komadu, povezani kao braća
+    Node* last_root;
+    size_t line_count;
+    size_t node_count;
+    Node** auto_ont;            // ONT-ovi bez id-a po redu; id dobivaju nakon svih komada
+    size_t auto_n;
+    size_t auto_cap;
+} ParseChunk;
+
+typedef struct {
+    ParseChunk* chunks;
+    int count;
+    atomic_int next;
+} ParsePool;
+
+// parametri generatora sintetičke topologije (--gen)
+typedef struct {
+    long onts;                  // ukupan broj ONT-ova
+    uint64_t seed;
+    int olts;                   // OLT-ova na vrhu (ONT-ovi se dijele podjednako)
+    int depth;                  // razina splittera ispod OLT-a
+    int fanout;                 // djece-splittera po unutarnjem splitteru
+    int ratios[8];              // mješavina omjera (bira se jednoliko)
+    int ratio_n;
+    double faults;              // vjerojatnost kvara po linku (splitter i ONT)
+    double tx_dbm;              // parametri svakog OLT-a
+    double rxmin_dbm;
+} GenParams;
+
+typedef struct {
+    const GenParams* gp;
+    uint64_t rng;
+    long ont_left;              // ONT-ova preostalo za trenutni OLT
+    long next_id;
+    TextBuf buf;
+    FILE* f;
+} GenCtx;
+
+// vremena faza jednog --bench prolaza (sekunde)
+typedef struct {
+    double parse, compile, evaluate, sort, write;
+    size_t node_count;
+    int32_t ont_count;
+    size_t bytes;               // veličina datoteke topologije
+} BenchTimes;
+
+#if FTTH_STATS
+#define STATS_MAX_PHASES 24
+#define STATS_MAX_FILES 16
+
+// mjerenja jednog pokretanja; ispisuju se kao JSON na kraju
+typedef struct {
+    int on;
+    const char* out;
+    const char* mode;
+    const char* input;
+    int threads;
+    double t_start;
+    double t_phase;             // kraj prethodne faze
+    const char* phase_name[STATS_MAX_PHASES];
+    double phase_sec[STATS_MAX_PHASES];
+    int phase_n;
+    const char* file_name[STATS_MAX_FILES];
+    uint64_t file_bytes[STATS_MAX_FILES];
+    int file_n;
+    size_t lines;
+    size_t nodes;
+    int64_t onts;
+    atomic_llong allocs;        // alokacije iz niti evaluacije pa atomarno
+    atomic_llong alloc_bytes;
+} RunStats;
+
+#define STATS_ALLOC(bytes)       do { if (run_stats.on) stats_alloc(bytes); } while (0)
+#define STATS_PHASE(name)        do { if (run_stats.on) stats_phase(name); } while (0)
+#define STATS_FILE(name, bytes)  do { if (run_stats.on) stats_file(name, (uint64_t)(bytes)); } while (0)
+#define STATS_COUNTS(l, n, o)    do { run_stats.lines = (l); run_stats.nodes = (n); run_stats.onts = (o); } while (0)
+#define STATS_BEGIN(mode, input, threads) stats_begin(mode, input, threads)
+#define STATS_EMIT()             stats_emit()
+#else
+#define STATS_ALLOC(bytes)       ((void)0)
+#define STATS_PHASE(name)        ((void)0)
+#define STATS_FILE(name, bytes)  ((void)0)
+#define STATS_COUNTS(l, n, o)    ((void)0)
+#define STATS_BEGIN(mode, input, threads) ((void)0)
+#define STATS_EMIT()             ((void)0)
+#endif
+
+// kamo idu rezultati evaluacije; NULL polja se preskaču
+typedef struct {
+    CsvWriter* csv;             // ONT redci direktno u datoteku...
+    TextBuf* buf;               // ...ili u memorijski buffer
+    SplitterList* splitters;
+    TopN* top;                  // globalnih N najgorih
+    int splitter_k;             // K najgorih po splitteru (0 = isključeno)
+    SplitterWorstList* splitter_worst;
+    OntColumns* cols;           // ONT stupci za --bin
+    OltSummary* olts;           // agregat po OLT-u na vrhu (flat_olt_summaries)
+} EvalSink;
+
+TopN ont_top;
+
+#if FTTH_STATS
+static RunStats run_stats;
+static const char* stats_out = NULL;       // postavljeno s --stats
+#endif
+
+static OntKernelFn default_ont_kernel = NULL;
+
+// --------- constante optičke mreže ----------
+static const double ATTEN_DB_PER_KM = 0.35;   
+static const double CONN_LOSS_DB    = 0.50;
+static const double SPLICE_LOSS_DB  = 0.10;
+static const double SPLITTER_INS_DB = 1.00;   // insertion loss (uz idealni 10log10)
+// ------------------------------------------------
+
+static void die(const char* msg);
+#if FTTH_STATS
+static void stats_begin(const char* mode, const char* input, int threads);
+static void stats_alloc(size_t bytes);
+static void stats_phase(const char* name);
+static void stats_file(const char* name, uint64_t bytes);
+static void json_string(FILE* f, const char* s);
+static void stats_emit(void);
+#endif
+static void arena_init(NodeArena* a);
+static void arena_release(NodeArena* a);
+static void node_defaults(Node* n, NodeType t);
+static Node* node_new(NodeArena* a, NodeType t);
+static void node_add_child(Node* parent, Node* child);
+static void splitter_list_init(SplitterList* sl);
+static void splitter_list_push(SplitterList* sl, const SplitterRecord* rec);
+static int ont_worse(const OntResult* a, const OntResult* b);
+static void topn_init(TopN* h, int cap);
+static void topn_push(TopN* h, const OntResult* r);
+static void topn_sort(TopN* h);
+static void splitter_worst_list_init(SplitterWorstList* wl);
+static void splitter_worst_list_push(SplitterWorstList* wl, const SplitterWorst* w);
+static double now_sec(void);
+static void map_file(const char* filename, MappedFile* mf);
+static void map_file_ex(const char* filename, MappedFile* mf, int copy_on_write);
+static void unmap_file(MappedFile* mf);
+#ifndef _WIN32
+static void read_fd(int fd, MappedFile* mf);
+#endif
+static int is_space(char c);
+static int topo_line(const char* line, const char* eol, const char** s_out, const char** le_out);
+static NodeType parse_type(const char* tok, const char* end);
+static int parse_int(const char* v, const char* end);
+static double parse_double(const char* v, const char* end);
+static void apply_kv(Node* n, const char* key, size_t key_len, const char* val, const char* val_end);
+static int next_kv(const char** s, const char* end, const char** key, size_t* key_len, const char** val, const char** val_end);
+static void apply_kv_all(Node* n, const char* s, const char* end);
+static void parse_line(Node* n, const char* s, const char* end);
+static double splitter_loss_db(int ratio);
+static double node_link_loss_db(const LossParams* lp, const Node* n);
+static SubtreeStats stats_init(void);
+static SubtreeStats stats_ont(int status, double rx_dbm, double loss);
+static void stats_merge(SubtreeStats* a, const SubtreeStats* b);
+static void path_append(char* path, size_t cap, const char* part);
+static void node_path_part(char* part, size_t cap, NodeType type, const char* name, int name_len, int ratio, int id);
+static int32_t flat_root_ordinal(const FlatTopo* ft, int32_t r);
+static int32_t flat_root_of(const FlatTopo* ft, int32_t i);
+static int32_t flat_root_node(const FlatTopo* ft, int32_t k);
+static void splitter_record_fill(SplitterRecord* rec, const char* name, int name_len, int ratio, const SubtreeStats* st);
+static WalkFrame* walk_stack_push(WalkStack* ws);
+static size_t path_put(char* path, size_t cap, size_t len, const char* part);
+static SubtreeStats walk_and_compute(const Node* n, double parent_tx_dbm, double rxmin_dbm, double acc_loss_db,
+    double acc_dist_km, int down_flag, FILE* ont_csv, SplitterList* splitters, char* path, size_t path_cap);
+static SubtreeStats walk_and_compute_recursive(const Node* n, double parent_tx_dbm, double rxmin_dbm, double acc_loss_db,
+    double acc_dist_km, int down_flag, FILE* ont_csv, SplitterList* splitters, char* path, size_t path_cap);
+static void* xmalloc(size_t size);
+static void flat_node_store(FlatTopo* ft, int32_t i, int32_t ord, const Node* n);
+static void flat_node_load(const FlatTopo* ft, int32_t i, int32_t ord, Node* n);
+static void flat_compile(const Node* root, size_t node_count, FlatTopo* ft);
+static void flat_free(FlatTopo* ft);
+static uint32_t hash_int(uint32_t x);
+static uint32_t hash_name(const char* s, int32_t len);
+static uint32_t index_cap(int32_t count);
+static void flat_index_build(FlatTopo* ft);
+static int32_t flat_index_ont(const FlatTopo* ft, int32_t id);
+static int32_t flat_index_splitter(const FlatTopo* ft, int32_t root, const char* name, int32_t len);
+static void textbuf_reserve(TextBuf* b, size_t extra);
+static void textbuf_append(TextBuf* b, const char* s, size_t n);
+static char* fmt_int(char* p, int v);
+static char* fmt_fixed4(char* p, double v);
+static void csv_ont_row(TextBuf* b, int ont_id, double dist, double loss, double rx_dbm, double margin,
+    const char* status, const char* path, size_t path_len);
+static void* csv_writer_thread(void* arg);
+static void csv_writer_open(CsvWriter* w, const char* filename, int bg);
+static void csv_writer_flush(CsvWriter* w);
+static void csv_writer_append(CsvWriter* w, const char* s, size_t n);
+static void csv_writer_maybe_flush(CsvWriter* w);
+static void csv_writer_close(CsvWriter* w);
+static LossParams loss_params_default(void);
+static void eval_state_init(EvalState* es, const FlatTopo* ft);
+static void eval_state_free(EvalState* es);
+static void ont_kernel_scalar(const FlatTopo* ft, const LossParams* lp, EvalState* es, int32_t k0, int32_t k1);
+static OntKernelFn ont_kernel_select(const char* want);
+static const char* ont_kernel_name(OntKernelFn fn);
+static SubtreeStats flat_evaluate(const FlatTopo* ft, EvalSink* sink);
+static SubtreeStats flat_evaluate_parallel(const FlatTopo* ft, int threads, EvalSink* sink);
+static void flat_path(const FlatTopo* ft, int32_t node, char* path, size_t cap);
+static void bench_eval(const char* filename);
+static void bench_kernel(const char* filename);
+static void inc_node_stats(IncEngine* e, int32_t i);
+static void inc_eval_subtree(IncEngine* e, int32_t u);
+static void inc_total(IncEngine* e);
+static void inc_init(IncEngine* e, FlatTopo* ft);
+static void inc_update(IncEngine* e, int32_t u);
+static void inc_free(IncEngine* e);
+static int flat_match(const FlatTopo* ft, int32_t i, const char* key, size_t key_len, const char* val, const char* val_end);
+static int is_loss_key(const char* key, size_t key_len);
+static int is_selector(const char* key, size_t key_len);
+static int32_t flat_find(const FlatTopo* ft, const char* key, size_t key_len, const char* val, const char* val_end);
+static int32_t flat_select(const FlatTopo* ft, const char** s, const char* end);
+static void inc_set(IncEngine* e, int32_t u, const char* s, const char* end);
+static void run_updates(FlatTopo* ft, const char* filename);
+static void flat_load(const char* filename, Topology* topo, FlatTopo* ft);
+static uint64_t hash_mix64(uint64_t h, uint64_t v);
+static uint64_t dbl_bits(double v);
+static uint64_t* flat_subtree_hash(const FlatTopo* ft);
+static void diff_tree_init(DiffTree* d);
+static void diff_tree_free(DiffTree* d);
+static int32_t diff_partner(const DiffTree* a, int32_t i, const DiffTree* b);
+static int diff_same_context(const DiffTree* a, int32_t i, const DiffTree* b, int32_t j);
+static void diff_ont_row(DiffOut* out, const char* change, const DiffTree* o, int32_t i, const DiffTree* n, int32_t j);
+static void diff_splitter_row(DiffOut* out, const char* change, const DiffTree* o, int32_t i, const DiffTree* n, int32_t j);
+static void csv_splitter_row(TextBuf* b, const SplitterRecord* r);
+static void print_top(const TopN* top, int top_n, char (*paths)[512]);
+static void stream_close(StreamState* ss);
+static void stream_id_add(StreamState* ss, int32_t id);
+static void stream_line(StreamState* ss, const char* line, const char* eol);
+static void stream_line_fn(void* ctx, const char* line, const char* eol);
+static int read_lines(FILE* in, LineFn fn, void* ctx);
+static void run_stream(const char* filename, int top_n, int bg_writer);
+static void diff_scan(const DiffTree* a, const DiffTree* b, int forward, DiffOut* out);
+static void run_diff(const char* old_file, const char* new_file);
+static void loc_index_init(LocIndex* li, const FlatTopo* ft);
+static void loc_index_free(LocIndex* li);
+static int32_t loc_count(const int32_t* pos, int32_t count, int32_t lo, int32_t hi);
+static int cmp_int32(const void* a, const void* b);
+static const char* loc_type_name(uint8_t type);
+static int cmp_loc_candidate(const void* a, const void* b);
+static void loc_candidate_score(LocCandidate* c, const LocIndex* li, const int32_t* pos, int32_t count);
+static int32_t loc_lca(const FlatTopo* ft, const int32_t* pos, int32_t count);
+static void run_localize(const FlatTopo* ft, const char* filename, int top_n);
+static void csv_string(FILE* f, const char* s);
+static TelParams tel_params_default(void);
+static void tel_params_parse(TelParams* tp, const char* s);
+static void tel_init(TelState* t, const FlatTopo* ft, const TelParams* tp);
+static void tel_reset(TelState* t);
+static void tel_free(TelState* t);
+static void tel_sample(TelState* t, double ts, int32_t ont_id, double rx_dbm);
+static void tel_apply(TelState* t, int32_t k, double ts, double rx_dbm);
+static void tel_flush(TelState* t);
+static void tel_line(TelState* t, const char* line, const char* eol);
+static void tel_line_fn(void* ctx, const char* line, const char* eol);
+static int32_t tel_report(TelState* t, int top_n, uint8_t* flag, const char* csv_name);
+static void run_telemetry(const FlatTopo* ft, const char* filename, const TelParams* tp, int top_n);
+static void bench_telemetry(const char* filename, const TelParams* tp);
+static void opt_params_parse(OptParams* op, const char* s);
+static int opt_better(int goal, OptValue a, OptValue b);
+static double opt_state_gain(const OptState* o, int32_t u, int32_t state, int changed);
+static int32_t opt_kid_state(const OptState* o, int32_t u, int32_t state, int changed);
+static void opt_kid_set(OptState* o, int32_t u, int budget);
+static int32_t opt_fold(const OptState* o, OptScratch* w, int32_t lo, int32_t hi, int32_t cs, double gain,
+    OptValue* out, int32_t* split);
+static void opt_node(OptState* o, OptScratch* w, int32_t u);
+static void opt_scratch_init(OptScratch* w, int budget);
+static void opt_scratch_free(OptScratch* w);
+static void* opt_worker(void* arg);
+static void run_optimize(FlatTopo* ft, const OptParams* op, int threads);
+static void flat_clone(const FlatTopo* src, FlatTopo* dst);
+static void run_serve(const FlatTopo* ft, const char* sock_path);
+static void scenario_set_init(ScenarioSet* set);
+static void scenario_set_free(ScenarioSet* set);
+static Scenario* scenario_new(ScenarioSet* set, const char* name, size_t name_len, const LossParams* lp);
+static void scenario_add_edit(ScenarioSet* set, Scenario* sc, int32_t node, const char* kv, const char* kv_end);
+static void read_scenarios(const char* filename, const FlatTopo* ft, MappedFile* mf, ScenarioSet* set);
+static void scenario_scratch_init(ScenarioScratch* w, const FlatTopo* ft);
+static void scenario_scratch_free(ScenarioScratch* w);
+static void scenario_store(ScenarioScratch* w, int32_t i, int32_t ord, const Node* n);
+static ScenarioResult scenario_eval(ScenarioScratch* w, const FlatTopo* ft, const int32_t* ord,
+    const ScenarioSet* set, const Scenario* sc);
+static void* scenario_worker(void* arg);
+static void run_scenarios(const FlatTopo* ft, const char* filename, int threads);
+static void philox4x32(uint32_t ctr[4], uint32_t k0, uint32_t k1);
+static void mc_normals(uint64_t seed, uint32_t block, uint32_t node, double* z);
+static void p2_add(P2Quantile* s, double p, double x);
+static double p2_get(const P2Quantile* s, double p);
+static void mc_close(const McPool* pool, McFrame* stk, int* top, int lanes);
+static void mc_run_task(const McPool* pool, const McTask* t);
+static void* mc_worker(void* arg);
+static void run_monte_carlo(const FlatTopo* ft, long trials, uint64_t seed, const LossParams* lp, const McDist* dist, int threads);
+static void path_list_push(PathList* pl, const char* s);
+static int path_cmp(const void* a, const void* b);
+static int path_list_add_input(PathList* pl, const char* path);
+static void path_list_free(PathList* pl);
+static void shard_run(ShardPool* pool, int32_t s);
+static void* shard_worker(void* arg);
+static int cmp_shard_top(const void* a, const void* b);
+static void run_shards(const PathList* files, int threads, int top_n);
+static void write_splitter_csv(const char* filename, const SplitterList* sl);
+static void ont_columns_init(OntColumns* c, int32_t n);
+static void ont_columns_free(OntColumns* c);
+static void write_bin_file(const char* filename, const char* magic, uint64_t rows, int column_count,
+    const char* const* names, const char* const* dtypes, const size_t* widths, const void* const* data);
+static int32_t flat_splitter_rows(const FlatTopo* ft, int32_t* row);
+static void write_results_bin(const FlatTopo* ft, const OntColumns* oc, const SplitterList* sl);
+static uint64_t snap_checksum(uint64_t h, const uint8_t* p, size_t len);
+static uint64_t snap_file_checksum(const uint8_t* base, size_t len);
+static void write_snapshot(const char* filename, const FlatTopo* ft);
+static int snapshot_is(const char* filename);
+static void snapshot_load(const char* filename, Topology* topo, FlatTopo* ft);
+static void write_splitter_worst_csv(const char* filename, const SplitterWorstList* wl, const FlatTopo* ft);
+static void print_summary(const SubtreeStats* all, const OltSummary* olts, int olt_n);
+static OltSummary* flat_olt_summaries(const FlatTopo* ft, int* count);
+static void olt_csv_row(FILE* f, const char* source, const OltSummary* o);
+static void write_olt_csv(const char* filename, const char* source, const OltSummary* olts, int olt_n);
+static void print_stats(const SubtreeStats* all);
+int cmp_margin(const void* a, const void* b);
+static void read_topology(const char* filename, Topology* topo);
+static void parse_topology(Topology* topo);
+static size_t read_topology_stdio(const char* filename, size_t* line_count);
+static RefNode* ref_node_new(NodeType t);
+static void ref_node_add_child(RefNode* parent, RefNode* child);
+static char* ref_ltrim(char* s);
+static void ref_rtrim(char* s);
+static int ref_leading_spaces(const char* s);
+static NodeType ref_parse_type(const char* tok);
+static void ref_apply_kv(RefNode* n, const char* key, const char* val);
+static void ref_parse_line(RefNode* n, char* line_no_indent);
+static void parse_chunk(ParseChunk* c, int continues);
+static void parse_assign_ont_ids(ParseChunk* chunks, int count);
+static const char* parse_split_point(const char* p, const char* end);
+static void* parse_worker(void* arg);
+static void arena_append(NodeArena* dst, NodeArena* src);
+static void read_topology_parallel(const char* filename, Topology* topo, int threads);
+static void topology_free(Topology* topo);
+static void bench_parse(const char* filename, int threads);
+static uint64_t gen_next(uint64_t* s);
+static double gen_uniform(uint64_t* s, double lo, double hi);
+static GenParams gen_params_default(void);
+static void gen_params_parse(GenParams* gp, const char* s);
+static void gen_flush(GenCtx* g, int force);
+static void gen_splitter(GenCtx* g, int level, const char* prefix, int idx);
+static void gen_topology(const char* filename, const GenParams* gp);
+static size_t peak_rss_bytes(void);
+static void bench_phases(const char* filename, int threads, int bg_writer, BenchTimes* bt);
+static double bench_total(const BenchTimes* bt);
+static void bench_print(const BenchTimes* bt);
+static void bench_scale(const char* sizes, const GenParams* base, int threads, int bg_writer);
+void generate_report(const SubtreeStats* stats, const OltSummary* olts, int olt_n, char (*top_paths)[512]);
+
+int main(int argc, char** argv) {
+    const char* topo_file = NULL;
+    PathList shards = { NULL, 0, 0 };
+    int input_count = 0;
+    int input_dir = 0;
+    int threads = 1;
+    int top_n = TOP_N;
+    int bg_writer = 0;
+    int want_bin = 0;
+    int splitter_k = 0;
+    const char* updates_file = NULL;
+    const char* localize_file = NULL;
+    const char* telemetry_file = NULL;
+    OptParams opt = { 0, 0, { 2, 4, 8, 16, 32, 64 }, 6 };
+    int optimize = 0;
+    TelParams tel = tel_params_default();
+    const char* scenario_file = NULL;
+    const char* serve_path = NULL;
+    const char* snapshot_out = NULL;
+    const char* diff_file = NULL;
+    int stream = 0;
+    const char* gen_file = NULL;
+    const char* bench_file = NULL;
+    const char* bench_sizes = NULL;
+    GenParams gen = gen_params_default();
+    long mc_trials = 0;
+    uint64_t mc_seed = 1;
+    LossParams mc_lp = loss_params_default();
+    McDist mc_dist = { 0.02, 0.15, 0.03, 0.30 };
+
+    // kernel se bira prije pokretanja ijedne dretve (--kernel ga može zamijeniti)
+    default_ont_kernel = ont_kernel_select(NULL);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench-parse") == 0 && i + 1 < argc) {
+            bench_parse(argv[i + 1], threads);
+            return 0;
+        } else if (strcmp(argv[i], "--bench-eval") == 0 && i + 1 < argc) {
+            bench_eval(argv[i + 1]);
+            return 0;
+        } else if (strcmp(argv[i], "--bench-kernel") == 0 && i + 1 < argc) {
+            bench_kernel(argv[i + 1]);
+            return 0;
+        } else if (strcmp(argv[i], "--bench-telemetry") == 0 && i + 1 < argc) {
+            bench_telemetry(argv[i + 1], &tel);
+            return 0;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_file = argv[++i];
+        } else if (strcmp(argv[i], "--bench-scale") == 0 && i + 1 < argc) {
+            bench_sizes = argv[++i];
+        } else if (strcmp(argv[i], "--gen") == 0 && i + 1 < argc) {
+            gen_file = argv[++i];
+        } else if (strcmp(argv[i], "--gen-opts") == 0 && i + 1 < argc) {
+            // "onts=1000000 seed=1 olts=1 depth=2 fanout=4 ratios=4,8,16 faults=0.01 tx=3 rxmin=-27"
+            gen_params_parse(&gen, argv[++i]);
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            default_ont_kernel = ont_kernel_select(argv[++i]);
+        } else if (strcmp(argv[i], "--mc") == 0 && i + 1 < argc) {
+            mc_trials = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--mc-seed") == 0 && i + 1 < argc) {
+            mc_seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mc-dist") == 0 && i + 1 < argc) {
+            // "atten=0.35 atten_sd=0.02 conn_loss=0.5 conn_sd=0.15 ..." (ključevi kao u scenarijima + _sd)
+            const char* q = argv[++i];
+            const char* qe = q + strlen(q);
+            const char *key, *val, *val_end;
+            size_t key_len;
+            while (next_kv(&q, qe, &key, &key_len, &val, &val_end)) {
+                double v = parse_double(val, val_end);
+                if (key_len == 5 && memcmp(key, "atten", 5) == 0) mc_lp.atten_db_per_km = v;
+                else if (key_len == 9 && memcmp(key, "conn_loss", 9) == 0) mc_lp.conn_loss_db = v;
+                else if (key_len == 11 && memcmp(key, "splice_loss", 11) == 0) mc_lp.splice_loss_db = v;
+                else if (key_len == 8 && memcmp(key, "ins_loss", 8) == 0) mc_lp.splitter_ins_db = v;
+                else if (key_len == 8 && memcmp(key, "atten_sd", 8) == 0) mc_dist.atten_sd = v;
+                else if (key_len == 7 && memcmp(key, "conn_sd", 7) == 0) mc_dist.conn_sd = v;
+                else if (key_len == 9 && memcmp(key, "splice_sd", 9) == 0) mc_dist.splice_sd = v;
+                else if (key_len == 6 && memcmp(key, "ins_sd", 6) == 0) mc_dist.ins_sd = v;
+            }
+        } else if (strcmp(argv[i], "--scenarios") == 0 && i + 1 < argc) {
+            scenario_file = argv[++i];
+        } else if (strcmp(argv[i], "--updates") == 0 && i + 1 < argc) {
+            updates_file = argv[++i];
+        } else if (strcmp(argv[i], "--localize") == 0 && i + 1 < argc) {
+            localize_file = argv[++i];
+        } else if (strcmp(argv[i], "--optimize") == 0 && i + 1 < argc) {
+            // samo znamenke (atoi bi "abc" ili "5x" tiho pretvorio u broj); veliki budžet se ionako
+            // svodi na broj kandidata
+            const char* b = argv[++i];
+            if (*b == '\0' || strspn(b, "0123456789") != strlen(b)) {
+                die("--optimize: budzet mora biti nenegativan cijeli broj");
+            }
+            long long v = 0;
+            for (; *b; b++) {
+                v = v * 10 + (*b - '0');
+                if (v > 1000000000LL) v = 1000000000LL;
+            }
+            opt.budget = (int)v;
+            optimize = 1;
+        } else if (strcmp(argv[i], "--optimize-opts") == 0 && i + 1 < argc) {
+            // "goal=fail|margin ratios=4,8,16,32,64"
+            opt_params_parse(&opt, argv[++i]);
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetry_file = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry-opts") == 0 && i + 1 < argc) {
+            // "alpha=0.05 drift=1.5 min_samples=20" (+ samples, seed, degraded za --bench-telemetry)
+            tel_params_parse(&tel, argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc) {
+            snapshot_out = argv[++i];
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            diff_file = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+#if FTTH_STATS
+            stats_out = "stats.json";
+#else
+            fprintf(stderr, "Instrumentacija nije ukljucena u ovu izvrsnu datoteku (FTTH_STATS=0)\n");
+#endif
+        } else if (strcmp(argv[i], "--bin") == 0) {
+            want_bin = 1;
+        } else if (strcmp(argv[i], "--bg-writer") == 0) {
+            bg_writer = 1;
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top_n = atoi(argv[++i]);
+            if (top_n < 0) top_n = 0;
+        } else if (strcmp(argv[i], "--splitter-top") == 0 && i + 1 < argc) {
+            splitter_k = atoi(argv[++i]);
+            if (splitter_k < 0) splitter_k = 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) threads = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            printf("Nepoznata opcija %s\n", argv[i]);
+            return 1;
+        } else {
+            if (!topo_file) topo_file = argv[i];
+            input_dir |= path_list_add_input(&shards, argv[i]);
+            input_count++;
+        }
+    }
+
+    if (gen_file) {
+        gen_topology(gen_file, &gen);
+        printf("Stvorena topologija %s (%ld ONT-ova, seed %llu)\n", gen_file, gen.onts, (unsigned long long)gen.seed);
+        return 0;
+    }
+    if (bench_file) {
+        BenchTimes bt;
+        bench_phases(bench_file, threads, bg_writer, &bt);
+        bench_print(&bt);
+        return 0;
+    }
+    if (bench_sizes) {
+        bench_scale(bench_sizes, &gen, threads, bg_writer);
+        return 0;
+    }
+
+    if (!topo_file) {
+        printf("Koristimo %s [--threads N] [--bg-writer] [--bin] [--stats] [--top N] [--splitter-top K] [--kernel scalar|avx2|avx512] ftth_topology.txt\n", argv[0]);
+        printf("           %s --save-snapshot mreza.snap ftth_topology.txt   (mreza.snap se zatim daje umjesto .txt)\n", argv[0]);
+        printf("           %s [--threads N] [--top N] topologija1.txt topologija2.txt ... | direktorij/\n", argv[0]);
+        printf("           %s --updates promjene.txt ftth_topology.txt\n", argv[0]);
+        printf("           %s --serve /tmp/ftth.sock ftth_topology.txt\n", argv[0]);
+        printf("           %s --diff stara_topologija.txt nova_topologija.txt\n", argv[0]);
+        printf("           %s [--top N] --localize alarmi.txt ftth_topology.txt\n", argv[0]);
+        printf("           %s [--threads N] --optimize BUDZET [--optimize-opts \"goal=fail|margin ratios=4,8,16,32,64\"] ftth_topology.txt\n", argv[0]);
+        printf("           %s [--telemetry-opts \"alpha=0.05 drift=1.5 min_samples=20\"] --telemetry mjerenja.csv|- ftth_topology.txt\n", argv[0]);
+        printf("           %s [--top N] --stream ftth_topology.txt | zcat mreza.txt.gz | %s -\n", argv[0], argv[0]);
+        printf("           %s [--threads N] --scenarios scenariji.txt ftth_topology.txt\n", argv[0]);
+        printf("           %s [--threads N] --mc TRIALS [--mc-seed S] [--mc-dist \"atten_sd=.. conn_sd=..\"] ftth_topology.txt\n", argv[0]);
+        printf("           %s --gen izlaz.txt [--gen-opts \"onts=N seed=S olts=1 depth=2 fanout=4 ratios=4,8,16 faults=0.01 tx=3 rxmin=-27\"]\n", argv[0]);
+        printf("           %s [--threads N] [--bg-writer] --bench ftth_topology.txt\n", argv[0]);
+        printf("           %s [--threads N] [--gen-opts \"...\"] --bench-scale \"1000 100000 10000000\"\n", argv[0]);
+        printf("           %s --bench-parse ftth_topology.txt\n", argv[0]);
+        printf("           %s --bench-eval ftth_topology.txt\n", argv[0]);
+        printf("           %s --bench-kernel ftth_topology.txt\n", argv[0]);
+        printf("           %s [--telemetry-opts \"samples=5e6 seed=1 degraded=3\"] --bench-telemetry ftth_topology.txt\n", argv[0]);
+        return 1;
+    }
+
+    if (input_count > 1 || input_dir) {
+        if (mc_trials > 0 || scenario_file || updates_file || serve_path || diff_file || localize_file || telemetry_file ||
+            optimize) {
+            die("--mc, --scenarios, --updates, --serve, --diff, --localize, --telemetry i --optimize rade nad jednom datotekom topologije");
+        }
+        STATS_BEGIN("shards", topo_file, threads);
+        run_shards(&shards, threads, top_n);
+        STATS_PHASE("shards");
+        STATS_EMIT();
+        path_list_free(&shards);
+        return 0;
+    }
+    path_list_free(&shards);
+
+    if (diff_file) {
+        STATS_BEGIN("diff", topo_file, threads);
+        run_diff(diff_file, topo_file);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (stream || strcmp(topo_file, "-") == 0) {
+        if (mc_trials > 0 || scenario_file || updates_file || serve_path || localize_file || telemetry_file || optimize ||
+            snapshot_out || want_bin || splitter_k > 0) {
+            die("--stream daje samo ont_results.csv, splitter_results.csv i report.txt");
+        }
+        STATS_BEGIN("stream", topo_file, 1);
+        run_stream(topo_file, top_n, bg_writer);
+        STATS_EMIT();
+        return 0;
+    }
+
+    STATS_BEGIN(mc_trials > 0 ? "mc" : scenario_file ? "scenarios" : updates_file ? "updates" : serve_path ? "serve" :
+        localize_file ? "localize" : telemetry_file ? "telemetry" : optimize ? "optimize" : "run",
+        topo_file, threads);
+
+    Topology topo;
+    FlatTopo ft;
+    if (snapshot_is(topo_file)) {
+        snapshot_load(topo_file, &topo, &ft);
+        STATS_PHASE("snapshot");
+    } else {
+        read_topology_parallel(topo_file, &topo, threads);
+        STATS_PHASE("parse");
+
+        // Node stablo služi samo za parsiranje; dalje radimo nad nizovima
+        flat_compile(topo.root, topo.node_count, &ft);
+        arena_release(&topo.arena);
+        topo.root = NULL;
+        STATS_PHASE("compile");
+    }
+    STATS_COUNTS(topo.line_count, topo.node_count, ft.ont_count);
+
+    if (snapshot_out) {
+        write_snapshot(snapshot_out, &ft);
+        STATS_PHASE("save_snapshot");
+        flat_free(&ft);
+        topology_free(&topo);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (mc_trials > 0) {
+        run_monte_carlo(&ft, mc_trials, mc_seed, &mc_lp, &mc_dist, threads);
+        STATS_PHASE("mc");
+        flat_free(&ft);
+        unmap_file(&topo.src);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (scenario_file) {
+        run_scenarios(&ft, scenario_file, threads);
+        STATS_PHASE("scenarios");
+        flat_free(&ft);
+        unmap_file(&topo.src);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (updates_file) {
+        run_updates(&ft, updates_file);
+        STATS_PHASE("updates");
+        flat_free(&ft);
+        unmap_file(&topo.src);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (localize_file) {
+        run_localize(&ft, localize_file, top_n);
+        STATS_PHASE("localize");
+        flat_free(&ft);
+        topology_free(&topo);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (optimize) {
+        run_optimize(&ft, &opt, threads);
+        STATS_PHASE("optimize");
+        flat_free(&ft);
+        topology_free(&topo);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (telemetry_file) {
+        run_telemetry(&ft, telemetry_file, &tel, top_n);
+        flat_free(&ft);
+        topology_free(&topo);
+        STATS_EMIT();
+        return 0;
+    }
+
+    if (serve_path) {
+        run_serve(&ft, serve_path);
+        STATS_PHASE("serve");
+        STATS_EMIT();
+        return 0;
+    }
+
+    int olt_n = 0;
+    OltSummary* olts = flat_olt_summaries(&ft, &olt_n);
+
+    CsvWriter ont_csv;
+    csv_writer_open(&ont_csv, "ont_results.csv", bg_writer);
+    static const char ONT_CSV_HEADER[] = "ont_id,total_dist_km,total_loss_db,rx_dbm,margin_db,status,path\n";
+    csv_writer_append(&ont_csv, ONT_CSV_HEADER, sizeof(ONT_CSV_HEADER) - 1);
+
+    SplitterList splitters;
+    splitter_list_init(&splitters);
+
+    EvalSink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.csv = &ont_csv;
+    sink.splitters = &splitters;
+    topn_init(&ont_top, top_n);
+    sink.top = &ont_top;
+
+    SplitterWorstList splitter_worst;
+    splitter_worst_list_init(&splitter_worst);
+    sink.splitter_k = splitter_k;
+    sink.splitter_worst = &splitter_worst;
+    sink.olts = olts;
+
+    OntColumns cols;
+    if (want_bin) {
+        ont_columns_init(&cols, ft.ont_count);
+        sink.cols = &cols;
+    }
+
+    SubtreeStats all = (threads > 1)
+        ? flat_evaluate_parallel(&ft, threads, &sink)
+        : flat_evaluate(&ft, &sink);
+
+    csv_writer_close(&ont_csv);
+    STATS_PHASE("evaluate");
+
+    write_splitter_csv("splitter_results.csv", &splitters);
+    STATS_PHASE("splitter_csv");
+    if (want_bin) {
+        write_results_bin(&ft, &cols, &splitters);
+        ont_columns_free(&cols);
+        STATS_PHASE("bin");
+    }
+
+    // više OLT-ova na vrhu: redak po OLT-u kao u načinu s više datoteka
+    if (olt_n > 1) {
+        write_olt_csv("olt_results.csv", topo_file, olts, olt_n);
+        STATS_PHASE("olt_csv");
+    }
+    print_summary(&all, olts, olt_n);
+
+    // hrpa je punjena tijekom prolaza; sortira se samo N zapisa
+    topn_sort(&ont_top);
+    STATS_PHASE("sort");
+
+    char (*top_paths)[512] = (char (*)[512])xmalloc((size_t)(ont_top.n ? ont_top.n : 1) * 512);
+    for (int i = 0; i < ont_top.n; i++) {
+        flat_path(&ft, ont_top.arr[i].node, top_paths[i], sizeof(top_paths[i]));
+    }
+    print_top(&ont_top, top_n, top_paths);
+
+    if (splitter_k > 0) {
+        write_splitter_worst_csv("splitter_worst.csv", &splitter_worst, &ft);
+        STATS_PHASE("splitter_worst");
+    }
+
+    printf("\nStvorene datoteke:\n");
+    printf(" - ont_results.csv\n");
+    printf(" - splitter_results.csv\n");
+    if (splitter_k > 0) {
+        printf(" - splitter_worst.csv\n");
+    }
+    if (olt_n > 1) {
+        printf(" - olt_results.csv\n");
+    }
+    if (want_bin) {
+        printf(" - ont_results.bin\n");
+        printf(" - splitter_results.bin\n");
+    }
+
+    generate_report(&all, olts, olt_n, top_paths);
+    printf("\nStvoren report.txt\n");
+    STATS_PHASE("report");
+
+    free(top_paths);
+    free(olts);
+    free(splitters.arr);
+    free(ont_top.arr);
+    free(splitter_worst.arr);
+    flat_free(&ft);
+    topology_free(&topo);
+    STATS_EMIT();
+    return 0;
+}
+
+static void die(const char* msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+    exit(1);
+}
+
+#if FTTH_STATS
+// uključuje mjerenje ako je zadan --stats ili varijabla okoline FTTH_STATS (putanja ili "1")
+static void stats_begin(const char* mode, const char* input, int threads) {
+    const char* env = getenv("FTTH_STATS");
+    const char* out = stats_out;
+    if (!out && env && env[0] && strcmp(env, "0") != 0) {
+        out = (strcmp(env, "1") == 0) ? "stats.json" : env;
+    }
+    if (!out) return;
+
+    run_stats.on = 1;
+    run_stats.out = out;
+    run_stats.mode = mode;
+    run_stats.input = input;
+    run_stats.threads = threads;
+    run_stats.t_start = now_sec();
+    run_stats.t_phase = run_stats.t_start;
+}
+
+static void stats_alloc(size_t bytes) {
+    atomic_fetch_add_explicit(&run_stats.allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&run_stats.alloc_bytes, (long long)bytes, memory_order_relaxed);
+}
+
+// faza traje od kraja prethodne faze do sada
+static void stats_phase(const char* name) {
+    double t = now_sec();
+    if (run_stats.phase_n < STATS_MAX_PHASES) {
+        run_stats.phase_name[run_stats.phase_n] = name;
+        run_stats.phase_sec[run_stats.phase_n] = t - run_stats.t_phase;
+        run_stats.phase_n++;
+    }
+    run_stats.t_phase = t;
+}
+
+static void stats_file(const char* name, uint64_t bytes) {
+    if (run_stats.file_n < STATS_MAX_FILES) {
+        run_stats.file_name[run_stats.file_n] = name;
+        run_stats.file_bytes[run_stats.file_n] = bytes;
+        run_stats.file_n++;
+    }
+}
+
+static void json_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void stats_emit(void) {
+    if (!run_stats.on) return;
+    FILE* f = fopen(run_stats.out, "w");
+    if (!f) {
+        fprintf(stderr, "Nemoguce je zapisati %s\n", run_stats.out);
+        return;
+    }
+    fprintf(f, "{\n  \"mode\": ");
+    json_string(f, run_stats.mode);
+    fprintf(f, ",\n  \"input\": ");
+    json_string(f, run_stats.input);
+    fprintf(f, ",\n  \"threads\": %d,\n", run_stats.threads);
+    fprintf(f, "  \"lines\": %zu,\n  \"nodes\": %zu,\n  \"onts\": %lld,\n",
+        run_stats.lines, run_stats.nodes, (long long)run_stats.onts);
+    fprintf(f, "  \"total_sec\": %.6f,\n  \"phases\": [", now_sec() - run_stats.t_start);
+    for (int i = 0; i < run_stats.phase_n; i++) {
+        fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+        json_string(f, run_stats.phase_name[i]);
+        fprintf(f, ", \"sec\": %.6f}", run_stats.phase_sec[i]);
+    }
+    fprintf(f, "\n  ],\n  \"allocs\": %lld,\n  \"alloc_bytes\": %lld,\n  \"files\": [",
+        (long long)atomic_load(&run_stats.allocs), (long long)atomic_load(&run_stats.alloc_bytes));
+    for (int i = 0; i < run_stats.file_n; i++) {
+        fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+        json_string(f, run_stats.file_name[i]);
+        fprintf(f, ", \"bytes\": %llu}", (unsigned long long)run_stats.file_bytes[i]);
+    }
+    fprintf(f, "\n  ],\n  \"peak_rss_bytes\": %zu\n}\n", peak_rss_bytes());
+    fclose(f);
+}
+#endif
+
+static void arena_init(NodeArena* a) {
+    a->head = NULL;
+    a->count = 0;
+}
+
+// oslobađa sve čvorove odjednom (po blokovima, bez obilaska stabla)
+static void arena_release(NodeArena* a) {
+    ArenaBlock* b = a->head;
+    while (b) {
+        ArenaBlock* next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = NULL;
+    a->count = 0;
+}
+
+// prebacuje sve blokove iz src u dst (čvorovi ostaju na mjestu)
+static void arena_append(NodeArena* dst, NodeArena* src) {
+    if (!src->head) return;
+    ArenaBlock* tail = src->head;
+    while (tail->next) tail = tail->next;
+    tail->next = dst->head;
+    dst->head = src->head;
+    dst->count += src->count;
+    arena_init(src);
+}
+
+static Node* node_new(NodeArena* a, NodeType t) {
+    ArenaBlock* b = a->head;
+    if (!b || b->used == b->cap) {
+        // blokovi rastu 2x, od 1024 do 65536 čvorova
+        size_t cap = b ? b->cap * 2 : 1024;
+        if (cap > 65536) cap = 65536;
+        ArenaBlock* nb = (ArenaBlock*)malloc(sizeof(ArenaBlock) + cap * sizeof(Node));
+        if (!nb) {
+            die("Nema slobodne memorije");
+        }
+        STATS_ALLOC(sizeof(ArenaBlock) + cap * sizeof(Node));
+        nb->next = b;
+        nb->used = 0;
+        nb->cap = cap;
+        a->head = nb;
+        b = nb;
+    }
+    Node* n = &b->nodes[b->used++];
+    a->count++;
+    node_defaults(n, t);
+    return n;
+}
+
+// zadane vrijednosti čvora prije parse_line
+static void node_defaults(Node* n, NodeType t) {
+    memset(n, 0, sizeof(Node));
+    n->type = t;
+    n->splitter_ratio = 0;
+    n->ont_id = -1;
+    n->olt_tx_dbm = 3.0;
+    n->gpon_rxmin_dbm = -27.0;
+    n->faulty = 0;
+    n->extra_loss_db = 0.0;
+    n->name = NULL;
+    n->name_len = 0;
+}
+
+static void node_add_child(Node* parent, Node* child) {
+    if (!parent->child) {
+        parent->child = child;
+    } else {
+        parent->last_child->sibling = child;
+    }
+    parent->last_child = child;
+}
+
+static void splitter_list_init(SplitterList* sl) {
+    sl->arr = NULL; 
+    sl->n = 0; 
+    sl->cap = 0;
+}
+
+static void splitter_list_push(SplitterList* sl, const SplitterRecord* rec) {
+    if (sl->n == sl->cap) {
+        size_t newcap = sl->cap ? sl->cap * 2 : 16;
+        SplitterRecord* p = (SplitterRecord*)realloc(sl->arr, newcap * sizeof(SplitterRecord));
+
+        if (!p) {
+            die("Nema slobodne memorije (realloc)");
+        }
+        STATS_ALLOC(newcap * sizeof(SplitterRecord));
+        sl->arr = p;
+        sl->cap = newcap;
+    }
+    sl->arr[sl->n++] = *rec;
+}
+
+// a je "gori" od b: manja margina, a kod jednake margine raniji u preorderu
+static int ont_worse(const OntResult* a, const OntResult* b) {
+    if (a->margin_db != b->margin_db) {
+        return a->margin_db < b->margin_db;
+    }
+    return a->node < b->node;
+}
+
+static void topn_init(TopN* h, int cap) {
+    h->arr = (cap > 0) ? (OntResult*)xmalloc((size_t)cap * sizeof(OntResult)) : NULL;
+    h->n = 0;
+    h->cap = cap;
+}
+
+// O(log N) po ONT-u; kad je hrpa puna, novi ONT ulazi samo ako je gori od vrha
+static void topn_push(TopN* h, const OntResult* r) {
+    if (h->cap <= 0) return;
+
+    int i;
+    if (h->n < h->cap) {
+        i = h->n++;
+        while (i > 0) {
+            int p = (i - 1) / 2;
+            if (!ont_worse(&h->arr[p], r)) break;
+            h->arr[i] = h->arr[p];
+            i = p;
+        }
+        h->arr[i] = *r;
+        return;
+    }
+
+    if (!ont_worse(r, &h->arr[0])) return;
+    i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= h->n) break;
+        if (c + 1 < h->n && ont_worse(&h->arr[c], &h->arr[c + 1])) c++;
+        if (!ont_worse(r, &h->arr[c])) break;
+        h->arr[i] = h->arr[c];
+        i = c;
+    }
+    h->arr[i] = *r;
+}
+
+// poredak od najgoreg prema boljem (nakon ovoga arr više nije hrpa)
+static void topn_sort(TopN* h) {
+    qsort(h->arr, (size_t)h->n, sizeof(OntResult), cmp_margin);
+}
+
+static void splitter_worst_list_init(SplitterWorstList* wl) {
+    wl->arr = NULL;
+    wl->n = 0;
+    wl->cap = 0;
+}
+
+static void splitter_worst_list_push(SplitterWorstList* wl, const SplitterWorst* w) {
+    if (wl->n == wl->cap) {
+        size_t newcap = wl->cap ? wl->cap * 2 : 64;
+        SplitterWorst* p = (SplitterWorst*)realloc(wl->arr, newcap * sizeof(SplitterWorst));
+
+        if (!p) {
+            die("Nema slobodne memorije (realloc)");
+        }
+        STATS_ALLOC(newcap * sizeof(SplitterWorst));
+        wl->arr = p;
+        wl->cap = newcap;
+    }
+    wl->arr[wl->n++] = *w;
+}
+
+// visoko-rezolucijsko vrijeme u sekundama (za mjerenje brzine)
+static double now_sec(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double)c.QuadPart / (double)f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// mapira cijelu datoteku u memoriju samo za čitanje (bez kopiranja u buffer)
+static void map_file(const char* filename, MappedFile* mf) {
+    map_file_ex(filename, mf, 0);
+}
+
+// copy_on_write = 1: stranice su zapisive, ali promjene ostaju privatne procesu (snapshot
+// nizovi koje --updates/--serve mijenjaju na mjestu)
+static void map_file_ex(const char* filename, MappedFile* mf, int copy_on_write) {
+    mf->data = NULL;
+    mf->len = 0;
+    mf->owned = 0;
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) {
+        die("Nemoguce je otvoriti datoteku ftth_topology.txt");
+    }
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(fh, &sz)) {
+        die("Nemoguce je procitati velicinu datoteke topologije");
+    }
+    mf->len = (size_t)sz.QuadPart;
+    if (mf->len > 0) {
+        HANDLE mh = CreateFileMappingA(fh, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        if (!mh) {
+            die("Nemoguce je mapirati datoteku topologije");
+        }
+        mf->data = (const char*)MapViewOfFile(mh, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mh);
+        if (!mf->data) {
+            die("Nemoguce je mapirati datoteku topologije");
+        }
+    }
+    CloseHandle(fh);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        die("Nemoguce je otvoriti datoteku ftth_topology.txt");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        die("Nemoguce je procitati velicinu datoteke topologije");
+    }
+    if (!S_ISREG(st.st_mode)) {
+        // /dev/stdin, FIFO, ...: st_size je 0 pa se čita do kraja u buffer
+        read_fd(fd, mf);
+        close(fd);
+        return;
+    }
+    mf->len = (size_t)st.st_size;
+    if (mf->len > 0) {
+        void* p = mmap(NULL, mf->len, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            die("Nemoguce je mapirati datoteku topologije");
+        }
+#ifdef MADV_SEQUENTIAL
+        if (!copy_on_write) {
+            madvise(p, mf->len, MADV_SEQUENTIAL);
+        }
+#endif
+        mf->data = (const char*)p;
+    }
+    close(fd);
+#endif
+}
+
+#ifndef _WIN32
+static void read_fd(int fd, MappedFile* mf) {
+    size_t cap = CSV_FLUSH_BYTES;
+    char* buf = (char*)xmalloc(cap);
+    size_t len = 0;
+    for (;;) {
+        if (len == cap) {
+            cap *= 2;
+            char* nb = (char*)realloc(buf, cap);
+            if (!nb) {
+                die("Nema slobodne memorije");
+            }
+            buf = nb;
+        }
+        ssize_t got = read(fd, buf + len, cap - len);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            die("Greska pri citanju datoteke topologije");
+        }
+        if (got == 0) break;
+        len += (size_t)got;
+    }
+    mf->data = buf;
+    mf->len = len;
+    mf->owned = 1;
+}
+#endif
+
+static void unmap_file(MappedFile* mf) {
+    if (!mf->data) return;
+    if (mf->owned) {
+        free((void*)mf->data);
+        mf->data = NULL;
+        mf->len = 0;
+        mf->owned = 0;
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)mf->data);
+#else
+    munmap((void*)mf->data, mf->len);
+#endif
+    mf->data = NULL;
+    mf->len = 0;
+}
+
+// isto kao isspace() za ASCII, ali bez locale poziva
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// jedna linija topologije bez kopiranja: sadržaj bez rubnih razmaka u [*s_out, *le_out) i dubina
+// po uvlaci (2 razmaka po razini); -1 za praznu liniju ili komentar
+static int topo_line(const char* line, const char* eol, const char** s_out, const char** le_out) {
+    // rtrim / ltrim bez kopiranja
+    const char* le = eol;
+    while (le > line && is_space(le[-1])) le--;
+    const char* s = line;
+    while (s < le && is_space(*s)) s++;
+
+    if (s == le) return -1;
+    if (*s == '#') return -1;
+
+    int spaces = 0;
+    while (line + spaces < le && line[spaces] == ' ') spaces++;
+    if (spaces % 2 != 0) {
+        die("Uvlaka mora biti paran broj razmaka");
+    }
+
+    int depth = spaces / 2;
+    *s_out = s;
+    *le_out = le;
+    return depth;
+}
+
+static NodeType parse_type(const char* tok, const char* end) {
+    size_t n = (size_t)(end - tok);
+    if (n == 3 && memcmp(tok, "OLT", 3) == 0) {
+        return NODE_OLT;
+    }
+    if (n == 8 && memcmp(tok, "SPLITTER", 8) == 0) {
+        return NODE_SPLITTER;
+    }
+    if (n == 3 && memcmp(tok, "ONT", 3) == 0) {
+        return NODE_ONT;
+    }
+    die("Nepoznati node type (ocekivani su OLT/SPLITTER/ONT)");
+    return NODE_ONT;
+}
+
+// ponaša se kao strtol(v, NULL, 10), ali čita samo do end
+static int parse_int(const char* v, const char* end) {
+    int neg = 0;
+    if (v < end && (*v == '+' || *v == '-')) {
+        neg = (*v == '-');
+        v++;
+    }
+    long long x = 0;
+    while (v < end && *v >= '0' && *v <= '9') {
+        if (x < 10000000000LL) {
+            x = x * 10 + (*v - '0');
+        }
+        v++;
+    }
+    return (int)(neg ? -x : x);
+}
+
+// brzi parser decimalnog broja; za "obične" vrijednosti (do 15 znamenki, eksponent do 22)
+// rezultat je točno zaokružen kao i strtod, a sve ostalo ide preko strtod
+static double parse_double(const char* v, const char* end) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* p = v;
+    int neg = 0;
+    if (p < end && (*p == '+' || *p == '-')) {
+        neg = (*p == '-');
+        p++;
+    }
+
+    unsigned long long mant = 0;
+    int digits = 0;
+    int exp10 = 0;
+    int any = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (mant || *p != '0') {
+            mant = mant * 10 + (unsigned)(*p - '0');
+            digits++;
+        }
+        any = 1;
+        p++;
+        if (digits > 15) goto slow;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (mant || *p != '0') {
+                mant = mant * 10 + (unsigned)(*p - '0');
+                digits++;
+            }
+            exp10--;
+            any = 1;
+            p++;
+            if (digits > 15) goto slow;
+        }
+    }
+    if (!any) {
+        // inf/nan/hex ili nema broja - prepuštamo strtod
+        goto slow;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        int eneg = 0;
+        if (q < end && (*q == '+' || *q == '-')) {
+            eneg = (*q == '-');
+            q++;
+        }
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            while (q < end && *q >= '0' && *q <= '9') {
+                if (e < 10000) e = e * 10 + (*q - '0');
+                q++;
+            }
+            exp10 += eneg ? -e : e;
+        }
+    }
+    if (exp10 < -22 || exp10 > 22) goto slow;
+    {
+        double d = (double)mant;
+        d = (exp10 < 0) ? d / pow10[-exp10] : d * pow10[exp10];
+        return neg ? -d : d;
+    }
+
+slow:
+    {
+        char buf[128];
+        size_t n = (size_t)(end - v);
+        if (n >= sizeof(buf)) n = sizeof(buf) - 1;
+        memcpy(buf, v, n);
+        buf[n] = '\0';
+        return strtod(buf, NULL);
+    }
+}
+
+// key=value; ključ se prepoznaje po duljini pa po sadržaju (bez lanca strcmp poziva)
+static void apply_kv(Node* n, const char* key, size_t key_len, const char* val, const char* val_end) {
+    switch (key_len) {
+    case 2:
+        if (key[0] == 'k' && key[1] == 'm') {
+            n->len_km = parse_double(val, val_end);
+        } else if (key[0] == 's' && key[1] == 'p') {
+            n->splices = parse_int(val, val_end);
+        } else if (key[0] == 'i' && key[1] == 'd') {
+            n->ont_id = parse_int(val, val_end);
+        } else if (key[0] == 't' && key[1] == 'x') {
+            n->olt_tx_dbm = parse_double(val, val_end);
+        }
+        break;
+    case 3:
+        if (memcmp(key, "len", 3) == 0) {
+            n->len_km = parse_double(val, val_end);
+        }
+        break;
+    case 4:
+        if (memcmp(key, "conn", 4) == 0) {
+            n->connectors = parse_int(val, val_end);
+        } else if (memcmp(key, "name", 4) == 0) {
+            n->name = val;
+            n->name_len = (int)(val_end - val);
+        }
+        break;
+    case 5:
+        if (memcmp(key, "ratio", 5) == 0) {
+            n->splitter_ratio = parse_int(val, val_end);
+        } else if (memcmp(key, "rxmin", 5) == 0) {
+            n->gpon_rxmin_dbm = parse_double(val, val_end);
+        } else if (memcmp(key, "extra", 5) == 0) {
+            n->extra_loss_db = parse_double(val, val_end);
+        }
+        break;
+    case 6:
+        if (memcmp(key, "faulty", 6) == 0) {
+            n->faulty = parse_int(val, val_end) ? 1 : 0;
+        }
+        break;
+    default:
+        break;
+    }
+    // nepoznati "key" su ignorirani
+}
+
+// sljedeći key=val token iz [*s, end); vraća 0 kad ih više nema (tokeni bez '=' se preskaču)
+static int next_kv(const char** s, const char* end, const char** key, size_t* key_len, const char** val, const char** val_end) {
+    const char* p = *s;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        const char* tok = p;
+        const char* eq = NULL;
+        while (p < end && *p != ' ' && *p != '\t') {
+            if (*p == '=' && !eq) eq = p;
+            p++;
+        }
+        if (!eq) continue; // ignorira neispravne tokene
+        *key = tok;
+        *key_len = (size_t)(eq - tok);
+        *val = eq + 1;
+        *val_end = p;
+        *s = p;
+        return 1;
+    }
+    *s = p;
+    return 0;
+}
+
+// primjenjuje sve key=val tokene iz [s, end) na čvor
+static void apply_kv_all(Node* n, const char* s, const char* end) {
+    const char *key, *val, *val_end;
+    size_t key_len;
+    while (next_kv(&s, end, &key, &key_len, &val, &val_end)) {
+        apply_kv(n, key, key_len, val, val_end);
+    }
+}
+
+// parsira 1 liniju topologije [s, end) direktno iz mapiranog buffera
+static void parse_line(Node* n, const char* s, const char* end) {
+    // Tokenizira po razmaku: TYPE key=val key=val ...
+    const char* tok = s;
+    while (s < end && *s != ' ' && *s != '\t') s++;
+    n->type = parse_type(tok, s);
+    apply_kv_all(n, s, end);
+}
+
+// računa gubitak splittera
+static double splitter_loss_db(int ratio) {
+    if (ratio <= 1) return 0.0;
+    // idealni split gubitak(10log10) + insertion loss - npr. 1:8  -> ~9 dB + insertion
+    return 10.0 * log10((double)ratio) + SPLITTER_INS_DB;
+}
+
+// računa gubitke fizičkog optičkog linka (lp = loss_params_default() ili parametri scenarija)
+FTTH_NO_FP_CONTRACT
+static double node_link_loss_db(const LossParams* lp, const Node* n) {
+    double loss = 0.0;
+    loss += n->len_km * lp->atten_db_per_km;
+    loss += (double)n->connectors * lp->conn_loss_db;
+    loss += (double)n->splices * lp->splice_loss_db;
+
+    if (n->type == NODE_SPLITTER && n->splitter_ratio > 1) {
+        // idealni split gubitak(10log10) + insertion loss - npr. 1:8  -> ~9 dB + insertion
+        loss += 10.0 * log10((double)n->splitter_ratio) + lp->splitter_ins_db;
+    }
+    if (n->faulty) {
+        loss += n->extra_loss_db;
+    }
+    return loss;
+}
+
+// inicijalizacija strukutre statistike
+static SubtreeStats stats_init(void) {
+    SubtreeStats s;
+
+    s.ont_count = 0;
+    s.ok_count = 0;
+    s.fail_count = 0;
+    s.down_count = 0;
+    s.sum_rx = 0.0;
+    s.sum_loss = 0.0;
+    s.best_rx = -1e9;
+    s.worst_rx =  1e9;
+    return s;
+}
+
+// statistika jednog ONT-a (list stabla)
+static SubtreeStats stats_ont(int status, double rx_dbm, double loss) {
+    SubtreeStats s = stats_init();
+    s.ont_count = 1;
+    s.ok_count = (status == ONT_OK);
+    s.fail_count = (status == ONT_FAIL);
+    s.down_count = (status == ONT_DOWN);
+    s.sum_rx = rx_dbm;
+    s.sum_loss = loss;
+    s.best_rx = rx_dbm;
+    s.worst_rx = rx_dbm;
+    return s;
+}
+
+// spaja statistiku djece u roditelja
+static void stats_merge(SubtreeStats* a, const SubtreeStats* b) {
+    a->ont_count += b->ont_count;
+    a->ok_count += b->ok_count;
+    a->fail_count += b->fail_count;
+    a->down_count += b->down_count;
+    a->sum_rx += b->sum_rx;
+    a->sum_loss += b->sum_loss;
+    if (b->best_rx > a->best_rx) {
+        a->best_rx = b->best_rx;
+    }
+    if (b->worst_rx < a->worst_rx) {
+        a->worst_rx = b->worst_rx;
+    }
+}
+
+// dodaje putanje (OLT-SPLITTER-ONT)
+static void path_append(char* path, size_t cap, const char* part) {
+    if (path[0] != '\0') {
+        strncat(path, "/", cap - strlen(path) - 1);
+    }
+    strncat(path, part, cap - strlen(path) - 1);
+}
+
+// naziv čvora u putanji: "OLT", "S1(1:32)", "ONT#5"
+// id je ont_id za ONT, a za OLT redni broj OLT-a na vrhu (od 1) kad ih u topologiji ima više;
+// 0 = jedini OLT pa dio putanje ostaje "OLT"
+static void node_path_part(char* part, size_t cap, NodeType type, const char* name, int name_len, int ratio, int id) {
+    part[0] = '\0';
+    if (type == NODE_OLT) {
+        if (id > 0) {
+            snprintf(part, cap, "OLT#%d", id);
+        } else {
+            snprintf(part, cap, "OLT");
+        }
+    } else if (type == NODE_SPLITTER) {
+        if (name_len > 0) {
+            snprintf(part, cap, "%.*s(1:%d)", name_len, name, ratio);
+        } else {
+            snprintf(part, cap, "S(1:%d)", ratio);
+        }
+    } else if (type == NODE_ONT) {
+        snprintf(part, cap, "ONT#%d", id);
+    }
+}
+
+// zapis splittera iz statistike njegovog podstabla
+static void splitter_record_fill(SplitterRecord* rec, const char* name, int name_len, int ratio, const SubtreeStats* st) {
+    memset(rec, 0, sizeof(*rec));
+    if (name_len > 0) {
+        size_t len = (size_t)name_len;
+        if (len > sizeof(rec->name) - 1) len = sizeof(rec->name) - 1;
+        memcpy(rec->name, name, len);
+    } else {
+        strncpy(rec->name, "(unnamed)", sizeof(rec->name) - 1);
+    }
+
+    rec->ratio = ratio;
+    rec->ont_count = st->ont_count;
+    rec->ok_count = st->ok_count;
+    rec->fail_count = st->fail_count;
+    rec->down_count = st->down_count;
+    rec->avg_rx = (st->ont_count > 0) ? (st->sum_rx / st->ont_count) : 0.0;
+    rec->avg_loss = (st->ont_count > 0) ? (st->sum_loss / st->ont_count) : 0.0;
+    rec->worst_rx = (st->ont_count > 0) ? st->worst_rx : 0.0;
+}
+
+static WalkFrame* walk_stack_push(WalkStack* ws) {
+    if (ws->n == ws->cap) {
+        size_t new_cap = ws->cap ? ws->cap * 2 : 64;
+        WalkFrame* p = (WalkFrame*)realloc(ws->arr, new_cap * sizeof(WalkFrame));
+        if (!p) {
+            die("Nema slobodne memorije");
+        }
+        ws->arr = p;
+        ws->cap = new_cap;
+    }
+    return &ws->arr[ws->n++];
+}
+
+// kao path_append, ali uz poznatu duljinu putanje (bez strlen); vraća novu duljinu
+static size_t path_put(char* path, size_t cap, size_t len, const char* part) {
+    if (len > 0 && len < cap - 1) {
+        path[len++] = '/';
+    }
+    size_t pl = strlen(part);
+    if (pl > cap - 1 - len) pl = cap - 1 - len;
+    memcpy(path + len, part, pl);
+    len += pl;
+    path[len] = '\0';
+    return len;
+}
+
+// prolazi topologiju od OLT-a prema ONT-ovima s eksplicitnim stogom okvira (dubina i širina
+// stabla ne troše C stog). Putanja se ne kopira po razini: svaki okvir pamti duljinu putanje
+// roditelja i pri izlasku se putanja samo odsiječe na nju.
+static SubtreeStats walk_and_compute(
+    const Node* n,
+    double parent_tx_dbm,
+    double rxmin_dbm,
+    double acc_loss_db,
+    double acc_dist_km,
+    int down_flag,
+    FILE* ont_csv,
+    SplitterList* splitters,
+    char* path,
+    size_t path_cap
+) {
+    if (!n) return stats_init();
+
+    WalkStack ws = { NULL, 0, 0 };
+    SubtreeStats result = stats_init();
+    size_t plen = strlen(path);
+    const LossParams lp = loss_params_default();
+
+    // vrijednosti naslijeđene od roditelja čvora n
+    double tx_dbm = parent_tx_dbm;
+    double my_rxmin = rxmin_dbm;
+    double loss = acc_loss_db;
+    double dist = acc_dist_km;
+    int down = down_flag;
+
+    for (;;) {
+        if (n->type == NODE_OLT) {
+            tx_dbm = n->olt_tx_dbm;
+            my_rxmin = n->gpon_rxmin_dbm;
+        } else {
+            loss += node_link_loss_db(&lp, n);
+            dist += n->len_km;
+            if (n->faulty) {
+                down = 1;
+            }
+        }
+
+        size_t before = plen;
+        char part[128];
+        node_path_part(part, sizeof(part), n->type, n->name, n->name_len, n->splitter_ratio,
+            n->type == NODE_ONT ? n->ont_id : 0);
+        if (part[0]) {
+            plen = path_put(path, path_cap, plen, part);
+        }
+
+        SubtreeStats done;
+        int have_done = 0;
+        if (n->type == NODE_ONT) {
+            double rx_dbm = tx_dbm - loss;
+            double margin = rx_dbm - my_rxmin;
+
+            const char* status;
+            if (down) {
+                status = "DOWN";
+            } else if (rx_dbm >= my_rxmin) {
+                status = "OK";
+            } else {
+                status = "FAIL";
+            }
+            if (ont_csv) {
+                fprintf(ont_csv, "%d,%.4f,%.4f,%.4f,%.4f,%s,\"%s\"\n",
+                    n->ont_id, dist, loss, rx_dbm, margin, status, path);
+            }
+
+            done = stats_init();
+            done.ont_count = 1;
+            done.sum_rx = rx_dbm;
+            done.sum_loss = loss;
+            done.best_rx = rx_dbm;
+            done.worst_rx = rx_dbm;
+            if (down) {
+                done.down_count = 1;
+            } else if (rx_dbm >= my_rxmin) {
+                done.ok_count = 1;
+            } else {
+                done.fail_count = 1;
+            }
+            have_done = 1;
+
+            plen = before;
+            path[plen] = '\0';
+        } else {
+            WalkFrame* f = walk_stack_push(&ws);
+            f->n = n;
+            f->next_child = n->child;
+            f->tx_dbm = tx_dbm;
+            f->rxmin_dbm = my_rxmin;
+            f->loss_db = loss;
+            f->dist_km = dist;
+            f->down = down;
+            f->path_len = before;
+            f->acc = stats_init();
+        }
+
+        // sljedeći čvor: prvo neobiđeno dijete najdubljeg okvira; završeni okviri se skidaju
+        // i njihova statistika se pribraja roditelju (splitteri tako ulaze postorder)
+        n = NULL;
+        while (ws.n > 0) {
+            if (have_done) {
+                stats_merge(&ws.arr[ws.n - 1].acc, &done);
+                have_done = 0;
+            }
+            WalkFrame* f = &ws.arr[ws.n - 1];
+            if (f->next_child) {
+                n = f->next_child;
+                f->next_child = n->sibling;
+                tx_dbm = f->tx_dbm;
+                my_rxmin = f->rxmin_dbm;
+                loss = f->loss_db;
+                dist = f->dist_km;
+                down = f->down;
+                break;
+            }
+            if (f->n->type == NODE_SPLITTER) {
+                SplitterRecord rec;
+                splitter_record_fill(&rec, f->n->name, f->n->name_len, f->n->splitter_ratio, &f->acc);
+                splitter_list_push(splitters, &rec);
+            }
+            plen = f->path_len;
+            path[plen] = '\0';
+            done = f->acc;
+            have_done = 1;
+            ws.n--;
+        }
+        if (!n) {
+            if (have_done) {
+                result = done;
+            }
+            break;
+        }
+    }
+
+    free(ws.arr);
+    return result;
+}
+
+// izvorna rekurzivna verzija (jedan C okvir i kopija putanje po razini) - samo za --bench-eval
+static SubtreeStats walk_and_compute_recursive(
+    const Node* n,
+    double parent_tx_dbm,
+    double rxmin_dbm,
+    double acc_loss_db,
+    double acc_dist_km,
+    int down_flag,
+    FILE* ont_csv,
+    SplitterList* splitters,
+    char* path,
+    size_t path_cap
+) {
+    if (!n) return stats_init();
+
+    // nasljeđuje OLT tx/rxmin ako je čvor OLT
+    double tx_dbm = parent_tx_dbm;
+    double my_rxmin = rxmin_dbm;
+
+    if (n->type == NODE_OLT) {
+        tx_dbm = n->olt_tx_dbm;
+        my_rxmin = n->gpon_rxmin_dbm;
+    }
+
+    // za čvorove koji nisu OLT, dodaje njihov link loss u akumulirani loss
+    double new_loss = acc_loss_db;
+    double new_dist = acc_dist_km;
+    int new_down = down_flag;
+
+    if (n->type != NODE_OLT) {
+        const LossParams lp = loss_params_default();
+        new_loss += node_link_loss_db(&lp, n);
+        new_dist += n->len_km;
+        if (n->faulty) {
+            new_down = 1; // ako je neki element na putu faulty, svi ONT-ovi ispod se smatraju DOWN(idalje računa rx, ali je down)
+        }
+    }
+
+    // ažurira path
+    char old_path[512];
+    strncpy(old_path, path, sizeof(old_path) - 1);
+    old_path[sizeof(old_path) - 1] = '\0';
+
+    char part[128];
+    node_path_part(part, sizeof(part), n->type, n->name, n->name_len, n->splitter_ratio,
+        n->type == NODE_ONT ? n->ont_id : 0);
+
+    if (part[0]) {
+        path_append(path, path_cap, part);
+    }
+
+    SubtreeStats here = stats_init();
+
+    if (n->type == NODE_ONT) {
+        // racuna RX na ONT-u
+        double rx_dbm = tx_dbm - new_loss;
+        double margin = rx_dbm - my_rxmin;
+
+        const char* status;
+        int ok = 0;
+        if (new_down) {
+            status = "DOWN";
+        } else if (rx_dbm >= my_rxmin) {
+            status = "OK";
+            ok = 1;
+        } else {
+            status = "FAIL";
+        }
+
+        if (ont_csv) {
+            fprintf(ont_csv, "%d,%.4f,%.4f,%.4f,%.4f,%s,\"%s\"\n",
+                n->ont_id, new_dist, new_loss, rx_dbm, margin, status, path);
+        }
+
+        here.ont_count = 1;
+        here.sum_rx = rx_dbm;
+        here.sum_loss = new_loss;
+        here.best_rx = rx_dbm;
+        here.worst_rx = rx_dbm;
+
+        if (new_down) {
+            here.down_count = 1;
+        } else if (ok) {
+            here.ok_count = 1;
+        } else {
+            here.fail_count = 1;
+        }
+
+        // vracamo path
+        strncpy(path, old_path, path_cap - 1);
+        path[path_cap - 1] = '\0';
+        return here;
+    }
+
+    // rekurzija djece
+    const Node* child = n->child;
+    while (child) {
+        SubtreeStats cs = walk_and_compute_recursive(child, tx_dbm, my_rxmin, new_loss, new_dist, new_down, ont_csv, splitters, path, path_cap);
+        stats_merge(&here, &cs);
+        child = child->sibling;
+    }
+
+    // ako je čvor splitter, spremi podatke te grane (ONT-ovi su ispod)
+    if (n->type == NODE_SPLITTER) {
+        SplitterRecord rec;
+        splitter_record_fill(&rec, n->name, n->name_len, n->splitter_ratio, &here);
+        splitter_list_push(splitters, &rec);
+    }
+
+    // vracamo path
+    strncpy(path, old_path, path_cap - 1);
+    path[path_cap - 1] = '\0';
+    return here;
+}
+
+static void* xmalloc(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        die("Nema slobodne memorije");
+    }
+    STATS_ALLOC(size);
+    return p;
+}
+
+static void textbuf_reserve(TextBuf* b, size_t extra) {
+    if (b->len + extra + 1 <= b->cap) return;
+    size_t newcap = b->cap ? b->cap * 2 : 4096;
+    while (newcap < b->len + extra + 1) newcap *= 2;
+    char* p = (char*)realloc(b->data, newcap);
+    if (!p) {
+        die("Nema slobodne memorije (realloc)");
+    }
+    STATS_ALLOC(newcap);
+    b->data = p;
+    b->cap = newcap;
+}
+
+static void textbuf_append(TextBuf* b, const char* s, size_t n) {
+    textbuf_reserve(b, n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+// cijeli broj bez printf-a
+static char* fmt_int(char* p, int v) {
+    char tmp[12];
+    int n = 0;
+    unsigned int u = (v < 0) ? 0u - (unsigned int)v : (unsigned int)v;
+    if (v < 0) *p++ = '-';
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// isto što i "%.4f": zaokruživanje preko a*1e4 je točno osim blizu polovice zadnje znamenke
+// (tamo odlučuje točna binarna vrijednost), pa se taj slučaj i velike/neobične vrijednosti
+// prepuštaju snprintf-u
+static char* fmt_fixed4(char* p, double v) {
+    double a = fabs(v);
+    if (!(a < 1e8)) {
+        return p + snprintf(p, FIXED4_MAX, "%.4f", v);
+    }
+    double s = a * 10000.0;
+    double fl = floor(s);
+    double frac = s - fl;
+    if (frac > 0.499 && frac < 0.501) {
+        return p + snprintf(p, FIXED4_MAX, "%.4f", v);
+    }
+
+    uint64_t q = (uint64_t)fl + (frac > 0.5);
+    if (signbit(v)) *p++ = '-';
+    uint64_t ip = q / 10000;
+    unsigned int fp = (unsigned int)(q % 10000);
+
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + ip % 10);
+        ip /= 10;
+    } while (ip);
+    while (n) *p++ = tmp[--n];
+    *p++ = '.';
+    p[3] = (char)('0' + fp % 10); fp /= 10;
+    p[2] = (char)('0' + fp % 10); fp /= 10;
+    p[1] = (char)('0' + fp % 10); fp /= 10;
+    p[0] = (char)('0' + fp);
+    return p + 4;
+}
+
+// jedan redak ont_results.csv; putanja se kopira s poznatom duljinom
+static void csv_ont_row(TextBuf* b, int ont_id, double dist, double loss, double rx_dbm, double margin,
+    const char* status, const char* path, size_t path_len) {
+    size_t status_len = strlen(status);
+    textbuf_reserve(b, path_len + status_len + 5 * FIXED4_MAX + 8);
+    char* p = b->data + b->len;
+    p = fmt_int(p, ont_id);
+    *p++ = ','; p = fmt_fixed4(p, dist);
+    *p++ = ','; p = fmt_fixed4(p, loss);
+    *p++ = ','; p = fmt_fixed4(p, rx_dbm);
+    *p++ = ','; p = fmt_fixed4(p, margin);
+    *p++ = ',';
+    memcpy(p, status, status_len);
+    p += status_len;
+    *p++ = ',';
+    *p++ = '"';
+    memcpy(p, path, path_len);
+    p += path_len;
+    *p++ = '"';
+    *p++ = '\n';
+    b->len = (size_t)(p - b->data);
+}
+
+// pozadinska nit: čeka predani blok, zapisuje ga i javlja da je slobodan
+static void* csv_writer_thread(void* arg) {
+    CsvWriter* w = (CsvWriter*)arg;
+    pthread_mutex_lock(&w->mu);
+    for (;;) {
+        while (!w->has_pending && !w->done) {
+            pthread_cond_wait(&w->cv, &w->mu);
+        }
+        if (!w->has_pending) break;
+        pthread_mutex_unlock(&w->mu);
+
+        if (fwrite(w->pending.data, 1, w->pending.len, w->f) != w->pending.len) {
+            die("Greska pri pisanju CSV datoteke");
+        }
+
+        pthread_mutex_lock(&w->mu);
+        w->pending.len = 0;
+        w->has_pending = 0;
+        pthread_cond_broadcast(&w->cv);
+    }
+    pthread_mutex_unlock(&w->mu);
+    return NULL;
+}
+
+static void csv_writer_open(CsvWriter* w, const char* filename, int bg) {
+    memset(w, 0, sizeof(*w));
+    w->name = filename;
+    w->f = fopen(filename, "wb");
+    if (!w->f) {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Nemoguce je otvoriti %s za pisanje.", filename);
+        die(msg);
+    }
+    // blokove slažemo sami, stdio buffer bi bio samo još jedna kopija
+    setvbuf(w->f, NULL, _IONBF, 0);
+    textbuf_reserve(&w->buf, CSV_FLUSH_BYTES);
+
+    w->bg = bg;
+    if (bg) {
+        textbuf_reserve(&w->pending, CSV_FLUSH_BYTES);
+        pthread_mutex_init(&w->mu, NULL);
+        pthread_cond_init(&w->cv, NULL);
+        if (pthread_create(&w->thread, NULL, csv_writer_thread, w) != 0) {
+            die("Nije moguce pokrenuti nit za pisanje");
+        }
+    }
+}
+
+// predaje trenutni blok na pisanje
+static void csv_writer_flush(CsvWriter* w) {
+    if (w->buf.len == 0) return;
+    w->written += w->buf.len;
+
+    if (!w->bg) {
+        if (fwrite(w->buf.data, 1, w->buf.len, w->f) != w->buf.len) {
+            die("Greska pri pisanju CSV datoteke");
+        }
+        w->buf.len = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&w->mu);
+    while (w->has_pending) {
+        pthread_cond_wait(&w->cv, &w->mu);
+    }
+    TextBuf t = w->pending;
+    w->pending = w->buf;
+    w->buf = t;
+    w->has_pending = 1;
+    pthread_cond_broadcast(&w->cv);
+    pthread_mutex_unlock(&w->mu);
+}
+
+static void csv_writer_maybe_flush(CsvWriter* w) {
+    if (w->buf.len >= CSV_FLUSH_BYTES) {
+        csv_writer_flush(w);
+    }
+}
+
+static void csv_writer_append(CsvWriter* w, const char* s, size_t n) {
+    textbuf_append(&w->buf, s, n);
+    csv_writer_maybe_flush(w);
+}
+
+static void csv_writer_close(CsvWriter* w) {
+    csv_writer_flush(w);
+    if (w->bg) {
+        pthread_mutex_lock(&w->mu);
+        w->done = 1;
+        pthread_cond_broadcast(&w->cv);
+        pthread_mutex_unlock(&w->mu);
+        pthread_join(w->thread, NULL);
+        pthread_mutex_destroy(&w->mu);
+        pthread_cond_destroy(&w->cv);
+    }
+    if (fclose(w->f) != 0) {
+        die("Greska pri zatvaranju CSV datoteke");
+    }
+    STATS_FILE(w->name, w->written);
+    free(w->buf.data);
+    free(w->pending.data);
+}
+
+// upisuje parametre čvora u nizove; ord je redni broj ONT-a (za ONT) ili OLT-a (za OLT).
+// link_loss se računa istom funkcijom kao u Node stablu pa je rezultat bit-identičan
+static void flat_node_store(FlatTopo* ft, int32_t i, int32_t ord, const Node* n) {
+    ft->faulty[i] = (uint8_t)n->faulty;
+    const LossParams lp = loss_params_default();
+    ft->link_loss[i] = node_link_loss_db(&lp, n);
+    ft->len_km[i] = n->len_km;
+    ft->conn[i] = n->connectors;
+    ft->splices[i] = n->splices;
+    ft->extra[i] = n->extra_loss_db;
+    ft->ont_id[i] = n->ont_id;
+    ft->ratio[i] = n->splitter_ratio;
+    ft->name[i] = n->name;
+    ft->name_len[i] = n->name_len;
+
+    if (n->type == NODE_OLT) {
+        ft->olt_tx_dbm[ord] = n->olt_tx_dbm;
+        ft->olt_rxmin_dbm[ord] = n->gpon_rxmin_dbm;
+    } else if (n->type == NODE_ONT) {
+        ft->ont_len[ord] = n->len_km;
+        ft->ont_conn[ord] = n->connectors;
+        ft->ont_sp[ord] = n->splices;
+        ft->ont_extra[ord] = n->faulty ? n->extra_loss_db : 0.0;
+        ft->ont_faulty[ord] = n->faulty;
+    }
+}
+
+// obrnuto od flat_node_store: Node s parametrima čvora i (bez djece)
+static void flat_node_load(const FlatTopo* ft, int32_t i, int32_t ord, Node* n) {
+    memset(n, 0, sizeof(*n));
+    n->type = (NodeType)ft->type[i];
+    n->len_km = ft->len_km[i];
+    n->connectors = ft->conn[i];
+    n->splices = ft->splices[i];
+    n->splitter_ratio = ft->ratio[i];
+    n->name = ft->name[i];
+    n->name_len = ft->name_len[i];
+    n->ont_id = ft->ont_id[i];
+    n->faulty = ft->faulty[i];
+    n->extra_loss_db = ft->extra[i];
+    if (n->type == NODE_OLT) {
+        n->olt_tx_dbm = ft->olt_tx_dbm[ord];
+        n->gpon_rxmin_dbm = ft->olt_rxmin_dbm[ord];
+    }
+}
+
+// upisuje čvor n i njegovu braću (s podstablima) u nizove, preorder; djeca ONT-a se preskaču
+// kao i u walk_and_compute. Otvoreni čvorovi čekaju na eksplicitnom stogu (bez rekurzije);
+// indeks otvorenog čvora je uvijek parent, a njegov roditelj ft->parent[parent].
+static void flat_fill(FlatTopo* ft, const Node* n, int32_t parent, int32_t* idx) {
+    const Node** open = NULL;
+    size_t depth = 0, cap = 0;
+    for (;;) {
+        while (!n && depth > 0) {
+            // sva djeca obiđena: podstablo završava ovdje, nastavlja se s bratom
+            ft->end[parent] = *idx;
+            parent = ft->parent[parent];
+            n = open[--depth]->sibling;
+        }
+        if (!n) break;
+
+        int32_t i = (*idx)++;
+        ft->type[i] = (uint8_t)n->type;
+        ft->parent[i] = parent;
+
+        if (n->type == NODE_OLT) {
+            flat_node_store(ft, i, ft->olt_count++, n);
+        }
+        if (n->type == NODE_ONT) {
+            int32_t k = ft->ont_count++;
+            ft->ont_node[k] = i;
+            ft->ont_parent[k] = parent;
+            flat_node_store(ft, i, k, n);
+            ft->end[i] = *idx;
+            n = n->sibling;
+        } else {
+            if (n->type != NODE_OLT) {
+                flat_node_store(ft, i, -1, n);
+            }
+            if (depth == cap) {
+                cap = cap ? cap * 2 : 64;
+                const Node** p = (const Node**)realloc((void*)open, cap * sizeof(const Node*));
+                if (!p) {
+                    die("Nema slobodne memorije");
+                }
+                open = p;
+            }
+            open[depth++] = n;
+            parent = i;
+            n = n->child;
+        }
+    }
+    free((void*)open);
+}
+
+// pretvara Node stablo u FlatTopo (nakon ovoga stablo više nije potrebno)
+static void flat_compile(const Node* root, size_t node_count, FlatTopo* ft) {
+    size_t n = node_count;
+    ft->n = 0;
+    ft->ont_count = 0;
+    ft->olt_count = 0;
+    ft->type = (uint8_t*)xmalloc(n);
+    ft->faulty = (uint8_t*)xmalloc(n);
+    ft->parent = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->end = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->link_loss = (double*)xmalloc(n * sizeof(double));
+    ft->len_km = (double*)xmalloc(n * sizeof(double));
+    ft->conn = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->splices = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->extra = (double*)xmalloc(n * sizeof(double));
+    ft->ont_id = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->ratio = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->name = (const char**)xmalloc(n * sizeof(const char*));
+    ft->name_len = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->ont_node = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->ont_parent = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->ont_len = (double*)xmalloc(n * sizeof(double));
+    ft->ont_conn = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->ont_sp = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->ont_extra = (double*)xmalloc(n * sizeof(double));
+    ft->ont_faulty = (int32_t*)xmalloc(n * sizeof(int32_t));
+    ft->olt_tx_dbm = (double*)xmalloc(n * sizeof(double));
+    ft->olt_rxmin_dbm = (double*)xmalloc(n * sizeof(double));
+
+    int32_t idx = 0;
+    flat_fill(ft, root, -1, &idx);
+    ft->n = idx;
+    flat_index_build(ft);
+}
+
+// fmix32 iz MurmurHash3: susjedni ONT id-ovi se raspršuju po cijeloj tablici
+static uint32_t hash_int(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+// FNV-1a nad imenom (pogled u mapiranu datoteku, bez kopiranja)
+static uint32_t hash_name(const char* s, int32_t len) {
+    uint32_t h = 2166136261u;
+    for (int32_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// potencija broja 2, najviše pola popunjena
+static uint32_t index_cap(int32_t count) {
+    uint32_t cap = 16;
+    while (cap < (uint32_t)count * 2) cap *= 2;
+    return cap;
+}
+
+// gradi oba indeksa; dupli ONT id ili dupli naziv splittera pod istim OLT-om na vrhu je greška u topologiji
+static void flat_index_build(FlatTopo* ft) {
+    int32_t splitters = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        splitters += (ft->type[i] == NODE_SPLITTER && ft->name_len[i] > 0);
+    }
+    uint32_t ont_cap = index_cap(ft->ont_count);
+    uint32_t spl_cap = index_cap(splitters);
+    ft->ont_slot = (int32_t*)xmalloc(ont_cap * sizeof(int32_t));
+    ft->spl_slot = (int32_t*)xmalloc(spl_cap * sizeof(int32_t));
+    memset(ft->ont_slot, 0xFF, ont_cap * sizeof(int32_t));
+    memset(ft->spl_slot, 0xFF, spl_cap * sizeof(int32_t));
+    ft->ont_mask = ont_cap - 1;
+    ft->spl_mask = spl_cap - 1;
+
+    int32_t root = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        int32_t dup = -1;
+        if (ft->parent[i] < 0) root = i;
+        if (ft->type[i] == NODE_ONT) {
+            uint32_t h = hash_int((uint32_t)ft->ont_id[i]) & ft->ont_mask;
+            while (ft->ont_slot[h] >= 0 && ft->ont_id[ft->ont_slot[h]] != ft->ont_id[i]) {
+                h = (h + 1) & ft->ont_mask;
+            }
+            if (ft->ont_slot[h] >= 0) {
+                dup = ft->ont_slot[h];
+            } else {
+                ft->ont_slot[h] = i;
+            }
+        } else if (ft->type[i] == NODE_SPLITTER && ft->name_len[i] > 0) {
+            uint32_t h = hash_name(ft->name[i], ft->name_len[i]) & ft->spl_mask;
+            for (; ft->spl_slot[h] >= 0; h = (h + 1) & ft->spl_mask) {
+                int32_t j = ft->spl_slot[h];
+                if (ft->name_len[j] == ft->name_len[i] && memcmp(ft->name[j], ft->name[i], (size_t)ft->name_len[i]) == 0 &&
+                    flat_root_of(ft, j) == root) {
+                    dup = j;
+                    break;
+                }
+            }
+            if (dup < 0) {
+                ft->spl_slot[h] = i;
+            }
+        }
+        if (dup >= 0) {
+            char a[512], b[512], msg[1200];
+            flat_path(ft, dup, a, sizeof(a));
+            flat_path(ft, i, b, sizeof(b));
+            snprintf(msg, sizeof(msg), "%s se ponavlja u topologiji: %s (cvor %d) i %s (cvor %d)",
+                ft->type[i] == NODE_ONT ? "ONT id" : "Naziv splittera", a, dup, b, i);
+            die(msg);
+        }
+    }
+}
+
+static int32_t flat_index_ont(const FlatTopo* ft, int32_t id) {
+    uint32_t h = hash_int((uint32_t)id) & ft->ont_mask;
+    for (; ft->ont_slot[h] >= 0; h = (h + 1) & ft->ont_mask) {
+        if (ft->ont_id[ft->ont_slot[h]] == id) return ft->ont_slot[h];
+    }
+    return -1;
+}
+
+// splitter s imenom pod OLT-om na vrhu root; root = -1: prvi po redu u datoteci (čvorovi se u
+// indeks upisuju redom, pa je raniji u lancu probanja uvijek prije nego kasniji s istim imenom)
+static int32_t flat_index_splitter(const FlatTopo* ft, int32_t root, const char* name, int32_t len) {
+    uint32_t h = hash_name(name, len) & ft->spl_mask;
+    for (; ft->spl_slot[h] >= 0; h = (h + 1) & ft->spl_mask) {
+        int32_t j = ft->spl_slot[h];
+        if (ft->name_len[j] == len && memcmp(ft->name[j], name, (size_t)len) == 0 &&
+            (root < 0 || flat_root_of(ft, j) == root)) return j;
+    }
+    return -1;
+}
+
+static void flat_free(FlatTopo* ft) {
+    if (ft->mapped) {
+        // samo niz pokazivača na imena je alociran; ostalo je u snapshotu
+        free(ft->name);
+        memset(ft, 0, sizeof(*ft));
+        return;
+    }
+    free(ft->type);
+    free(ft->faulty);
+    free(ft->parent);
+    free(ft->end);
+    free(ft->link_loss);
+    free(ft->len_km);
+    free(ft->conn);
+    free(ft->splices);
+    free(ft->extra);
+    free(ft->ont_id);
+    free(ft->ratio);
+    free(ft->name);
+    free(ft->name_len);
+    free(ft->ont_node);
+    free(ft->ont_parent);
+    free(ft->ont_len);
+    free(ft->ont_conn);
+    free(ft->ont_sp);
+    free(ft->ont_extra);
+    free(ft->ont_faulty);
+    free(ft->olt_tx_dbm);
+    free(ft->olt_rxmin_dbm);
+    free(ft->ont_slot);
+    free(ft->spl_slot);
+    memset(ft, 0, sizeof(*ft));
+}
+
+static LossParams loss_params_default(void) {
+    LossParams lp;
+    lp.atten_db_per_km = ATTEN_DB_PER_KM;
+    lp.conn_loss_db = CONN_LOSS_DB;
+    lp.splice_loss_db = SPLICE_LOSS_DB;
+    lp.splitter_ins_db = SPLITTER_INS_DB;
+    return lp;
+}
+
+static void eval_state_init(EvalState* es, const FlatTopo* ft) {
+    size_t n = (size_t)ft->n;
+    size_t m = (size_t)ft->ont_count;
+    es->lp = loss_params_default();
+    es->kernel = default_ont_kernel;
+    es->path_loss = (double*)xmalloc(n * sizeof(double));
+    es->path_dist = (double*)xmalloc(n * sizeof(double));
+    es->tx_dbm = (double*)xmalloc(n * sizeof(double));
+    es->rxmin_dbm = (double*)xmalloc(n * sizeof(double));
+    es->down = (int32_t*)xmalloc(n * sizeof(int32_t));
+    es->ont_loss = (double*)xmalloc(m * sizeof(double));
+    es->ont_dist = (double*)xmalloc(m * sizeof(double));
+    es->ont_rx = (double*)xmalloc(m * sizeof(double));
+    es->ont_margin = (double*)xmalloc(m * sizeof(double));
+    es->ont_status = (uint8_t*)xmalloc(m);
+}
+
+static void eval_state_free(EvalState* es) {
+    free(es->path_loss);
+    free(es->path_dist);
+    free(es->tx_dbm);
+    free(es->rxmin_dbm);
+    free(es->down);
+    free(es->ont_loss);
+    free(es->ont_dist);
+    free(es->ont_rx);
+    free(es->ont_margin);
+    free(es->ont_status);
+    memset(es, 0, sizeof(*es));
+}
+
+// gubitak/RX/margina/status za ONT-ove [k0, k1) - referentna skalarna verzija.
+// Redoslijed operacija isti je kao u node_link_loss_db() pa su rezultati bit-identični.
+FTTH_NO_FP_CONTRACT
+static void ont_kernel_scalar(const FlatTopo* ft, const LossParams* lp, EvalState* es, int32_t k0, int32_t k1) {
+    for (int32_t k = k0; k < k1; k++) {
+        int32_t p = ft->ont_parent[k];
+        double link = ft->ont_len[k] * lp->atten_db_per_km;
+        link += (double)ft->ont_conn[k] * lp->conn_loss_db;
+        link += (double)ft->ont_sp[k] * lp->splice_loss_db;
+        link += ft->ont_extra[k];
+
+        double loss = es->path_loss[p] + link;
+        double rx = es->tx_dbm[p] - loss;
+        double rxmin = es->rxmin_dbm[p];
+        es->ont_loss[k] = loss;
+        es->ont_dist[k] = es->path_dist[p] + ft->ont_len[k];
+        es->ont_rx[k] = rx;
+        es->ont_margin[k] = rx - rxmin;
+
+        if (es->down[p] | ft->ont_faulty[k]) {
+            es->ont_status[k] = ONT_DOWN;
+        } else if (rx >= rxmin) {
+            es->ont_status[k] = ONT_OK;
+        } else {
+            es->ont_status[k] = ONT_FAIL;
+        }
+    }
+}
+
+#ifdef FTTH_X86_SIMD
+// AVX2: blokovi od 8 ONT-ova (2 x 4 double), roditeljski kontekst se dohvaća gatherom
+__attribute__((target("avx2"))) FTTH_NO_FP_CONTRACT
+static void ont_kernel_avx2(const FlatTopo* ft, const LossParams* lp, EvalState* es, int32_t k0, int32_t k1) {
+    const __m256d va = _mm256_set1_pd(lp->atten_db_per_km);
+    const __m256d vc = _mm256_set1_pd(lp->conn_loss_db);
+    const __m256d vs = _mm256_set1_pd(lp->splice_loss_db);
+    const __m128i zero = _mm_setzero_si128();
+    int32_t k = k0;
+
+    for (; k + 8 <= k1; k += 8) {
+        for (int h = 0; h < 8; h += 4) {
+            int32_t j = k + h;
+            __m128i par = _mm_loadu_si128((const __m128i*)(ft->ont_parent + j));
+            __m256d len = _mm256_loadu_pd(ft->ont_len + j);
+            __m256d conn = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(ft->ont_conn + j)));
+            __m256d sp = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(ft->ont_sp + j)));
+
+            __m256d link = _mm256_mul_pd(len, va);
+            link = _mm256_add_pd(link, _mm256_mul_pd(conn, vc));
+            link = _mm256_add_pd(link, _mm256_mul_pd(sp, vs));
+            link = _mm256_add_pd(link, _mm256_loadu_pd(ft->ont_extra + j));
+
+            __m256d loss = _mm256_add_pd(_mm256_i32gather_pd(es->path_loss, par, 8), link);
+            __m256d dist = _mm256_add_pd(_mm256_i32gather_pd(es->path_dist, par, 8), len);
+            __m256d rxmin = _mm256_i32gather_pd(es->rxmin_dbm, par, 8);
+            __m256d rx = _mm256_sub_pd(_mm256_i32gather_pd(es->tx_dbm, par, 8), loss);
+
+            _mm256_storeu_pd(es->ont_loss + j, loss);
+            _mm256_storeu_pd(es->ont_dist + j, dist);
+            _mm256_storeu_pd(es->ont_rx + j, rx);
+            _mm256_storeu_pd(es->ont_margin + j, _mm256_sub_pd(rx, rxmin));
+
+            __m128i down = _mm_or_si128(_mm_i32gather_epi32(es->down, par, 4),
+                _mm_loadu_si128((const __m128i*)(ft->ont_faulty + j)));
+            int down_bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(down, zero)));
+            int ok_bits = _mm256_movemask_pd(_mm256_cmp_pd(rx, rxmin, _CMP_GE_OQ));
+            for (int l = 0; l < 4; l++) {
+                es->ont_status[j + l] = ((down_bits >> l) & 1) ? ONT_DOWN
+                    : (((ok_bits >> l) & 1) ? ONT_OK : ONT_FAIL);
+            }
+        }
+    }
+    ont_kernel_scalar(ft, lp, es, k, k1);
+}
+
+// AVX-512: blokovi od 16 ONT-ova (2 x 8 double)
+__attribute__((target("avx512f,avx2"))) FTTH_NO_FP_CONTRACT
+static void ont_kernel_avx512(const FlatTopo* ft, const LossParams* lp, EvalState* es, int32_t k0, int32_t k1) {
+    const __m512d va = _mm512_set1_pd(lp->atten_db_per_km);
+    const __m512d vc = _mm512_set1_pd(lp->conn_loss_db);
+    const __m512d vs = _mm512_set1_pd(lp->splice_loss_db);
+    const __m256i zero = _mm256_setzero_si256();
+    int32_t k = k0;
+
+    for (; k + 16 <= k1; k += 16) {
+        for (int h = 0; h < 16; h += 8) {
+            int32_t j = k + h;
+            __m256i par = _mm256_loadu_si256((const __m256i*)(ft->ont_parent + j));
+            __m512d len = _mm512_loadu_pd(ft->ont_len + j);
+            __m512d conn = _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)(ft->ont_conn + j)));
+            __m512d sp = _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)(ft->ont_sp + j)));
+
+            __m512d link = _mm512_mul_pd(len, va);
+            link = _mm512_add_pd(link, _mm512_mul_pd(conn, vc));
+            link = _mm512_add_pd(link, _mm512_mul_pd(sp, vs));
+            link = _mm512_add_pd(link, _mm512_loadu_pd(ft->ont_extra + j));
+
+            __m512d loss = _mm512_add_pd(_mm512_i32gather_pd(par, es->path_loss, 8), link);
+            __m512d dist = _mm512_add_pd(_mm512_i32gather_pd(par, es->path_dist, 8), len);
+            __m512d rxmin = _mm512_i32gather_pd(par, es->rxmin_dbm, 8);
+            __m512d rx = _mm512_sub_pd(_mm512_i32gather_pd(par, es->tx_dbm, 8), loss);
+
+            _mm512_storeu_pd(es->ont_loss + j, loss);
+            _mm512_storeu_pd(es->ont_dist + j, dist);
+            _mm512_storeu_pd(es->ont_rx + j, rx);
+            _mm512_storeu_pd(es->ont_margin + j, _mm512_sub_pd(rx, rxmin));
+
+            __m256i down = _mm256_or_si256(_mm256_i32gather_epi32(es->down, par, 4),
+                _mm256_loadu_si256((const __m256i*)(ft->ont_faulty + j)));
+            int down_bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(down, zero)));
+            int ok_bits = (int)_mm512_cmp_pd_mask(rx, rxmin, _CMP_GE_OQ);
+            for (int l = 0; l < 8; l++) {
+                es->ont_status[j + l] = ((down_bits >> l) & 1) ? ONT_DOWN
+                    : (((ok_bits >> l) & 1) ? ONT_OK : ONT_FAIL);
+            }
+        }
+    }
+    ont_kernel_scalar(ft, lp, es, k, k1);
+}
+#endif
+
+// odabir kernela prema CPU-u (ili prema imenu: "scalar", "avx2", "avx512")
+static OntKernelFn ont_kernel_select(const char* want) {
+    if (want && strcmp(want, "scalar") != 0 && strcmp(want, "avx2") != 0 && strcmp(want, "avx512") != 0) {
+        die("Nepoznat kernel (dopusteni su scalar, avx2 i avx512)");
+    }
+#ifdef FTTH_X86_SIMD
+    __builtin_cpu_init();
+    int has512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2");
+    int has2 = __builtin_cpu_supports("avx2");
+    if (want && strcmp(want, "scalar") == 0) return ont_kernel_scalar;
+    if (want && strcmp(want, "avx2") == 0) return has2 ? ont_kernel_avx2 : ont_kernel_scalar;
+    if (has512) return ont_kernel_avx512;
+    if (has2) return ont_kernel_avx2;
+#else
+    (void)want;
+#endif
+    return ont_kernel_scalar;
+}
+
+static const char* ont_kernel_name(OntKernelFn fn) {
+#ifdef FTTH_X86_SIMD
+    if (fn == ont_kernel_avx2) return "avx2";
+    if (fn == ont_kernel_avx512) return "avx512";
+#endif
+    (void)fn;
+    return "scalar";
+}
+
+// kontekst (akumulirani gubitak, udaljenost, down, tx/rxmin) za sve čvorove osim ONT-ova u [lo, hi);
+// vraća broj ONT-ova u rasponu
+static int32_t flat_eval_context(const FlatTopo* ft, EvalState* es, int32_t lo, int32_t hi, int32_t olt_k) {
+    int32_t onts = 0;
+    for (int32_t i = lo; i < hi; i++) {
+        NodeType type = (NodeType)ft->type[i];
+        if (type == NODE_ONT) {
+            onts++;
+            continue;
+        }
+        int32_t p = ft->parent[i];
+        if (type == NODE_OLT) {
+            // nasljeđuje OLT tx/rxmin ako je čvor OLT, gubitak se ne mijenja
+            es->path_loss[i] = (p >= 0) ? es->path_loss[p] : 0.0;
+            es->path_dist[i] = (p >= 0) ? es->path_dist[p] : 0.0;
+            es->down[i] = (p >= 0) ? es->down[p] : 0;
+            es->tx_dbm[i] = ft->olt_tx_dbm[olt_k];
+            es->rxmin_dbm[i] = ft->olt_rxmin_dbm[olt_k];
+            olt_k++;
+        } else {
+            es->path_loss[i] = es->path_loss[p] + ft->link_loss[i];
+            es->path_dist[i] = es->path_dist[p] + ft->len_km[i];
+            es->down[i] = es->down[p] | ft->faulty[i];
+            es->tx_dbm[i] = es->tx_dbm[p];
+            es->rxmin_dbm[i] = es->rxmin_dbm[p];
+        }
+    }
+    return onts;
+}
+
+// otvoreni predak tijekom prolaza za ispis/agregaciju
+typedef struct {
+    int32_t node;
+    size_t path_len;
+    SubtreeStats st;
+    TopN worst;                 // K najgorih u podstablu (samo uz --splitter-top)
+} FlatFrame;
+
+// zatvara vrh stoga: splitter sprema zapis, statistika ide u roditelja
+static void flat_close(const FlatTopo* ft, FlatFrame* stk, int* top, EvalSink* sink, SubtreeStats* out) {
+    FlatFrame* f = &stk[*top];
+    if (ft->type[f->node] == NODE_SPLITTER) {
+        SplitterRecord rec;
+        splitter_record_fill(&rec, ft->name[f->node], ft->name_len[f->node], ft->ratio[f->node], &f->st);
+        splitter_list_push(sink->splitters, &rec);
+
+        if (sink->splitter_k > 0) {
+            // K najgorih ovog splittera idu u izlaz
+            topn_sort(&f->worst);
+            for (int j = 0; j < f->worst.n; j++) {
+                SplitterWorst w;
+                w.splitter = f->node;
+                w.rank = j + 1;
+                w.r = f->worst.arr[j];
+                splitter_worst_list_push(sink->splitter_worst, &w);
+            }
+        }
+    }
+    if (sink->splitter_k > 0 && *top > 0) {
+        // kao i SubtreeStats, K najgorih se prelijeva u roditelja (bilo kojeg tipa)
+        for (int j = 0; j < f->worst.n; j++) {
+            topn_push(&stk[*top - 1].worst, &f->worst.arr[j]);
+        }
+    }
+    (*top)--;
+    if (*top >= 0) {
+        stats_merge(&stk[*top].st, &f->st);
+    } else {
+        stats_merge(out, &f->st);
+    }
+}
+
+// evaluacija raspona [lo, hi) u tri koraka: kontekst unutarnjih čvorova, batch kernel nad ONT
+// stupcima, pa linearni prolaz koji agregira statistiku i ispisuje retke.
+// base je (opcionalno) već otvoreni predak raspona s putanjom base_path (njegov kontekst mora
+// već biti u es); olt_k/ont_k su redni brojevi prvog OLT-a/ONT-a u rasponu. Redoslijed redaka
+// (ONT preorder, splitteri postorder) i zbrajanja isti je kao u walk_and_compute.
+static void flat_eval_range(const FlatTopo* ft, EvalState* es, int32_t lo, int32_t hi, const FlatFrame* base,
+    const char* base_path, int32_t olt_k, int32_t ont_k, EvalSink* sink, SubtreeStats* out) {
+    int32_t onts = flat_eval_context(ft, es, lo, hi, olt_k);
+    es->kernel(ft, &es->lp, es, ont_k, ont_k + onts);
+
+    int stk_cap = 64;
+    FlatFrame* stk = (FlatFrame*)xmalloc((size_t)stk_cap * sizeof(FlatFrame));
+    int top = -1;
+    int bottom = 0;
+    int want_path = sink->csv || sink->buf;
+
+    // spremište hrpi po razini stoga za --splitter-top (raste zajedno sa stogom)
+    OntResult* worst_mem = NULL;
+    if (sink->splitter_k > 0) {
+        worst_mem = (OntResult*)xmalloc((size_t)stk_cap * (size_t)sink->splitter_k * sizeof(OntResult));
+    }
+    char path[512];
+    path[0] = '\0';
+    int32_t root_ord = -1;      // redni broj zadnjeg OLT-a na vrhu u putanji (-1 = još nije izračunat)
+
+    if (base) {
+        stk[0] = *base;
+        stk[0].st = stats_init();
+        top = 0;
+        bottom = 1;
+        strncpy(path, base_path, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    }
+
+    int32_t k = ont_k;
+    for (int32_t i = lo; i < hi; i++) {
+        while (top >= bottom && ft->end[stk[top].node] <= i) {
+            flat_close(ft, stk, &top, sink, out);
+        }
+        if (top + 1 == stk_cap) {
+            stk_cap *= 2;
+            FlatFrame* ns = (FlatFrame*)realloc(stk, (size_t)stk_cap * sizeof(FlatFrame));
+            if (!ns) {
+                die("Nema slobodne memorije");
+            }
+            stk = ns;
+            if (worst_mem) {
+                OntResult* nw = (OntResult*)realloc(worst_mem, (size_t)stk_cap * (size_t)sink->splitter_k * sizeof(OntResult));
+                if (!nw) {
+                    die("Nema slobodne memorije");
+                }
+                worst_mem = nw;
+                for (int d = bottom; d <= top; d++) {
+                    stk[d].worst.arr = worst_mem + (size_t)d * (size_t)sink->splitter_k;
+                }
+            }
+        }
+        const FlatFrame* p = (top >= 0) ? &stk[top] : NULL;
+        NodeType type = (NodeType)ft->type[i];
+
+        // putanja: roditeljev prefiks ostaje u bufferu, samo se odsiječe na njegovu duljinu
+        size_t plen = p ? p->path_len : 0;
+        if (want_path) {
+            int32_t id = ft->ont_id[i];
+            if (type == NODE_OLT) {
+                id = 0;
+                if (ft->parent[i] < 0) {
+                    root_ord = (root_ord < 0) ? flat_root_ordinal(ft, i) : (root_ord > 0) ? root_ord + 1 : 0;
+                    id = root_ord;
+                }
+            }
+            char part[128];
+            node_path_part(part, sizeof(part), type, ft->name[i], ft->name_len[i], ft->ratio[i], id);
+            path[plen] = '\0';
+            path_append(path, sizeof(path), part);
+            plen = strlen(path + plen) + plen;
+        }
+
+        if (type == NODE_ONT) {
+            double loss = es->ont_loss[k];
+            double rx_dbm = es->ont_rx[k];
+            double margin = es->ont_margin[k];
+            int status = es->ont_status[k];
+            double dist = es->ont_dist[k];
+            if (sink->cols) {
+                sink->cols->ont_id[k] = ft->ont_id[i];
+                sink->cols->dist[k] = dist;
+                sink->cols->loss[k] = loss;
+                sink->cols->rx[k] = rx_dbm;
+                sink->cols->margin[k] = margin;
+                sink->cols->status[k] = (uint8_t)status;
+            }
+            k++;
+
+            if (sink->top || worst_mem) {
+                OntResult r;
+                r.node = i;
+                r.ont_id = ft->ont_id[i];
+                r.rx_dbm = rx_dbm;
+                r.margin_db = margin;
+                if (sink->top) {
+                    topn_push(sink->top, &r);
+                }
+                if (worst_mem && p) {
+                    topn_push(&stk[top].worst, &r);
+                }
+            }
+
+            if (sink->csv) {
+                csv_ont_row(&sink->csv->buf, ft->ont_id[i], dist, loss, rx_dbm, margin, ONT_STATUS_NAME[status], path, plen);
+                csv_writer_maybe_flush(sink->csv);
+            } else if (sink->buf) {
+                csv_ont_row(sink->buf, ft->ont_id[i], dist, loss, rx_dbm, margin, ONT_STATUS_NAME[status], path, plen);
+            }
+
+            SubtreeStats here = stats_ont(status, rx_dbm, loss);
+
+            if (p) {
+                stats_merge(&stk[top].st, &here);
+            } else {
+                stats_merge(out, &here);
+            }
+            continue;
+        }
+
+        FlatFrame* f = &stk[++top];
+        f->node = i;
+        f->path_len = plen;
+        f->st = stats_init();
+        f->worst.arr = worst_mem ? worst_mem + (size_t)top * (size_t)sink->splitter_k : NULL;
+        f->worst.n = 0;
+        f->worst.cap = worst_mem ? sink->splitter_k : 0;
+    }
+    while (top >= bottom) {
+        flat_close(ft, stk, &top, sink, out);
+    }
+    if (base) {
+        stats_merge(out, &stk[0].st);
+    }
+    free(worst_mem);
+    free(stk);
+}
+
+// OLT-ovi na vrhu evaluiraju se kao zasebni rasponi pa svaki dobije svoj agregat (kao u shard_run)
+static SubtreeStats flat_evaluate(const FlatTopo* ft, EvalSink* sink) {
+    SubtreeStats all = stats_init();
+    EvalState es;
+    eval_state_init(&es, ft);
+    int32_t olt_k = 0, ont_k = 0;
+    int root = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r], root++) {
+        SubtreeStats st = stats_init();
+        flat_eval_range(ft, &es, r, ft->end[r], NULL, "", olt_k, ont_k, sink, &st);
+        stats_merge(&all, &st);
+        if (sink->olts) {
+            sink->olts[root].st = st;
+        }
+        for (int32_t i = r; i < ft->end[r]; i++) {
+            if (ft->type[i] == NODE_OLT) olt_k++;
+        }
+        ont_k += st.ont_count;
+    }
+    eval_state_free(&es);
+    return all;
+}
+
+// jedan zadatak paralelne evaluacije = podstablo jednog djeteta OLT-a (npr. splitter 1. razine)
+typedef struct {
+    int32_t lo, hi;
+    int32_t root;               // indeks OLT-a kojem podstablo pripada
+    int32_t base;               // redni broj tog OLT-a (bazni okvir)
+    int32_t olt_k;              // redni broj prvog OLT-a unutar podstabla
+    int32_t ont_k;              // redni broj prvog ONT-a unutar podstabla
+    SubtreeStats st;
+    TextBuf csv;
+    SplitterList splitters;
+    TopN top;
+    SplitterWorstList splitter_worst;
+} EvalTask;
+
+typedef struct {
+    const FlatTopo* ft;
+    EvalState* es;
+    EvalTask* tasks;
+    int task_count;
+    const FlatFrame* bases;     // bazni okvir po OLT-u (indeksirano redom OLT-a)
+    char (*base_paths)[128];
+    int want_csv;
+    int top_cap;
+    int splitter_k;
+    OntColumns* cols;
+    atomic_int next;
+} EvalPool;
+
+// radna nit: uzima sljedeći slobodni zadatak dok ih ima (dinamičko raspoređivanje)
+static void* eval_worker(void* arg) {
+    EvalPool* pool = (EvalPool*)arg;
+    for (;;) {
+        int t = atomic_fetch_add(&pool->next, 1);
+        if (t >= pool->task_count) break;
+
+        EvalTask* task = &pool->tasks[t];
+        EvalSink sink;
+        memset(&sink, 0, sizeof(sink));
+        sink.buf = pool->want_csv ? &task->csv : NULL;
+        sink.splitters = &task->splitters;
+        sink.top = pool->top_cap > 0 ? &task->top : NULL;
+        sink.splitter_k = pool->splitter_k;
+        sink.splitter_worst = &task->splitter_worst;
+        sink.cols = pool->cols;         // zadaci pišu u disjunktne raspone ONT indeksa
+        topn_init(&task->top, pool->top_cap);
+
+        int32_t k = task->base;
+        task->st = stats_init();
+        flat_eval_range(pool->ft, pool->es, task->lo, task->hi, &pool->bases[k], pool->base_paths[k],
+            task->olt_k, task->ont_k, &sink, &task->st);
+    }
+    return NULL;
+}
+
+// paralelna evaluacija: podstabla djece OLT-a su neovisni uzastopni rasponi u preorderu pa ih
+// niti računaju u vlastite buffere, a spajanje ide redom zadataka -> izlaz identičan sekvencijalnom
+static SubtreeStats flat_evaluate_parallel(const FlatTopo* ft, int threads, EvalSink* sink) {
+    SubtreeStats all = stats_init();
+
+    // prebrojavanje zadataka i pomoćnih brojača
+    int task_count = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) {
+        for (int32_t c = r + 1; c < ft->end[r]; c = ft->end[c]) {
+            task_count++;
+        }
+    }
+
+    EvalState es;
+    eval_state_init(&es, ft);
+
+    EvalPool pool;
+    pool.ft = ft;
+    pool.es = &es;
+    pool.tasks = (EvalTask*)xmalloc((size_t)(task_count ? task_count : 1) * sizeof(EvalTask));
+    pool.task_count = task_count;
+    FlatFrame* bases = (FlatFrame*)xmalloc((size_t)(ft->olt_count ? ft->olt_count : 1) * sizeof(FlatFrame));
+    char (*base_paths)[128] = (char (*)[128])xmalloc((size_t)(ft->olt_count ? ft->olt_count : 1) * 128);
+    pool.bases = bases;
+    pool.base_paths = base_paths;
+    pool.want_csv = (sink->csv != NULL || sink->buf != NULL);
+    pool.top_cap = sink->top ? sink->top->cap : 0;
+    pool.splitter_k = sink->splitter_k;
+    pool.cols = sink->cols;
+    atomic_init(&pool.next, 0);
+
+    int32_t onts = 0, olts = 0, cur_base = 0;
+    int32_t roots = 0;
+    int multi_root = ft->n > 0 && ft->end[0] < ft->n;
+    int t = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (ft->parent[i] < 0) {
+            // OLT na vrhu: bazni okvir za svu njegovu djecu
+            FlatFrame* b = &bases[olts];
+            memset(b, 0, sizeof(*b));
+            b->node = i;
+            es.path_loss[i] = 0.0;
+            es.path_dist[i] = 0.0;
+            es.down[i] = 0;
+            es.tx_dbm[i] = ft->olt_tx_dbm[olts];
+            es.rxmin_dbm[i] = ft->olt_rxmin_dbm[olts];
+            roots++;
+            node_path_part(base_paths[olts], 128, NODE_OLT, NULL, 0, 0, multi_root ? roots : 0);
+            b->path_len = strlen(base_paths[olts]);
+            cur_base = olts;
+        } else if (ft->parent[ft->parent[i]] < 0) {
+            // dijete OLT-a = novi zadatak
+            EvalTask* task = &pool.tasks[t++];
+            memset(task, 0, sizeof(*task));
+            task->lo = i;
+            task->hi = ft->end[i];
+            task->root = ft->parent[i];
+            task->base = cur_base;
+            task->olt_k = olts;
+            task->ont_k = onts;
+            splitter_list_init(&task->splitters);
+            splitter_worst_list_init(&task->splitter_worst);
+        }
+        if (ft->type[i] == NODE_ONT) {
+            onts++;
+        } else if (ft->type[i] == NODE_OLT) {
+            olts++;
+        }
+    }
+
+    if (threads > task_count) threads = task_count;
+    if (threads < 1) threads = 1;
+    pthread_t* tids = (pthread_t*)xmalloc((size_t)threads * sizeof(pthread_t));
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, eval_worker, &pool) != 0) {
+            die("Nemoguce je pokrenuti dretvu");
+        }
+    }
+    eval_worker(&pool);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    // spajanje u redoslijedu zadataka
+    t = 0;
+    int root = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r], root++) {
+        SubtreeStats root_st = stats_init();
+        for (; t < task_count && pool.tasks[t].root == r; t++) {
+            EvalTask* task = &pool.tasks[t];
+            if (sink->csv && task->csv.len) {
+                csv_writer_append(sink->csv, task->csv.data, task->csv.len);
+            } else if (sink->buf && task->csv.len) {
+                textbuf_append(sink->buf, task->csv.data, task->csv.len);
+            }
+            for (size_t k = 0; k < task->splitters.n; k++) {
+                splitter_list_push(sink->splitters, &task->splitters.arr[k]);
+            }
+            for (int k = 0; k < task->top.n; k++) {
+                topn_push(sink->top, &task->top.arr[k]);
+            }
+            for (size_t k = 0; k < task->splitter_worst.n; k++) {
+                splitter_worst_list_push(sink->splitter_worst, &task->splitter_worst.arr[k]);
+            }
+            stats_merge(&root_st, &task->st);
+
+            free(task->csv.data);
+            free(task->splitters.arr);
+            free(task->top.arr);
+            free(task->splitter_worst.arr);
+        }
+        if (sink->olts) {
+            sink->olts[root].st = root_st;
+        }
+        stats_merge(&all, &root_st);
+    }
+
+    free(tids);
+    eval_state_free(&es);
+    free(base_paths);
+    free(bases);
+    free(pool.tasks);
+    return all;
+}
+
+// OltSummary za svaki OLT na vrhu (redom), s praznom statistikom koju puni evaluacija (EvalSink.olts)
+static OltSummary* flat_olt_summaries(const FlatTopo* ft, int* count) {
+    int roots = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) {
+        roots++;
+    }
+    OltSummary* olts = (OltSummary*)xmalloc((size_t)(roots ? roots : 1) * sizeof(OltSummary));
+    int32_t olt_k = 0;
+    int k = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (ft->type[i] != NODE_OLT) continue;
+        if (ft->parent[i] < 0) {
+            OltSummary* o = &olts[k++];
+            o->olt = k;
+            o->tx_dbm = ft->olt_tx_dbm[olt_k];
+            o->rxmin_dbm = ft->olt_rxmin_dbm[olt_k];
+            o->st = stats_init();
+        }
+        olt_k++;
+    }
+    *count = roots;
+    return olts;
+}
+
+// redni broj (od 1) OLT-a na vrhu r, ili 0 ako je u topologiji samo jedan OLT na vrhu - O(broj OLT-ova)
+static int32_t flat_root_ordinal(const FlatTopo* ft, int32_t r) {
+    if (ft->n == 0 || ft->end[0] >= ft->n) return 0;
+    int32_t k = 1;
+    for (int32_t x = 0; x < r; x = ft->end[x]) {
+        k++;
+    }
+    return k;
+}
+
+// OLT na vrhu iznad čvora i - O(dubina)
+static int32_t flat_root_of(const FlatTopo* ft, int32_t i) {
+    while (ft->parent[i] >= 0) i = ft->parent[i];
+    return i;
+}
+
+// k-ti (od 1) OLT na vrhu, -1 ako ga nema - O(broj OLT-ova)
+static int32_t flat_root_node(const FlatTopo* ft, int32_t k) {
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) {
+        if (--k == 0) return r;
+    }
+    return -1;
+}
+
+// gradi putanju čvora (npr. "OLT/S1(1:32)/ONT#3", uz više OLT-ova "OLT#2/...") penjući se po parent nizu - O(dubina)
+static void flat_path(const FlatTopo* ft, int32_t node, char* path, size_t cap) {
+    int32_t local[64];          // dublje putanje idu na hrpu
+    int32_t* chain = local;
+    int chain_cap = 64;
+    int depth = 0;
+    for (int32_t i = node; i >= 0; i = ft->parent[i]) {
+        if (depth == chain_cap) {
+            int32_t* c = (int32_t*)xmalloc((size_t)chain_cap * 2 * sizeof(int32_t));
+            memcpy(c, chain, (size_t)depth * sizeof(int32_t));
+            if (chain != local) free(chain);
+            chain = c;
+            chain_cap *= 2;
+        }
+        chain[depth++] = i;
+    }
+    path[0] = '\0';
+    while (depth > 0) {
+        int32_t i = chain[--depth];
+        int32_t id = ft->ont_id[i];
+        if (ft->type[i] == NODE_OLT) {
+            id = (ft->parent[i] < 0) ? flat_root_ordinal(ft, i) : 0;
+        }
+        char part[128];
+        node_path_part(part, sizeof(part), (NodeType)ft->type[i], ft->name[i], ft->name_len[i], ft->ratio[i], id);
+        path_append(path, cap, part);
+    }
+    if (chain != local) free(chain);
+}
+
+// usporedba: rekurzivni i iterativni obilazak Node stabla vs linearni prolaz po FlatTopo (bez pisanja CSV-a)
+static void bench_eval(const char* filename) {
+    Topology topo;
+    read_topology(filename, &topo);
+
+    SplitterList sl;
+    splitter_list_init(&sl);
+    char path[512] = {0};
+
+    double tr = now_sec();
+    SubtreeStats a = stats_init();
+    for (const Node* r = topo.root; r; r = r->sibling) {
+        SubtreeStats st = walk_and_compute_recursive(r, r->olt_tx_dbm, r->gpon_rxmin_dbm,
+            0.0, 0.0, 0, NULL, &sl, path, sizeof(path));
+        stats_merge(&a, &st);
+    }
+    double t0 = now_sec();
+
+    size_t rec_splitters = sl.n;
+    sl.n = 0;
+    SubtreeStats w = stats_init();
+    for (const Node* r = topo.root; r; r = r->sibling) {
+        SubtreeStats st = walk_and_compute(r, r->olt_tx_dbm, r->gpon_rxmin_dbm,
+            0.0, 0.0, 0, NULL, &sl, path, sizeof(path));
+        stats_merge(&w, &st);
+    }
+    double t1 = now_sec();
+    if (w.ont_count != a.ont_count || w.ok_count != a.ok_count || w.sum_rx != a.sum_rx || sl.n != rec_splitters) {
+        die("Iterativni i rekurzivni obilazak daju razlicite rezultate");
+    }
+
+    FlatTopo ft;
+    flat_compile(topo.root, topo.node_count, &ft);
+    double t2 = now_sec();
+
+    sl.n = 0;
+    EvalSink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.splitters = &sl;
+    SubtreeStats b = flat_evaluate(&ft, &sink);
+    double t3 = now_sec();
+
+    printf("Cvorova: %d, ONT: %d\n", ft.n, ft.ont_count);
+    printf("Node stablo (rekurzija):  %.4f s\n", t0 - tr);
+    printf("Node stablo (iterativno): %.4f s (%.2fx)\n", t1 - t0, (t1 - t0) > 0 ? (t0 - tr) / (t1 - t0) : 0.0);
+    printf("FlatTopo compile:         %.4f s\n", t2 - t1);
+    printf("FlatTopo evaluate:        %.4f s (%.2fx)\n", t3 - t2, (t3 - t2) > 0 ? (t1 - t0) / (t3 - t2) : 0.0);
+    if (a.ont_count != b.ont_count || a.ok_count != b.ok_count || a.sum_rx != b.sum_rx) {
+        die("FlatTopo i Node stablo daju razlicite rezultate");
+    }
+
+    flat_free(&ft);
+    free(sl.arr);
+    topology_free(&topo);
+}
+
+// mikrobenchmark batch kernela: skalarno vs SIMD nad svim ONT-ovima, uz provjeru jednakosti
+static void bench_kernel(const char* filename) {
+    Topology topo;
+    read_topology(filename, &topo);
+    FlatTopo ft;
+    flat_compile(topo.root, topo.node_count, &ft);
+    topology_free(&topo);
+
+    EvalState es;
+    eval_state_init(&es, &ft);
+    flat_eval_context(&ft, &es, 0, ft.n, 0);
+
+    size_t m = (size_t)ft.ont_count;
+    double* ref_rx = (double*)xmalloc(m * sizeof(double));
+    double* ref_loss = (double*)xmalloc(m * sizeof(double));
+    uint8_t* ref_status = (uint8_t*)xmalloc(m ? m : 1);
+
+    const char* names[] = { "scalar", "avx2", "avx512" };
+    int reps = 20;
+    double scalar_sec = 0.0;
+    for (int v = 0; v < 3; v++) {
+        OntKernelFn fn = ont_kernel_select(names[v]);
+        if (strcmp(ont_kernel_name(fn), names[v]) != 0) {
+            printf("%-7s: nije podrzano na ovom CPU-u\n", names[v]);
+            continue;
+        }
+        double t0 = now_sec();
+        for (int r = 0; r < reps; r++) {
+            fn(&ft, &es.lp, &es, 0, ft.ont_count);
+        }
+        double sec = (now_sec() - t0) / reps;
+        if (v == 0) {
+            scalar_sec = sec;
+            memcpy(ref_rx, es.ont_rx, m * sizeof(double));
+            memcpy(ref_loss, es.ont_loss, m * sizeof(double));
+            memcpy(ref_status, es.ont_status, m);
+        } else if (memcmp(ref_rx, es.ont_rx, m * sizeof(double)) != 0 ||
+                   memcmp(ref_loss, es.ont_loss, m * sizeof(double)) != 0 ||
+                   memcmp(ref_status, es.ont_status, m) != 0) {
+            die("SIMD kernel daje drugacije rezultate od skalarnog");
+        }
+        printf("%-7s: %.3f ms po prolazu, %.1f M ONT/s (%.2fx)\n", names[v], sec * 1e3,
+            sec > 0 ? (double)m / sec / 1e6 : 0.0, sec > 0 ? scalar_sec / sec : 0.0);
+    }
+    printf("Automatski odabran kernel: %s\n", ont_kernel_name(ont_kernel_select(NULL)));
+
+    free(ref_rx);
+    free(ref_loss);
+    free(ref_status);
+    eval_state_free(&es);
+    flat_free(&ft);
+}
+
+// SubtreeStats čvora iz rezultata ONT-a ili iz već izračunate djece (redom kao u flat_eval_range)
+static void inc_node_stats(IncEngine* e, int32_t i) {
+    const FlatTopo* ft = e->ft;
+    if (ft->type[i] == NODE_ONT) {
+        int32_t k = e->ont_before[i];
+        e->st[i] = stats_ont(e->es.ont_status[k], e->es.ont_rx[k], e->es.ont_loss[k]);
+        return;
+    }
+    SubtreeStats s = stats_init();
+    for (int32_t c = i + 1; c < ft->end[i]; c = ft->end[c]) {
+        stats_merge(&s, &e->st[c]);
+    }
+    e->st[i] = s;
+}
+
+// kontekst, kernel i statistika za podstablo [u, end[u]); kontekst roditelja je već u es
+static void inc_eval_subtree(IncEngine* e, int32_t u) {
+    const FlatTopo* ft = e->ft;
+    int32_t hi = ft->end[u];
+    flat_eval_context(ft, &e->es, u, hi, e->olt_before[u]);
+    e->es.kernel(ft, &e->es.lp, &e->es, e->ont_before[u], e->ont_before[hi]);
+    for (int32_t i = hi - 1; i >= u; i--) {
+        inc_node_stats(e, i);
+    }
+}
+
+static void inc_total(IncEngine* e) {
+    e->all = stats_init();
+    for (int32_t r = 0; r < e->ft->n; r = e->ft->end[r]) {
+        stats_merge(&e->all, &e->st[r]);
+    }
+}
+
+static void inc_init(IncEngine* e, FlatTopo* ft) {
+    size_t n = (size_t)ft->n;
+    e->ft = ft;
+    eval_state_init(&e->es, ft);
+    e->st = (SubtreeStats*)xmalloc((n ? n : 1) * sizeof(SubtreeStats));
+    e->ont_before = (int32_t*)xmalloc((n + 1) * sizeof(int32_t));
+    e->olt_before = (int32_t*)xmalloc((n + 1) * sizeof(int32_t));
+
+    int32_t onts = 0, olts = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        e->ont_before[i] = onts;
+        e->olt_before[i] = olts;
+        onts += (ft->type[i] == NODE_ONT);
+        olts += (ft->type[i] == NODE_OLT);
+    }
+    e->ont_before[n] = onts;
+    e->olt_before[n] = olts;
+
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) {
+        inc_eval_subtree(e, r);
+    }
+    inc_total(e);
+}
+
+// nakon promjene parametara čvora u: podstablo iznova, preci samo ponovno spajaju djecu
+static void inc_update(IncEngine* e, int32_t u) {
+    inc_eval_subtree(e, u);
+    for (int32_t a = e->ft->parent[u]; a >= 0; a = e->ft->parent[a]) {
+        inc_node_stats(e, a);
+    }
+    inc_total(e);
+}
+
+static void inc_free(IncEngine* e) {
+    eval_state_free(&e->es);
+    free(e->st);
+    free(e->ont_before);
+    free(e->olt_before);
+}
+
+// selektor čvora: ont=<id>, splitter=<ime> (zvjezdica na kraju = prefiks) ili node=<preorder indeks>
+static int flat_match(const FlatTopo* ft, int32_t i, const char* key, size_t key_len, const char* val, const char* val_end) {
+    if (key_len == 3 && memcmp(key, "ont", 3) == 0) {
+        return ft->type[i] == NODE_ONT && ft->ont_id[i] == parse_int(val, val_end);
+    } else if (key_len == 8 && memcmp(key, "splitter", 8) == 0) {
+        if (ft->type[i] != NODE_SPLITTER) return 0;
+        int len = (int)(val_end - val);
+        if (len > 0 && val[len - 1] == '*') {
+            len--;
+            return ft->name_len[i] >= len && memcmp(ft->name[i], val, (size_t)len) == 0;
+        }
+        return ft->name_len[i] == len && memcmp(ft->name[i], val, (size_t)len) == 0;
+    } else if (key_len == 4 && memcmp(key, "node", 4) == 0) {
+        return i == parse_int(val, val_end);
+    }
+    return 0;
+}
+
+// prvi čvor koji odgovara selektoru (-1 ako ga nema); ont= i puno ime splittera idu preko indeksa
+static int32_t flat_find(const FlatTopo* ft, const char* key, size_t key_len, const char* val, const char* val_end) {
+    if (key_len == 4 && memcmp(key, "node", 4) == 0) {
+        int i = parse_int(val, val_end);
+        return (i >= 0 && i < ft->n) ? i : -1;
+    }
+    if (key_len == 3 && memcmp(key, "ont", 3) == 0) {
+        return flat_index_ont(ft, parse_int(val, val_end));
+    }
+    if (key_len == 8 && memcmp(key, "splitter", 8) == 0 && val_end > val && val_end[-1] != '*') {
+        // "OLT#k/IME" traži splitter pod k-tim OLT-om na vrhu, samo "IME" prvi takav u datoteci
+        int32_t root = -1;
+        const char* slash = (const char*)memchr(val, '/', (size_t)(val_end - val));
+        if (slash && slash - val > 4 && memcmp(val, "OLT#", 4) == 0) {
+            root = flat_root_node(ft, parse_int(val + 4, slash));
+            if (root < 0) return -1;
+            val = slash + 1;
+        }
+        return flat_index_splitter(ft, root, val, (int32_t)(val_end - val));
+    }
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (flat_match(ft, i, key, key_len, val, val_end)) return i;
+    }
+    return -1;
+}
+
+// čvor iz prvog tokena "key=val" u [*s, end); *s se pomiče iza tokena
+static int32_t flat_select(const FlatTopo* ft, const char** s, const char* end) {
+    const char* p = *s;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    const char* tok = p;
+    const char* eq = NULL;
+    while (p < end && *p != ' ' && *p != '\t') {
+        if (*p == '=' && !eq) eq = p;
+        p++;
+    }
+    *s = p;
+    return eq ? flat_find(ft, tok, (size_t)(eq - tok), eq + 1, p) : -1;
+}
+
+// primjenjuje "key=val ..." iz [s, end) na parametre čvora u (bez ponovnog izračuna)
+static void inc_set(IncEngine* e, int32_t u, const char* s, const char* end) {
+    FlatTopo* ft = e->ft;
+    int32_t ord = (ft->type[u] == NODE_OLT) ? e->olt_before[u] : e->ont_before[u];
+    Node n;
+    flat_node_load(ft, u, ord, &n);
+    const char* name = n.name;
+    int name_len = n.name_len;
+    int ont_id = n.ont_id;
+
+    apply_kv_all(&n, s, end);
+    // ime i ONT id su identitet čvora (ključevi indeksa) i ne mijenjaju se
+    n.name = name;
+    n.name_len = name_len;
+    n.ont_id = ont_id;
+    flat_node_store(ft, u, ord, &n);
+}
+
+// primjenjuje promjene iz datoteke (jedna po liniji: "selektor key=val key=val ...")
+// inkrementalno i na kraju ih provjerava punom evaluacijom izmijenjenog stabla
+static void run_updates(FlatTopo* ft, const char* filename) {
+    IncEngine e;
+    double t0 = now_sec();
+    inc_init(&e, ft);
+    double t_init = now_sec() - t0;
+    printf("Pocetno stanje: ONT=%d OK=%d FAIL=%d DOWN=%d (puna evaluacija %.3f ms)\n",
+        e.all.ont_count, e.all.ok_count, e.all.fail_count, e.all.down_count, t_init * 1e3);
+
+    MappedFile mf;
+    map_file(filename, &mf);
+    const char* p = mf.data;
+    const char* end = p ? p + mf.len : NULL;
+    size_t applied = 0;
+    double t_inc = 0.0;
+
+    while (p < end) {
+        const char* line = p;
+        const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        p = (eol < end) ? eol + 1 : end;
+
+        const char* le = eol;
+        while (le > line && is_space(le[-1])) le--;
+        const char* s = line;
+        while (s < le && is_space(*s)) s++;
+        if (s == le || *s == '#') continue;
+
+        // prvi token bira čvor
+        const char* tok = s;
+        int32_t u = flat_select(ft, &s, le);
+        if (u < 0) {
+            printf("Promjena '%.*s': cvor nije pronaden\n", (int)(s - tok), tok);
+            continue;
+        }
+        inc_set(&e, u, s, le);
+
+        double t1 = now_sec();
+        inc_update(&e, u);
+        double dt = now_sec() - t1;
+        t_inc += dt;
+        applied++;
+
+        int depth = 0;
+        for (int32_t a = ft->parent[u]; a >= 0; a = ft->parent[a]) depth++;
+        printf("Promjena %zu: cvor %d, podstablo %d cvorova, dubina %d | OK=%d FAIL=%d DOWN=%d | %.1f us\n",
+            applied, u, ft->end[u] - u, depth, e.all.ok_count, e.all.fail_count, e.all.down_count, dt * 1e6);
+    }
+    unmap_file(&mf);
+
+    // kontrola: puna evaluacija izmijenjenog stabla mora dati isti rezultat
+    SplitterList sl;
+    splitter_list_init(&sl);
+    EvalSink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.splitters = &sl;
+    double t2 = now_sec();
+    SubtreeStats full = flat_evaluate(ft, &sink);
+    double t_full = now_sec() - t2;
+    free(sl.arr);
+
+    if (full.ont_count != e.all.ont_count || full.ok_count != e.all.ok_count || full.fail_count != e.all.fail_count ||
+        full.down_count != e.all.down_count || full.sum_rx != e.all.sum_rx || full.sum_loss != e.all.sum_loss ||
+        full.best_rx != e.all.best_rx || full.worst_rx != e.all.worst_rx) {
+        die("Inkrementalna i puna evaluacija daju razlicite rezultate");
+    }
+
+    printf("\nPrimijenjeno promjena: %zu, prosjek %.1f us (puna evaluacija %.1f us)\n",
+        applied, applied ? t_inc / (double)applied * 1e6 : 0.0, t_full * 1e6);
+    int olt_n = 0;
+    OltSummary* olts = flat_olt_summaries(ft, &olt_n);
+    int root = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) {
+        olts[root++].st = e.st[r];
+    }
+    print_summary(&e.all, olts, olt_n);
+    free(olts);
+    inc_free(&e);
+}
+
+// učitava tekstualnu topologiju ili snapshot i vraća kompilirano stablo
+static void flat_load(const char* filename, Topology* topo, FlatTopo* ft) {
+    if (snapshot_is(filename)) {
+        snapshot_load(filename, topo, ft);
+        return;
+    }
+    read_topology(filename, topo);
+    flat_compile(topo->root, topo->node_count, ft);
+    arena_release(&topo->arena);
+    topo->root = NULL;
+}
+
+static uint64_t hash_mix64(uint64_t h, uint64_t v) {
+    h ^= v;
+    h *= 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t dbl_bits(double v) {
+    uint64_t b;
+    memcpy(&b, &v, sizeof(b));
+    return b;
+}
+
+// hash ulaza podstabla: parametri čvora + zbroj hasheva djece (redoslijed djece ne mijenja
+// rezultate pa ne mijenja ni hash). Jedan prolaz unatrag po preorderu - djeca su iza roditelja.
+static uint64_t* flat_subtree_hash(const FlatTopo* ft) {
+    size_t n = (size_t)ft->n;
+    uint64_t* h = (uint64_t*)xmalloc((n ? n : 1) * sizeof(uint64_t));
+    memset(h, 0, n * sizeof(uint64_t));
+    int32_t olt = ft->olt_count;
+    for (int32_t i = ft->n - 1; i >= 0; i--) {
+        uint64_t x = hash_mix64(0x6A09E667F3BCC909ull, ft->type[i]);
+        x = hash_mix64(x, dbl_bits(ft->link_loss[i]));
+        x = hash_mix64(x, dbl_bits(ft->len_km[i]));
+        x = hash_mix64(x, ((uint64_t)(uint32_t)ft->conn[i] << 32) | (uint32_t)ft->splices[i]);
+        x = hash_mix64(x, dbl_bits(ft->extra[i]));
+        x = hash_mix64(x, ((uint64_t)ft->faulty[i] << 32) | (uint32_t)ft->ont_id[i]);
+        x = hash_mix64(x, ((uint64_t)(uint32_t)ft->ratio[i] << 32) | hash_name(ft->name[i], ft->name_len[i]));
+        if (ft->type[i] == NODE_OLT) {
+            olt--;
+            x = hash_mix64(x, dbl_bits(ft->olt_tx_dbm[olt]));
+            x = hash_mix64(x, dbl_bits(ft->olt_rxmin_dbm[olt]));
+        }
+        h[i] = hash_mix64(x, h[i]);
+        if (ft->parent[i] >= 0) {
+            h[ft->parent[i]] += h[i];
+        }
+    }
+    return h;
+}
+
+static void diff_tree_init(DiffTree* d) {
+    inc_init(&d->e, &d->ft);
+    d->hash = flat_subtree_hash(&d->ft);
+    d->olt_node = (int32_t*)xmalloc((size_t)(d->ft.olt_count ? d->ft.olt_count : 1) * sizeof(int32_t));
+    int32_t k = 0;
+    for (int32_t r = 0; r < d->ft.n; r = d->ft.end[r]) {
+        d->olt_node[k++] = r;
+    }
+}
+
+static void diff_tree_free(DiffTree* d) {
+    inc_free(&d->e);
+    free(d->hash);
+    free(d->olt_node);
+    flat_free(&d->ft);
+    topology_free(&d->topo);
+}
+
+// isti čvor u drugom stablu: ONT po id-u, splitter po imenu, OLT po redu na vrhu (-1 = nema ga)
+static int32_t diff_partner(const DiffTree* a, int32_t i, const DiffTree* b) {
+    const FlatTopo* ft = &a->ft;
+    if (ft->type[i] == NODE_ONT) {
+        return flat_index_ont(&b->ft, ft->ont_id[i]);
+    }
+    if (ft->type[i] == NODE_SPLITTER) {
+        if (ft->name_len[i] == 0) return -1;
+        int32_t root = diff_partner(a, flat_root_of(ft, i), b);
+        return (root >= 0) ? flat_index_splitter(&b->ft, root, ft->name[i], ft->name_len[i]) : -1;
+    }
+    int32_t k = a->e.olt_before[i];
+    return (k < b->ft.olt_count && ft->parent[i] < 0) ? b->olt_node[k] : -1;
+}
+
+// jednak kontekst roditelja (gubitak i udaljenost do njega, OLT, down) => jednako podstablo
+// daje jednake rezultate
+static int diff_same_context(const DiffTree* a, int32_t i, const DiffTree* b, int32_t j) {
+    int32_t pa = a->ft.parent[i];
+    int32_t pb = b->ft.parent[j];
+    if (pa < 0 || pb < 0) {
+        return pa < 0 && pb < 0;
+    }
+    const EvalState* x = &a->e.es;
+    const EvalState* y = &b->e.es;
+    return x->path_loss[pa] == y->path_loss[pb] && x->path_dist[pa] == y->path_dist[pb] &&
+        x->tx_dbm[pa] == y->tx_dbm[pb] && x->rxmin_dbm[pa] == y->rxmin_dbm[pb] && x->down[pa] == y->down[pb];
+}
+
+// redak diff_ont.csv; o/i = staro stablo, n/j = novo (i ili j je -1 za dodani/uklonjeni ONT)
+static void diff_ont_row(DiffOut* out, const char* change, const DiffTree* o, int32_t i, const DiffTree* n, int32_t j) {
+    char path[512];
+    const DiffTree* src = (j >= 0) ? n : o;
+    flat_path(&src->ft, (j >= 0) ? j : i, path, sizeof(path));
+    fprintf(out->ont_csv, "%d,%s,", src->ft.ont_id[(j >= 0) ? j : i], change);
+
+    double old_margin = 0.0, new_margin = 0.0;
+    if (i >= 0) {
+        int32_t k = o->e.ont_before[i];
+        old_margin = o->e.es.ont_margin[k];
+        fprintf(out->ont_csv, "%s,", ONT_STATUS_NAME[o->e.es.ont_status[k]]);
+    } else {
+        fprintf(out->ont_csv, ",");
+    }
+    if (j >= 0) {
+        int32_t k = n->e.ont_before[j];
+        new_margin = n->e.es.ont_margin[k];
+        fprintf(out->ont_csv, "%s,", ONT_STATUS_NAME[n->e.es.ont_status[k]]);
+    } else {
+        fprintf(out->ont_csv, ",");
+    }
+    if (i >= 0) fprintf(out->ont_csv, "%.4f", old_margin);
+    fprintf(out->ont_csv, ",");
+    if (j >= 0) fprintf(out->ont_csv, "%.4f", new_margin);
+    fprintf(out->ont_csv, ",");
+    if (i >= 0 && j >= 0) fprintf(out->ont_csv, "%.4f", new_margin - old_margin);
+    fprintf(out->ont_csv, ",\"%s\"\n", path);
+}
+
+// redak diff_splitter.csv (agregati kao u splitter_results.csv, staro pa novo)
+static void diff_splitter_row(DiffOut* out, const char* change, const DiffTree* o, int32_t i, const DiffTree* n, int32_t j) {
+    SplitterRecord rec[2];
+    int have[2] = { i >= 0, j >= 0 };
+    if (have[0]) splitter_record_fill(&rec[0], o->ft.name[i], o->ft.name_len[i], o->ft.ratio[i], &o->e.st[i]);
+    if (have[1]) splitter_record_fill(&rec[1], n->ft.name[j], n->ft.name_len[j], n->ft.ratio[j], &n->e.st[j]);
+
+    fprintf(out->spl_csv, "%s,%s", rec[have[1]].name, change);
+    for (int s = 0; s < 2; s++) {
+        if (have[s]) fprintf(out->spl_csv, ",%d", rec[s].ratio); else fprintf(out->spl_csv, ",");
+    }
+    for (int s = 0; s < 2; s++) {
+        if (have[s]) fprintf(out->spl_csv, ",%d,%d,%d,%d", rec[s].ont_count, rec[s].ok_count, rec[s].fail_count, rec[s].down_count);
+        else fprintf(out->spl_csv, ",,,,");
+    }
+    for (int s = 0; s < 2; s++) {
+        if (have[s]) fprintf(out->spl_csv, ",%.4f,%.4f", rec[s].avg_rx, rec[s].worst_rx);
+        else fprintf(out->spl_csv, ",,");
+    }
+    fprintf(out->spl_csv, "\n");
+}
+
+// prolazi stablo a po preorderu i traži svaki čvor u b. Podstablo s jednakim hashem ulaza i
+// jednakim kontekstom roditelja je nepromijenjeno pa se preskače cijelo (i = end[i]), tako da je
+// posao razmjeran promjeni. forward = staro -> novo (promijenjeni i uklonjeni), inače novo ->
+// staro (samo dodani).
+static void diff_scan(const DiffTree* a, const DiffTree* b, int forward, DiffOut* out) {
+    const FlatTopo* ft = &a->ft;
+    const DiffTree* o = forward ? a : b;
+    const DiffTree* n = forward ? b : a;
+    int32_t i = 0;
+    while (i < ft->n) {
+        int32_t j = diff_partner(a, i, b);
+        if (j >= 0 && a->hash[i] == b->hash[j] && diff_same_context(a, i, b, j)) {
+            i = ft->end[i];
+            continue;
+        }
+        out->visited++;
+
+        if (ft->type[i] == NODE_ONT) {
+            if (j < 0) {
+                if (forward) {
+                    diff_ont_row(out, "removed", o, i, n, -1);
+                    out->ont_removed++;
+                } else {
+                    diff_ont_row(out, "added", o, -1, n, i);
+                    out->ont_added++;
+                }
+            } else if (forward) {
+                int32_t ka = a->e.ont_before[i];
+                int32_t kb = b->e.ont_before[j];
+                if (a->e.es.ont_status[ka] != b->e.es.ont_status[kb] ||
+                    fabs(a->e.es.ont_margin[ka] - b->e.es.ont_margin[kb]) > 1e-9) {
+                    diff_ont_row(out, "changed", o, i, n, j);
+                    out->ont_changed++;
+                }
+            }
+        } else if (ft->type[i] == NODE_SPLITTER && ft->name_len[i] > 0) {
+            if (j < 0) {
+                if (forward) {
+                    diff_splitter_row(out, "removed", o, i, n, -1);
+                    out->spl_removed++;
+                } else {
+                    diff_splitter_row(out, "added", o, -1, n, i);
+                    out->spl_added++;
+                }
+            } else if (forward) {
+                SplitterRecord x, y;
+                splitter_record_fill(&x, ft->name[i], ft->name_len[i], ft->ratio[i], &a->e.st[i]);
+                splitter_record_fill(&y, b->ft.name[j], b->ft.name_len[j], b->ft.ratio[j], &b->e.st[j]);
+                if (memcmp(&x, &y, sizeof(x)) != 0) {
+                    diff_splitter_row(out, "changed", o, i, n, j);
+                    out->spl_changed++;
+                }
+            }
+        }
+        i++;
+    }
+}
+
+// TOP N na konzoli; paths[i] je putanja i-tog zapisa sortirane hrpe
+static void print_top(const TopN* top, int top_n, char (*paths)[512]) {
+    printf("\nTOP %d najgorih ONT-ova (po margin):\n", top_n);
+    for (int i = 0; i < top->n; i++) {
+        printf(
+            "ONT %d | margin = %.2f dB | RX = %.2f dBm | path = %s\n",
+            top->arr[i].ont_id,
+            top->arr[i].margin_db,
+            top->arr[i].rx_dbm,
+            paths[i]
+        );
+    }
+}
+
+// zatvara najdublji otvoreni čvor: splitter daje svoj redak, statistika ide roditelju
+static void stream_close(StreamState* ss) {
+    StreamFrame* f = &ss->stk[ss->top--];
+    ss->plen = f->path_len;
+    ss->path[ss->plen] = '\0';
+    if (f->skip) return;
+
+    if (f->type == NODE_SPLITTER) {
+        SplitterRecord rec;
+        splitter_record_fill(&rec, f->name, f->name_len, f->ratio, &f->acc);
+        csv_splitter_row(&ss->spl_csv.buf, &rec);
+        csv_writer_maybe_flush(&ss->spl_csv);
+    }
+    if (ss->top < 0) {
+        ss->olt.st = f->acc;
+    }
+    stats_merge((ss->top >= 0) ? &ss->stk[ss->top].acc : &ss->all, &f->acc);
+}
+
+// dodaje ONT id u skup viđenih; dupli id je greška kao i u običnom pokretanju
+static void stream_id_add(StreamState* ss, int32_t id) {
+    if ((uint32_t)ss->id_n * 2 >= ss->id_mask + 1) {
+        uint32_t cap = (ss->id_mask + 1) * 2;
+        int32_t* set = (int32_t*)malloc((size_t)cap * sizeof(int32_t));
+        if (!set) {
+            die("Nema slobodne memorije");
+        }
+        memset(set, 0xFF, (size_t)cap * sizeof(int32_t));
+        for (uint32_t i = 0; i <= ss->id_mask; i++) {
+            if (ss->id_set[i] < 0) continue;
+            uint32_t h = hash_int((uint32_t)ss->id_set[i]) & (cap - 1);
+            while (set[h] >= 0) h = (h + 1) & (cap - 1);
+            set[h] = ss->id_set[i];
+        }
+        free(ss->id_set);
+        ss->id_set = set;
+        ss->id_mask = cap - 1;
+    }
+    uint32_t h = hash_int((uint32_t)id) & ss->id_mask;
+    for (; ss->id_set[h] >= 0; h = (h + 1) & ss->id_mask) {
+        if (ss->id_set[h] == id) {
+            char msg[640];
+            snprintf(msg, sizeof(msg), "ONT id se ponavlja u topologiji: %s", ss->path);
+            die(msg);
+        }
+    }
+    ss->id_set[h] = id;
+    ss->id_n++;
+}
+
+// jedna linija ulaza: zatvara preke koji nisu roditelji, računa čvor iz konteksta roditelja i
+// za ONT odmah piše redak (isti redoslijed i brojevi kao flat evaluacija)
+static void stream_line(StreamState* ss, const char* line, const char* eol) {
+    ss->line_count++;
+    const char *s, *le;
+    int depth = topo_line(line, eol, &s, &le);
+    if (depth < 0) return;
+
+    while (ss->top >= depth) {
+        stream_close(ss);
+    }
+    if (depth > ss->top + 1) {
+        die("Kriva identacija / Fali roditelj");
+    }
+
+    Node n;
+    node_defaults(&n, NODE_ONT); // vrstu postavlja parse_line
+    parse_line(&n, s, le);
+    ss->node_count++;
+    if (n.type == NODE_ONT && n.ont_id < 0) {
+        n.ont_id = ss->auto_ont_id++;
+    }
+    if (depth == 0 && n.type != NODE_OLT) {
+        die("Najgornji cvor mora biti OLT!");
+    }
+
+    if (ss->top + 1 == ss->stk_cap) {
+        ss->stk_cap = ss->stk_cap ? ss->stk_cap * 2 : 64;
+        StreamFrame* ns = (StreamFrame*)realloc(ss->stk, (size_t)ss->stk_cap * sizeof(StreamFrame));
+        if (!ns) {
+            die("Nema slobodne memorije");
+        }
+        ss->stk = ns;
+    }
+    const StreamFrame* p = (depth > 0) ? &ss->stk[depth - 1] : NULL;
+    StreamFrame* f = &ss->stk[++ss->top];
+    f->type = n.type;
+    f->skip = p && (p->skip || p->type == NODE_ONT);
+    f->path_len = ss->plen;
+    f->acc = stats_init();
+    if (f->skip) return;
+    int32_t index = ss->next_index++;
+
+    f->tx_dbm = p ? p->tx_dbm : 0.0;
+    f->rxmin_dbm = p ? p->rxmin_dbm : 0.0;
+    f->loss_db = p ? p->loss_db : 0.0;
+    f->dist_km = p ? p->dist_km : 0.0;
+    f->down = p ? p->down : 0;
+    if (n.type == NODE_OLT) {
+        f->tx_dbm = n.olt_tx_dbm;
+        f->rxmin_dbm = n.gpon_rxmin_dbm;
+        ss->olt_count++;
+        if (depth == 0) {
+            // bez čitanja unaprijed se ne zna ima li više OLT-ova pa se ne mogu imenovati kao OLT#k
+            if (ss->olt_n > 0) {
+                die("--stream: podrzan je samo jedan OLT na vrhu topologije");
+            }
+            ss->olt_n = 1;
+            ss->olt.olt = 1;
+            ss->olt.tx_dbm = n.olt_tx_dbm;
+            ss->olt.rxmin_dbm = n.gpon_rxmin_dbm;
+            ss->olt.st = stats_init();
+        }
+    } else {
+        const LossParams lp = loss_params_default();
+        f->loss_db += node_link_loss_db(&lp, &n);
+        f->dist_km += n.len_km;
+        if (n.faulty) {
+            f->down = 1;
+        }
+    }
+    f->ratio = n.splitter_ratio;
+    f->name_len = n.name_len < (int)sizeof(f->name) - 1 ? n.name_len : (int)sizeof(f->name) - 1;
+    if (f->name_len > 0) {
+        memcpy(f->name, n.name, (size_t)f->name_len);
+    }
+    f->name[f->name_len > 0 ? f->name_len : 0] = '\0';
+
+    int id = (n.type == NODE_ONT) ? n.ont_id : 0;
+    char part[128];
+    node_path_part(part, sizeof(part), n.type, n.name, n.name_len, n.splitter_ratio, id);
+    if (part[0]) {
+        ss->plen = path_put(ss->path, sizeof(ss->path), ss->plen, part);
+    }
+
+    if (n.type != NODE_ONT) return;
+    stream_id_add(ss, n.ont_id);
+
+    double rx_dbm = f->tx_dbm - f->loss_db;
+    double margin = rx_dbm - f->rxmin_dbm;
+    int status = f->down ? ONT_DOWN : (rx_dbm >= f->rxmin_dbm) ? ONT_OK : ONT_FAIL;
+    csv_ont_row(&ss->ont_csv.buf, n.ont_id, f->dist_km, f->loss_db, rx_dbm, margin,
+        ONT_STATUS_NAME[status], ss->path, ss->plen);
+    csv_writer_maybe_flush(&ss->ont_csv);
+    f->acc = stats_ont(status, rx_dbm, f->loss_db);
+
+    // TOP N: ako ONT ulazi u hrpu, njegova putanja zauzima mjesto izbačenog (linearno po N)
+    OntResult r;
+    r.node = index;
+    r.ont_id = n.ont_id;
+    r.rx_dbm = rx_dbm;
+    r.margin_db = margin;
+    TopN* h = &ont_top;
+    if (h->cap > 0 && (h->n < h->cap || ont_worse(&r, &h->arr[0]))) {
+        int slot = ss->worst_path_n;
+        if (h->n == h->cap) {
+            for (slot = 0; ss->worst_path[slot].node != h->arr[0].node; slot++) {}
+        } else {
+            ss->worst_path_n++;
+        }
+        ss->worst_path[slot].node = index;
+        memcpy(ss->worst_path[slot].path, ss->path, ss->plen + 1);
+        topn_push(h, &r);
+    }
+}
+
+// jednoprolazna evaluacija izravno iz datoteke ili s stdin ("-"): Node stablo se ne gradi, pamte
+// se samo preci trenutne linije pa memorija ne ovisi o veličini mreže
+static void stream_line_fn(void* ctx, const char* line, const char* eol) {
+    stream_line((StreamState*)ctx, line, eol);
+}
+
+// ulaz se čita u blokovima; nepotpuna zadnja linija bloka seli se na početak buffera.
+// Vraća ferror(in).
+static int read_lines(FILE* in, LineFn fn, void* ctx) {
+    size_t cap = CSV_FLUSH_BYTES;
+    char* buf = (char*)xmalloc(cap);
+    size_t have = 0;
+    for (;;) {
+        size_t got = fread(buf + have, 1, cap - have, in);
+        have += got;
+        int last = (got == 0);
+
+        const char* p = buf;
+        const char* end = buf + have;
+        const char* eol;
+        while ((eol = (const char*)memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            fn(ctx, p, eol);
+            p = eol + 1;
+        }
+        if (last) {
+            if (p < end) {
+                fn(ctx, p, end);
+            }
+            break;
+        }
+        have = (size_t)(end - p);
+        memmove(buf, p, have);
+        if (have == cap) {
+            // linija dulja od buffera
+            cap *= 2;
+            char* nb = (char*)realloc(buf, cap);
+            if (!nb) {
+                die("Nema slobodne memorije");
+            }
+            buf = nb;
+        }
+    }
+    free(buf);
+    return ferror(in);
+}
+
+static void run_stream(const char* filename, int top_n, int bg_writer) {
+    FILE* in = (strcmp(filename, "-") == 0) ? stdin : fopen(filename, "rb");
+    if (!in) {
+        die("Nemoguce otvoriti datoteku topologije");
+    }
+
+    StreamState* ss = (StreamState*)xmalloc(sizeof(StreamState));
+    memset(ss, 0, sizeof(*ss));
+    ss->top = -1;
+    ss->auto_ont_id = 1;
+    ss->id_mask = 1023;
+    ss->id_set = (int32_t*)xmalloc((size_t)(ss->id_mask + 1) * sizeof(int32_t));
+    memset(ss->id_set, 0xFF, (size_t)(ss->id_mask + 1) * sizeof(int32_t));
+    ss->all = stats_init();
+    topn_init(&ont_top, top_n);
+    ss->worst_path = (StreamTopPath*)xmalloc((size_t)(top_n > 0 ? top_n : 1) * sizeof(StreamTopPath));
+
+    csv_writer_open(&ss->ont_csv, "ont_results.csv", bg_writer);
+    static const char ONT_CSV_HEADER[] = "ont_id,total_dist_km,total_loss_db,rx_dbm,margin_db,status,path\n";
+    csv_writer_append(&ss->ont_csv, ONT_CSV_HEADER, sizeof(ONT_CSV_HEADER) - 1);
+    csv_writer_open(&ss->spl_csv, "splitter_results.csv", 0);
+    static const char SPL_CSV_HEADER[] = "name,ratio,ont_count,ok_count,fail_count,down_count,avg_rx_dbm,avg_loss_db,worst_rx_dbm\n";
+    csv_writer_append(&ss->spl_csv, SPL_CSV_HEADER, sizeof(SPL_CSV_HEADER) - 1);
+
+    if (read_lines(in, stream_line_fn, ss) != 0) {
+        die("Greska pri citanju topologije");
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    while (ss->top >= 0) {
+        stream_close(ss);
+    }
+    if (ss->olt_count == 0) {
+        die("Nema OLT cvora u ftth_topology.txt");
+    }
+    csv_writer_close(&ss->ont_csv);
+    csv_writer_close(&ss->spl_csv);
+    STATS_COUNTS(ss->line_count, ss->node_count, ss->all.ont_count);
+    STATS_PHASE("stream");
+
+    print_summary(&ss->all, &ss->olt, ss->olt_n);
+
+    // putanje po redu sortirane hrpe
+    topn_sort(&ont_top);
+    char (*top_paths)[512] = (char (*)[512])xmalloc((size_t)(ont_top.n ? ont_top.n : 1) * 512);
+    for (int i = 0; i < ont_top.n; i++) {
+        int slot = 0;
+        while (ss->worst_path[slot].node != ont_top.arr[i].node) slot++;
+        memcpy(top_paths[i], ss->worst_path[slot].path, sizeof(top_paths[i]));
+    }
+    print_top(&ont_top, top_n, top_paths);
+
+    printf("\nStvorene datoteke:\n");
+    printf(" - ont_results.csv\n");
+    printf(" - splitter_results.csv\n");
+
+    generate_report(&ss->all, &ss->olt, ss->olt_n, top_paths);
+    printf("\nStvoren report.txt\n");
+    STATS_PHASE("report");
+
+    free(top_paths);
+    free(ont_top.arr);
+    free(ss->worst_path);
+    free(ss->id_set);
+    free(ss->stk);
+    free(ss);
+}
+
+// usporedba dviju topologija (npr. jučerašnje i današnje): diff_ont.csv s ONT-ovima kojima se
+// promijenio status ili margina i diff_splitter.csv sa splitterima kojima su se pomaknuli agregati
+static void run_diff(const char* old_file, const char* new_file) {
+    DiffTree d[2];
+    double t0 = now_sec();
+    flat_load(old_file, &d[0].topo, &d[0].ft);
+    flat_load(new_file, &d[1].topo, &d[1].ft);
+    double t1 = now_sec();
+    diff_tree_init(&d[0]);
+    diff_tree_init(&d[1]);
+    double t2 = now_sec();
+    STATS_COUNTS(d[1].topo.line_count, d[1].topo.node_count, d[1].ft.ont_count);
+    STATS_PHASE("load");
+
+    DiffOut out;
+    memset(&out, 0, sizeof(out));
+    out.ont_csv = fopen("diff_ont.csv", "w");
+    out.spl_csv = fopen("diff_splitter.csv", "w");
+    if (!out.ont_csv || !out.spl_csv) {
+        die("Nemoguce je otvoriti diff_ont.csv / diff_splitter.csv za pisanje.");
+    }
+    fprintf(out.ont_csv, "ont_id,change,old_status,new_status,old_margin_db,new_margin_db,delta_margin_db,path\n");
+    fprintf(out.spl_csv, "splitter,change,old_ratio,new_ratio,old_ont_count,old_ok_count,old_fail_count,old_down_count,"
+        "new_ont_count,new_ok_count,new_fail_count,new_down_count,old_avg_rx_dbm,old_worst_rx_dbm,new_avg_rx_dbm,new_worst_rx_dbm\n");
+
+    diff_scan(&d[0], &d[1], 1, &out);
+    diff_scan(&d[1], &d[0], 0, &out);
+    double t3 = now_sec();
+
+    STATS_FILE("diff_ont.csv", ftell(out.ont_csv));
+    STATS_FILE("diff_splitter.csv", ftell(out.spl_csv));
+    fclose(out.ont_csv);
+    fclose(out.spl_csv);
+    STATS_PHASE("diff");
+
+    const SubtreeStats* x = &d[0].e.all;
+    const SubtreeStats* y = &d[1].e.all;
+    printf("Diff %s -> %s\n", old_file, new_file);
+    printf("ONT: %d -> %d | OK %d -> %d | FAIL %d -> %d | DOWN %d -> %d\n",
+        x->ont_count, y->ont_count, x->ok_count, y->ok_count, x->fail_count, y->fail_count, x->down_count, y->down_count);
+    printf("ONT-ova promijenjeno: %d, dodano: %d, uklonjeno: %d (diff_ont.csv)\n", out.ont_changed, out.ont_added, out.ont_removed);
+    printf("Splittera promijenjeno: %d, dodano: %d, uklonjeno: %d (diff_splitter.csv)\n", out.spl_changed, out.spl_added, out.spl_removed);
+    printf("Obideno cvorova: %zu od %d | ucitavanje %.3f s, evaluacija i hash %.3f s, usporedba %.3f ms\n",
+        out.visited, d[0].ft.n + d[1].ft.n, t1 - t0, t2 - t1, (t3 - t2) * 1e3);
+
+    diff_tree_free(&d[0]);
+    diff_tree_free(&d[1]);
+}
+
+static void loc_index_init(LocIndex* li, const FlatTopo* ft) {
+    size_t n = (size_t)ft->n;
+    li->ft = ft;
+    li->ont_before = (int32_t*)xmalloc((n + 1) * sizeof(int32_t));
+    li->mark = (uint32_t*)xmalloc((n ? n : 1) * sizeof(uint32_t));
+    memset(li->mark, 0, n * sizeof(uint32_t));
+    li->stamp = 0;
+    int32_t onts = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        li->ont_before[i] = onts;
+        onts += (ft->type[i] == NODE_ONT);
+    }
+    li->ont_before[n] = onts;
+}
+
+static void loc_index_free(LocIndex* li) {
+    free(li->ont_before);
+    free(li->mark);
+}
+
+// broj elemenata sortiranog pos[] u [lo, hi) - dva binarna pretraživanja
+static int32_t loc_count(const int32_t* pos, int32_t count, int32_t lo, int32_t hi) {
+    int32_t a = 0, b = count;
+    while (a < b) {
+        int32_t m = a + (b - a) / 2;
+        if (pos[m] < lo) a = m + 1; else b = m;
+    }
+    int32_t first = a;
+    b = count;
+    while (a < b) {
+        int32_t m = a + (b - a) / 2;
+        if (pos[m] < hi) a = m + 1; else b = m;
+    }
+    return a - first;
+}
+
+static const char* loc_type_name(uint8_t type) {
+    return type == NODE_OLT ? "OLT" : type == NODE_SPLITTER ? "SPLITTER" : "ONT";
+}
+
+static int cmp_int32(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// bolji kandidat: veći score, pa manje podstablo (precizniji), pa raniji u preorderu
+static int cmp_loc_candidate(const void* a, const void* b) {
+    const LocCandidate* x = (const LocCandidate*)a;
+    const LocCandidate* y = (const LocCandidate*)b;
+    if (x->score != y->score) return (x->score < y->score) ? 1 : -1;
+    if (x->onts != y->onts) return (x->onts > y->onts) - (x->onts < y->onts);
+    return (x->node > y->node) - (x->node < y->node);
+}
+
+// koliko alarma iz pos[] kandidat objašnjava i koliko "tihih" ONT-ova bi morao srušiti
+static void loc_candidate_score(LocCandidate* c, const LocIndex* li, const int32_t* pos, int32_t count) {
+    int32_t i = c->node;
+    c->onts = li->ont_before[li->ft->end[i]] - li->ont_before[i];
+    c->alarmed = loc_count(pos, count, i, li->ft->end[i]);
+    int32_t uni = count + c->onts - c->alarmed;
+    c->score = uni > 0 ? (double)c->alarmed / uni : 0.0;
+}
+
+// najniži zajednički predak svih alarma: najdublji predak prvog alarma čiji interval sadrži i
+// zadnji (O(dubina)); -1 ako su alarmi ispod različitih OLT-ova
+static int32_t loc_lca(const FlatTopo* ft, const int32_t* pos, int32_t count) {
+    if (count == 0) return -1;
+    int32_t x = pos[0];
+    while (x >= 0 && ft->end[x] <= pos[count - 1]) {
+        x = ft->parent[x];
+    }
+    return x;
+}
+
+// CSV polje u navodnicima; navodnik unutar polja se udvostručuje
+static void csv_string(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// lokalizacija kvara: svaka linija datoteke je jedan incident s popisom alarmiranih ONT id-ova
+// ("inc7: 1001 1002 1003" ili samo id-ovi). Kandidati su preci alarmiranih ONT-ova (i oni sami),
+// rangirani po tome koliko dobro njihovo podstablo pokriva skup alarma; uz to LCA svih alarma i
+// pohlepno pokrivanje za slučaj više istodobnih kvarova.
+static void run_localize(const FlatTopo* ft, const char* filename, int top_n) {
+    double t0 = now_sec();
+    LocIndex li;
+    loc_index_init(&li, ft);
+    printf("Indeks za lokalizaciju: %d cvorova, %d ONT-ova, %.3f ms\n", ft->n, ft->ont_count, (now_sec() - t0) * 1e3);
+
+    FILE* csv = fopen("localize_results.csv", "w");
+    if (!csv) {
+        die("Nemoguce je otvoriti localize_results.csv za pisanje.");
+    }
+    fprintf(csv, "incident,kind,rank,node,type,ont_count,alarmed,precision,recall,score,path\n");
+
+    MappedFile mf;
+    map_file(filename, &mf);
+    const char* p = mf.data;
+    const char* end = p ? p + mf.len : NULL;
+    int incident = 0;
+
+    int32_t* pos = NULL;
+    int32_t* rest = NULL;
+    LocCandidate* cand = NULL;
+    size_t pos_cap = 0, cand_cap = 0;
+
+    while (p < end) {
+        const char* line = p;
+        const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        p = (eol < end) ? eol + 1 : end;
+
+        const char* le = eol;
+        while (le > line && is_space(le[-1])) le--;
+        const char* s = line;
+        while (s < le && is_space(*s)) s++;
+        if (s == le || *s == '#') continue;
+        incident++;
+
+        // oznaka incidenta prije ':' (ako postoji)
+        char label[64];
+        const char* colon = (const char*)memchr(s, ':', (size_t)(le - s));
+        if (colon) {
+            snprintf(label, sizeof(label), "%.*s", (int)(colon - s), s);
+            s = colon + 1;
+        } else {
+            snprintf(label, sizeof(label), "%d", incident);
+        }
+
+        double q0 = now_sec();
+        int32_t count = 0;
+        int unknown = 0;
+        while (s < le) {
+            while (s < le && (is_space(*s) || *s == ',')) s++;
+            const char* tok = s;
+            while (s < le && !is_space(*s) && *s != ',') s++;
+            if (tok == s) break;
+            int32_t node = flat_index_ont(ft, parse_int(tok, s));
+            if (node < 0) {
+                unknown++;
+                continue;
+            }
+            if ((size_t)count == pos_cap) {
+                pos_cap = pos_cap ? pos_cap * 2 : 1024;
+                pos = (int32_t*)realloc(pos, pos_cap * sizeof(int32_t));
+                rest = (int32_t*)realloc(rest, pos_cap * sizeof(int32_t));
+                if (!pos || !rest) {
+                    die("Nema slobodne memorije");
+                }
+            }
+            pos[count++] = node;
+        }
+        qsort(pos, (size_t)count, sizeof(int32_t), cmp_int32);
+        int32_t uniq = 0;
+        for (int32_t k = 0; k < count; k++) {
+            if (uniq == 0 || pos[uniq - 1] != pos[k]) pos[uniq++] = pos[k];
+        }
+        count = uniq;
+
+        // kandidati: penjanje od svakog alarma dok se ne naiđe na već dodanog pretka
+        li.stamp++;
+        size_t cand_n = 0;
+        for (int32_t k = 0; k < count; k++) {
+            for (int32_t x = pos[k]; x >= 0 && li.mark[x] != li.stamp; x = ft->parent[x]) {
+                li.mark[x] = li.stamp;
+                if (cand_n == cand_cap) {
+                    cand_cap = cand_cap ? cand_cap * 2 : 1024;
+                    cand = (LocCandidate*)realloc(cand, cand_cap * sizeof(LocCandidate));
+                    if (!cand) {
+                        die("Nema slobodne memorije");
+                    }
+                }
+                cand[cand_n].node = x;
+                loc_candidate_score(&cand[cand_n], &li, pos, count);
+                cand_n++;
+            }
+        }
+        qsort(cand, cand_n, sizeof(LocCandidate), cmp_loc_candidate);
+        int32_t lca = loc_lca(ft, pos, count);
+
+        // pohlepno pokrivanje: najbolji kandidat za preostale alarme, dok ima alarma (najviše top_n);
+        // alarmed/score kandidata računaju se nad alarmima koji su preostali (cover_rest) prije njega
+        LocCandidate cover[64];
+        int32_t cover_rest[64];
+        int cover_n = 0;
+        int32_t rest_n = count;
+        if (count > 0) memcpy(rest, pos, (size_t)count * sizeof(int32_t));
+        while (rest_n > 0 && cover_n < top_n && cover_n < 64) {
+            LocCandidate best;
+            best.node = -1;
+            for (size_t k = 0; k < cand_n; k++) {
+                LocCandidate c = cand[k];
+                loc_candidate_score(&c, &li, rest, rest_n);
+                if (c.alarmed > 0 && (best.node < 0 || cmp_loc_candidate(&c, &best) < 0)) {
+                    best = c;
+                }
+            }
+            cover_rest[cover_n] = rest_n;
+            cover[cover_n++] = best;
+            int32_t kept = 0;
+            for (int32_t k = 0; k < rest_n; k++) {
+                if (rest[k] < best.node || rest[k] >= ft->end[best.node]) rest[kept++] = rest[k];
+            }
+            rest_n = kept;
+        }
+        double q1 = now_sec();
+
+        char path[512];
+        printf("\nIncident %s: %d alarma", label, count);
+        if (unknown) printf(" (%d nepoznatih ONT id-ova)", unknown);
+        if (lca >= 0) {
+            flat_path(ft, lca, path, sizeof(path));
+            printf(", LCA %s", path);
+        }
+        printf(", %.3f ms\n", (q1 - q0) * 1e3);
+
+        int shown = (int)cand_n < top_n ? (int)cand_n : top_n;
+        for (int k = 0; k < shown; k++) {
+            const LocCandidate* c = &cand[k];
+            flat_path(ft, c->node, path, sizeof(path));
+            printf("  %d. %s | %d/%d ONT-ova alarmirano, pokriva %d/%d alarma | score %.3f\n",
+                k + 1, path, c->alarmed, c->onts, c->alarmed, count, c->score);
+        }
+        for (int k = 0; k < (int)cand_n; k++) {
+            const LocCandidate* c = &cand[k];
+            if (k >= top_n) break;
+            flat_path(ft, c->node, path, sizeof(path));
+            csv_string(csv, label);
+            fprintf(csv, ",rank,%d,%d,%s,%d,%d,%.4f,%.4f,%.4f,\"%s\"\n", k + 1, c->node,
+                loc_type_name(ft->type[c->node]), c->onts, c->alarmed,
+                c->onts ? (double)c->alarmed / c->onts : 0.0, count ? (double)c->alarmed / count : 0.0, c->score, path);
+        }
+        if (cover_n > 1) {
+            printf("  Vise kvarova (pohlepno pokrivanje):");
+        }
+        for (int k = 0; k < cover_n; k++) {
+            const LocCandidate* c = &cover[k];
+            flat_path(ft, c->node, path, sizeof(path));
+            if (cover_n > 1) {
+                printf(" %s (%d/%d)%s", path, c->alarmed, c->onts, k + 1 < cover_n ? "," : "");
+            }
+            // recall na istoj osnovi kao alarmed i score (preostali alarmi)
+            csv_string(csv, label);
+            fprintf(csv, ",cover,%d,%d,%s,%d,%d,%.4f,%.4f,%.4f,\"%s\"\n", k + 1, c->node,
+                loc_type_name(ft->type[c->node]), c->onts, c->alarmed,
+                c->onts ? (double)c->alarmed / c->onts : 0.0, (double)c->alarmed / cover_rest[k], c->score, path);
+        }
+        if (cover_n > 1) {
+            if (rest_n > 0) printf(" (+%d neobjasnjenih alarma)", rest_n);
+            printf("\n");
+        }
+    }
+
+    STATS_FILE("localize_results.csv", ftell(csv));
+    fclose(csv);
+    printf("\nStvorene datoteke:\n");
+    printf(" - localize_results.csv\n");
+
+    free(pos);
+    free(rest);
+    free(cand);
+    unmap_file(&mf);
+    loc_index_free(&li);
+}
+
+static TelParams tel_params_default(void) {
+    TelParams tp;
+    tp.alpha = 0.05;
+    tp.drift = 1.5;
+    tp.min_samples = 20;
+    tp.samples = 5000000;
+    tp.seed = 1;
+    tp.degraded = 3;
+    return tp;
+}
+
+static void tel_params_parse(TelParams* tp, const char* s) {
+    const char* end = s + strlen(s);
+    const char *key, *val, *val_end;
+    size_t key_len;
+    while (next_kv(&s, end, &key, &key_len, &val, &val_end)) {
+        if (key_len == 5 && memcmp(key, "alpha", 5) == 0) {
+            tp->alpha = parse_double(val, val_end);
+        } else if (key_len == 5 && memcmp(key, "drift", 5) == 0) {
+            tp->drift = parse_double(val, val_end);
+        } else if (key_len == 11 && memcmp(key, "min_samples", 11) == 0) {
+            tp->min_samples = parse_int(val, val_end);
+        } else if (key_len == 7 && memcmp(key, "samples", 7) == 0) {
+            tp->samples = (long)parse_double(val, val_end);     // dopušta i 1e7
+        } else if (key_len == 4 && memcmp(key, "seed", 4) == 0) {
+            tp->seed = (uint64_t)parse_double(val, val_end);
+        } else if (key_len == 8 && memcmp(key, "degraded", 8) == 0) {
+            tp->degraded = parse_int(val, val_end);
+        }
+    }
+    if (tp->alpha <= 0.0 || tp->alpha > 1.0 || tp->drift <= 0.0 || tp->samples < 1 || tp->degraded < 0) {
+        die("Neispravni parametri telemetrije");
+    }
+}
+
+// predviđeni RX svih ONT-ova (kontekst + kernel, kao --bench-kernel) i prazna statistika
+static void tel_init(TelState* t, const FlatTopo* ft, const TelParams* tp) {
+    size_t n = (size_t)ft->n;
+    size_t m = (size_t)ft->ont_count;
+    t->ft = ft;
+    t->tp = *tp;
+    eval_state_init(&t->es, ft);
+    flat_eval_context(ft, &t->es, 0, ft->n, 0);
+    t->es.kernel(ft, &t->es.lp, &t->es, 0, ft->ont_count);
+
+    t->ont_before = (int32_t*)xmalloc((n + 1) * sizeof(int32_t));
+    int32_t onts = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        t->ont_before[i] = onts;
+        onts += (ft->type[i] == NODE_ONT);
+    }
+    t->ont_before[n] = onts;
+
+    t->ont = (TelOnt*)xmalloc((m ? m : 1) * sizeof(TelOnt));
+    t->spl = (TelSplitter*)xmalloc((n ? n : 1) * sizeof(TelSplitter));
+    uint32_t cap = index_cap(ft->ont_count);
+    t->mask = cap - 1;
+    t->slot = (TelSlot*)xmalloc((size_t)cap * sizeof(TelSlot));
+    for (uint32_t h = 0; h < cap; h++) {
+        t->slot[h].k = -1;
+    }
+    for (int32_t k = 0; k < ft->ont_count; k++) {
+        int32_t i = ft->ont_node[k];
+        int32_t p = ft->parent[i];
+        t->ont[k].pred_rx = t->es.ont_rx[k];
+        t->ont[k].spl = (p >= 0 && ft->type[p] == NODE_SPLITTER) ? p : -1;
+        uint32_t h = hash_int((uint32_t)ft->ont_id[i]) & t->mask;
+        while (t->slot[h].k >= 0) h = (h + 1) & t->mask;     // id-ovi su jedinstveni (flat_index_build)
+        t->slot[h].id = ft->ont_id[i];
+        t->slot[h].k = k;
+    }
+    t->quiet = 0;
+    tel_reset(t);
+}
+
+static void tel_reset(TelState* t) {
+    for (int32_t k = 0; k < t->ft->ont_count; k++) {
+        TelOnt* o = &t->ont[k];
+        o->ewma = o->max_dev = o->last_rx = o->last_ts = 0.0;
+        o->samples = 0;
+    }
+    memset(t->spl, 0, (size_t)t->ft->n * sizeof(TelSplitter));
+    t->total = t->unknown = t->late = t->bad = t->raised = 0;
+    t->b_n = 0;
+}
+
+static void tel_free(TelState* t) {
+    eval_state_free(&t->es);
+    free(t->ont_before);
+    free(t->ont);
+    free(t->spl);
+    free(t->slot);
+}
+
+// uzorak ide u skupinu; obrađuje se kad se skupina napuni (ili na tel_flush)
+static void tel_sample(TelState* t, double ts, int32_t ont_id, double rx_dbm) {
+    int b = t->b_n;
+    t->b_ts[b] = ts;
+    t->b_id[b] = ont_id;
+    t->b_rx[b] = rx_dbm;
+    t->b_n = b + 1;
+    if (t->b_n == TEL_BATCH) {
+        tel_flush(t);
+    }
+}
+
+// hash ONT id -> redni broj za cijelu skupinu, pa obrada redom kojim su uzorci stigli
+static void tel_flush(TelState* t) {
+    int n = t->b_n;
+    uint32_t hs[TEL_BATCH];
+    for (int b = 0; b < n; b++) {
+        hs[b] = hash_int((uint32_t)t->b_id[b]) & t->mask;
+        FTTH_PREFETCH(&t->slot[hs[b]]);
+    }
+    for (int b = 0; b < n; b++) {
+        uint32_t h = hs[b];
+        while (t->slot[h].k >= 0 && t->slot[h].id != t->b_id[b]) h = (h + 1) & t->mask;
+        t->b_k[b] = t->slot[h].k;
+        if (t->b_k[b] >= 0) FTTH_PREFETCH(&t->ont[t->b_k[b]]);
+    }
+    for (int b = 0; b < n; b++) {
+        if (t->b_k[b] >= 0 && t->ont[t->b_k[b]].spl >= 0) FTTH_PREFETCH(&t->spl[t->ont[t->b_k[b]].spl]);
+    }
+    for (int b = 0; b < n; b++) {
+        if (t->b_k[b] < 0) {
+            t->unknown++;
+        } else {
+            tel_apply(t, t->b_k[b], t->b_ts[b], t->b_rx[b]);
+        }
+    }
+    t->b_n = 0;
+}
+
+// jedan uzorak poznatog ONT-a: EWMA ONT-a i njegovog splittera, provjera praga
+static void tel_apply(TelState* t, int32_t k, double ts, double rx_dbm) {
+    TelOnt* o = &t->ont[k];
+    uint32_t cnt = o->samples;
+    if (cnt && ts < o->last_ts) {
+        t->late++;
+        return;
+    }
+    double dev = o->pred_rx - rx_dbm;
+    double a = t->tp.alpha;
+    o->ewma = cnt ? o->ewma + a * (dev - o->ewma) : dev;
+    double ad = fabs(dev);
+    if (ad > o->max_dev) o->max_dev = ad;
+    o->last_rx = rx_dbm;
+    o->last_ts = ts;
+    o->samples = cnt + 1;
+    t->total++;
+
+    int32_t p = o->spl;
+    if (p < 0) return;
+    TelSplitter* sp = &t->spl[p];
+    uint32_t sc = sp->samples;
+    double se = sc ? sp->ewma + a * (dev - sp->ewma) : dev;
+    sp->ewma = se;
+    sp->samples = sc + 1;
+    double ae = fabs(se);
+    if (ae > sp->max) sp->max = ae;
+    if (!sp->flag) {
+        if (ae >= t->tp.drift && sc + 1 >= (uint32_t)t->tp.min_samples) {
+            sp->flag = 1;
+            t->raised++;
+            if (!t->quiet) {
+                const FlatTopo* ft = t->ft;
+                printf("ts %.3f: splitter %.*s odstupa %+.2f dB (%u uzoraka)\n", ts, ft->name_len[p], ft->name[p],
+                    se, sc + 1);
+            }
+        }
+    } else if (ae < 0.5 * t->tp.drift) {
+        sp->flag = 0;
+        if (!t->quiet) {
+            const FlatTopo* ft = t->ft;
+            printf("ts %.3f: splitter %.*s vracen ispod praga (%+.2f dB)\n", ts, ft->name_len[p], ft->name[p], se);
+        }
+    }
+}
+
+// "timestamp ont_id rx_dbm" (razmak, tab ili zarez); '#' komentar; zaglavlje bez brojeva se preskače
+static void tel_line(TelState* t, const char* line, const char* eol) {
+    const char* tok[3];
+    const char* tok_end[3];
+    int nt = 0;
+    const char* s = line;
+    while (nt < 3) {
+        while (s < eol && (*s == ' ' || *s == '\t' || *s == ',' || *s == '\r')) s++;
+        if (s == eol) break;
+        tok[nt] = s;
+        while (s < eol && *s != ' ' && *s != '\t' && *s != ',' && *s != '\r') s++;
+        tok_end[nt++] = s;
+    }
+    if (nt == 0 || *tok[0] == '#') return;
+    if (nt < 3 || !((*tok[1] >= '0' && *tok[1] <= '9') || *tok[1] == '-')) {
+        if (t->total + t->unknown + t->late + t->bad + (uint64_t)t->b_n > 0) t->bad++;     // prva linija smije biti zaglavlje
+        return;
+    }
+    double ts = parse_double(tok[0], tok_end[0]);
+    double rx = parse_double(tok[2], tok_end[2]);
+    char c = *tok[2];
+    int numeric = (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+    if (!numeric || !isfinite(ts) || !isfinite(rx) || fabs(rx) > TEL_RX_LIMIT_DBM) {
+        t->bad++;
+        return;
+    }
+    tel_sample(t, ts, parse_int(tok[1], tok_end[1]), rx);
+}
+
+static void tel_line_fn(void* ctx, const char* line, const char* eol) {
+    tel_line((TelState*)ctx, line, eol);
+}
+
+// konačna procjena po splitteru nad cijelim podstablom (obrnuti preorder): splitter je označen ako je
+// srednji EWMA ONT-ova koji javljaju iznad praga i barem polovica njih odstupa. Vraća broj označenih;
+// flag[i] = 1 označen, 2 označen i roditelj nije (najviši označeni, vjerojatni uzrok).
+// csv_name = NULL: bez datoteke (benchmark)
+static int32_t tel_report(TelState* t, int top_n, uint8_t* flag, const char* csv_name) {
+    const FlatTopo* ft = t->ft;
+    size_t n = (size_t)ft->n;
+    double* sum = (double*)xmalloc((n ? n : 1) * sizeof(double));
+    int32_t* rep = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    int32_t* drifting = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    memset(sum, 0, n * sizeof(double));
+    memset(rep, 0, n * sizeof(int32_t));
+    memset(drifting, 0, n * sizeof(int32_t));
+    memset(flag, 0, n);
+
+    for (int32_t i = ft->n - 1; i >= 0; i--) {
+        if (ft->type[i] == NODE_ONT) {
+            const TelOnt* o = &t->ont[t->ont_before[i]];
+            if (o->samples) {
+                sum[i] = o->ewma;
+                rep[i] = 1;
+                drifting[i] = fabs(o->ewma) >= t->tp.drift;
+            }
+        }
+        int32_t p = ft->parent[i];
+        if (p >= 0) {
+            sum[p] += sum[i];
+            rep[p] += rep[i];
+            drifting[p] += drifting[i];
+        }
+    }
+    int32_t flagged = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (ft->type[i] != NODE_SPLITTER || rep[i] == 0) continue;
+        if (fabs(sum[i] / rep[i]) >= t->tp.drift && 2 * drifting[i] >= rep[i]) {
+            int32_t p = ft->parent[i];
+            flag[i] = (p >= 0 && flag[p]) ? 1 : 2;
+            flagged++;
+        }
+    }
+
+    FILE* csv = csv_name ? fopen(csv_name, "w") : NULL;
+    if (csv_name && !csv) {
+        die("Nemoguce je otvoriti telemetry_splitter.csv za pisanje.");
+    }
+    if (csv) fprintf(csv, "name,ratio,ont_count,reporting_onts,drifting_onts,mean_dev_db,ewma_dev_db,max_ewma_db,samples,flag,cause\n");
+    int shown = 0;
+    char path[512];
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (ft->type[i] != NODE_SPLITTER || rep[i] == 0) continue;
+        if (csv) fprintf(csv, "%.*s,%d,%d,%d,%d,%.4f,%.4f,%.4f,%u,%d,%d\n", ft->name_len[i], ft->name[i], ft->ratio[i],
+            t->ont_before[ft->end[i]] - t->ont_before[i], rep[i], drifting[i], sum[i] / rep[i],
+            t->spl[i].ewma, t->spl[i].max, t->spl[i].samples, flag[i] != 0, flag[i] == 2);
+        if (flag[i] == 2 && shown < top_n) {
+            if (shown == 0) printf("\nSplitteri s odstupanjem iznad %.2f dB (najvisi oznaceni):\n", t->tp.drift);
+            flat_path(ft, i, path, sizeof(path));
+            printf("  %s | srednje %+.2f dB, %d/%d ONT-ova odstupa\n", path, sum[i] / rep[i], drifting[i], rep[i]);
+            shown++;
+        }
+    }
+    if (csv) {
+        STATS_FILE(csv_name, ftell(csv));
+        fclose(csv);
+    }
+
+    free(sum);
+    free(rep);
+    free(drifting);
+    return flagged;
+}
+
+// --telemetry: izmjereni RX iz datoteke ili stdin ("-") uspoređuje se s predviđenim
+static void run_telemetry(const FlatTopo* ft, const char* filename, const TelParams* tp, int top_n) {
+    TelState t;
+    double t0 = now_sec();
+    tel_init(&t, ft, tp);
+    printf("Predvideni RX za %d ONT-ova: %.3f ms\n", ft->ont_count, (now_sec() - t0) * 1e3);
+
+    FILE* in = (strcmp(filename, "-") == 0) ? stdin : fopen(filename, "rb");
+    if (!in) {
+        die("Nemoguce otvoriti datoteku telemetrije");
+    }
+    t0 = now_sec();
+    if (read_lines(in, tel_line_fn, &t) != 0) {
+        die("Greska pri citanju telemetrije");
+    }
+    tel_flush(&t);
+    double sec = now_sec() - t0;
+    if (in != stdin) {
+        fclose(in);
+    }
+    STATS_PHASE("telemetry");
+
+    printf("\nUzoraka: %llu (nepoznat ONT %llu, zakasnjelih %llu, neispravnih %llu), %.3f s, %.2f M uzoraka/s\n",
+        (unsigned long long)t.total, (unsigned long long)t.unknown, (unsigned long long)t.late,
+        (unsigned long long)t.bad, sec, sec > 0 ? (double)(t.total + t.unknown + t.late) / sec / 1e6 : 0.0);
+
+    FILE* csv = fopen("telemetry_ont.csv", "w");
+    if (!csv) {
+        die("Nemoguce je otvoriti telemetry_ont.csv za pisanje.");
+    }
+    fprintf(csv, "ont_id,predicted_rx_dbm,last_rx_dbm,ewma_dev_db,max_dev_db,samples,last_ts,splitter\n");
+    int32_t reporting = 0;
+    for (int32_t k = 0; k < ft->ont_count; k++) {
+        const TelOnt* o = &t.ont[k];
+        if (!o->samples) continue;
+        reporting++;
+        int32_t p = o->spl;
+        fprintf(csv, "%d,%.4f,%.4f,%.4f,%.4f,%u,%.3f,%.*s\n", ft->ont_id[ft->ont_node[k]], o->pred_rx, o->last_rx,
+            o->ewma, o->max_dev, o->samples, o->last_ts, p >= 0 ? ft->name_len[p] : 0, p >= 0 ? ft->name[p] : "");
+    }
+    STATS_FILE("telemetry_ont.csv", ftell(csv));
+    fclose(csv);
+    printf("ONT-ova koji javljaju: %d od %d\n", reporting, ft->ont_count);
+
+    uint8_t* flag = (uint8_t*)xmalloc(ft->n ? (size_t)ft->n : 1);
+    int32_t flagged = tel_report(&t, top_n, flag, "telemetry_splitter.csv");
+    printf("Oznacenih splittera: %d\n", flagged);
+    free(flag);
+    STATS_PHASE("report");
+
+    printf("\nStvorene datoteke:\n");
+    printf(" - telemetry_ont.csv\n");
+    printf(" - telemetry_splitter.csv\n");
+    tel_free(&t);
+}
+
+// --bench-telemetry: generira uzorke (predviđeni RX + šum, na nekoliko splittera dodatni gubitak),
+// mjeri unos iz već parsiranih nizova i iz teksta te provjerava jesu li pokvareni splitteri pronađeni
+static void bench_telemetry(const char* filename, const TelParams* tp) {
+    Topology topo;
+    FlatTopo ft;
+    flat_load(filename, &topo, &ft);
+    if (ft.ont_count == 0) {
+        die("Topologija nema ONT-ova");
+    }
+    TelState t;
+    tel_init(&t, &ft, tp);
+    t.quiet = 1;
+
+    // pokvareni splitteri biraju se među izravnim roditeljima ONT-ova
+    uint64_t rng = tp->seed;
+    uint8_t* bad = (uint8_t*)xmalloc((size_t)ft.n);
+    memset(bad, 0, (size_t)ft.n);
+    int degraded = 0;
+    for (int tries = 0; degraded < tp->degraded && tries < 1000; tries++) {
+        int32_t k = (int32_t)(gen_next(&rng) % (uint64_t)ft.ont_count);
+        int32_t p = ft.parent[ft.ont_node[k]];
+        if (p >= 0 && ft.type[p] == NODE_SPLITTER && !bad[p]) {
+            bad[p] = 1;
+            degraded++;
+        }
+    }
+
+    size_t count = (size_t)tp->samples;
+    int32_t* ids = (int32_t*)xmalloc(count * sizeof(int32_t));
+    double* rx = (double*)xmalloc(count * sizeof(double));
+    double* ts = (double*)xmalloc(count * sizeof(double));
+    TextBuf text = { NULL, 0, 0 };
+    char line[96];
+    for (size_t s = 0; s < count; s++) {
+        int32_t k = (int32_t)(gen_next(&rng) % (uint64_t)ft.ont_count);
+        int32_t i = ft.ont_node[k];
+        double extra = bad[ft.parent[i]] ? 3.0 : 0.0;
+        ids[s] = ft.ont_id[i];
+        rx[s] = t.es.ont_rx[k] - extra + gen_uniform(&rng, -0.5, 0.5);
+        ts[s] = 1.7e9 + (double)s * 1e-3;
+        int len = snprintf(line, sizeof(line), "%.3f,%d,%.2f\n", ts[s], ids[s], rx[s]);
+        textbuf_append(&text, line, (size_t)len);
+    }
+    printf("Uzoraka: %zu, ONT-ova: %d, pokvarenih splittera: %d, tekst %.1f MB\n", count, ft.ont_count, degraded,
+        (double)text.len / 1e6);
+
+    double t0 = now_sec();
+    for (size_t s = 0; s < count; s++) {
+        tel_sample(&t, ts[s], ids[s], rx[s]);
+    }
+    tel_flush(&t);
+    double sec_arr = now_sec() - t0;
+    printf("nizovi: %.3f s, %.2f M uzoraka/s\n", sec_arr, sec_arr > 0 ? (double)count / sec_arr / 1e6 : 0.0);
+
+    tel_reset(&t);
+    t0 = now_sec();
+    const char* p = text.data;
+    const char* end = text.data + text.len;
+    const char* eol;
+    while ((eol = (const char*)memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        tel_line(&t, p, eol);
+        p = eol + 1;
+    }
+    tel_flush(&t);
+    double sec_txt = now_sec() - t0;
+    printf("tekst:  %.3f s, %.2f M uzoraka/s, %.1f MB/s\n", sec_txt, sec_txt > 0 ? (double)count / sec_txt / 1e6 : 0.0,
+        sec_txt > 0 ? (double)text.len / sec_txt / 1e6 : 0.0);
+    if (t.total != (uint64_t)count) {
+        die("Tekstualni unos nije prihvatio sve uzorke");
+    }
+
+    uint8_t* flag = (uint8_t*)xmalloc((size_t)ft.n);
+    int32_t flagged = tel_report(&t, 0, flag, NULL);
+    int found = 0;
+    for (int32_t i = 0; i < ft.n; i++) {
+        found += bad[i] && flag[i];
+    }
+    printf("Pronadeno pokvarenih: %d/%d, oznacenih splittera ukupno: %d\n", found, degraded, flagged);
+
+    free(flag);
+    free(bad);
+    free(ids);
+    free(rx);
+    free(ts);
+    free(text.data);
+    tel_free(&t);
+    flat_free(&ft);
+    topology_free(&topo);
+}
+
+static void opt_params_parse(OptParams* op, const char* s) {
+    const char* end = s + strlen(s);
+    const char *key, *val, *val_end;
+    size_t key_len;
+    while (next_kv(&s, end, &key, &key_len, &val, &val_end)) {
+        if (key_len == 4 && memcmp(key, "goal", 4) == 0) {
+            if ((size_t)(val_end - val) == 4 && memcmp(val, "fail", 4) == 0) op->goal = 0;
+            else if ((size_t)(val_end - val) == 6 && memcmp(val, "margin", 6) == 0) op->goal = 1;
+            else die("goal mora biti fail ili margin");
+        } else if (key_len == 6 && memcmp(key, "ratios", 6) == 0) {
+            // "4,8,16,32,64"
+            op->ratio_n = 0;
+            const char* a = val;
+            while (a < val_end && op->ratio_n < 8) {
+                const char* b = a;
+                while (b < val_end && *b != ',') b++;
+                int r = parse_int(a, b);
+                if (r > 0) op->ratios[op->ratio_n++] = r;
+                a = (b < val_end) ? b + 1 : b;
+            }
+        }
+    }
+    if (op->ratio_n < 1) {
+        die("Nema dopustenih omjera splittera");
+    }
+}
+
+static int opt_better(int goal, OptValue a, OptValue b) {
+    if (goal == 0) {
+        return a.fails < b.fails || (a.fails == b.fails && a.margin > b.margin);
+    }
+    return a.margin > b.margin || (a.margin == b.margin && a.fails < b.fails);
+}
+
+// ukupno smanjenje gubitka iznad djece čvora u za dano stanje u (promijenjeni preci, uz changed i sam u)
+static double opt_state_gain(const OptState* o, int32_t u, int32_t state, int changed) {
+    int64_t g = o->sums[o->set_off[u] + state] + (changed ? o->gain_q[u] : 0);
+    return (double)g / OPT_GAIN_SCALE;
+}
+
+// stanje djece čvora u za stanje u i izbor za u; -1 ako bi promjena prešla budžet
+static int32_t opt_kid_state(const OptState* o, int32_t u, int32_t state, int changed) {
+    if (!o->new_ratio[u]) return state;
+    int64_t g = o->sums[o->set_off[u] + state] + (changed ? o->gain_q[u] : 0);
+    const int64_t* k = o->sums + o->kid_off[u];
+    int32_t a = 0, b = o->kid_len[u];
+    while (a < b) {
+        int32_t m = a + (b - a) / 2;
+        if (k[m] < g) a = m + 1; else b = m;
+    }
+    return (a < o->kid_len[u] && k[a] == g) ? a : -1;
+}
+
+// skup stanja djece čvora u: za kandidata spoj {g} i {g + gain_q[u]} (uz jednu promjenu više,
+// do najviše budget promjena), inače skup samog u. Skupovi se dodaju na kraj spremišta sums.
+static void opt_kid_set(OptState* o, int32_t u, int budget) {
+    if (!o->new_ratio[u]) {
+        o->kid_off[u] = o->set_off[u];
+        o->kid_len[u] = o->set_len[u];
+        return;
+    }
+    size_t len = (size_t)o->set_len[u];
+    if (o->sum_n + 2 * len > o->sum_cap) {
+        while (o->sum_n + 2 * len > o->sum_cap) o->sum_cap = o->sum_cap ? o->sum_cap * 2 : 1024;
+        int64_t* ns = (int64_t*)realloc(o->sums, o->sum_cap * sizeof(int64_t));
+        int32_t* nk = (int32_t*)realloc(o->sum_k, o->sum_cap * sizeof(int32_t));
+        if (!ns || !nk) {
+            die("Nema slobodne memorije");
+        }
+        o->sums = ns;
+        o->sum_k = nk;
+    }
+    const int64_t* g = o->sums + o->set_off[u];
+    const int32_t* gk = o->sum_k + o->set_off[u];
+    int64_t d = o->gain_q[u];
+    int64_t* out = o->sums + o->sum_n;
+    int32_t* outk = o->sum_k + o->sum_n;
+    size_t i = 0, j = 0, n = 0;
+    while (i < len || j < len) {
+        // drugi niz je g + d uz jednu promjenu više; preskaču se zbrojevi iznad budžeta
+        if (j < len && gk[j] + 1 > budget) {
+            j++;
+            continue;
+        }
+        int64_t v;
+        int32_t k;
+        if (j >= len || (i < len && g[i] <= g[j] + d)) {
+            v = g[i];
+            k = gk[i];
+            i++;
+        } else {
+            v = g[j] + d;
+            k = gk[j] + 1;
+            j++;
+        }
+        if (n > 0 && out[n - 1] == v) {
+            if (k < outk[n - 1]) outk[n - 1] = k;
+        } else {
+            out[n] = v;
+            outk[n] = k;
+            n++;
+        }
+    }
+    o->kid_off[u] = (int64_t)o->sum_n;
+    o->kid_len[u] = (int32_t)n;
+    o->sum_n += n;
+}
+
+// spaja djecu [lo, hi) (redom, c = end[c]) u out[0..cap] za stanje djece cs: ONT-ovi su konstantni
+// doprinos, a tablice ne-ONT djece se kombiniraju kao ranac po budžetu. split (ako nije NULL) pamti
+// budžet dodijeljen svakom ne-ONT djetetu: split[ci * (budget + 1) + b]. Vraća cap.
+static int32_t opt_fold(const OptState* o, OptScratch* w, int32_t lo, int32_t hi, int32_t cs, double gain,
+    OptValue* out, int32_t* split) {
+    const FlatTopo* ft = o->ft;
+    int32_t budget = o->op.budget;
+    int32_t capa = 0;
+    int32_t base_fail = 0;
+    double base_min = HUGE_VAL;
+    int ci = 0;
+    out[0].fails = 0;
+    out[0].margin = HUGE_VAL;
+
+    for (int32_t c = lo; c < hi; c = ft->end[c]) {
+        if (ft->type[c] == NODE_ONT) {
+            int32_t k = o->ont_before[c];
+            if (o->es->ont_status[k] != ONT_DOWN) {
+                double m = o->es->ont_margin[k] + gain;
+                base_fail += (m < 0.0);
+                if (m < base_min) base_min = m;
+            }
+            continue;
+        }
+        const OptValue* t = o->table[c] + (size_t)cs * (size_t)(o->cap[c] + 1);
+        int32_t capc = o->cap[c];
+        int32_t capn = capa + capc < budget ? capa + capc : budget;
+        for (int32_t b = 0; b <= capn; b++) {
+            int32_t lo1 = b - capc > 0 ? b - capc : 0;
+            int32_t hi1 = b < capa ? b : capa;
+            OptValue best;
+            int32_t arg = 0;
+            for (int32_t b1 = lo1; b1 <= hi1; b1++) {
+                OptValue v;
+                v.fails = out[b1].fails + t[b - b1].fails;
+                v.margin = out[b1].margin < t[b - b1].margin ? out[b1].margin : t[b - b1].margin;
+                if (b1 == lo1 || opt_better(o->op.goal, v, best)) {
+                    best = v;
+                    arg = b - b1;
+                }
+            }
+            w->tmp[b] = best;
+            if (split) split[(size_t)ci * (size_t)(budget + 1) + (size_t)b] = arg;
+        }
+        memcpy(out, w->tmp, (size_t)(capn + 1) * sizeof(OptValue));
+        capa = capn;
+        ci++;
+    }
+    for (int32_t b = 0; b <= capa; b++) {
+        out[b].fails += base_fail;
+        if (base_min < out[b].margin) out[b].margin = base_min;
+    }
+    return capa;
+}
+
+// tablica čvora u iz tablica njegove djece; za kandidata se uspoređuje "ostavi" i "promijeni" (1 promjena)
+static void opt_node(OptState* o, OptScratch* w, int32_t u) {
+    const FlatTopo* ft = o->ft;
+    int32_t states = o->set_len[u];
+    int32_t capu = o->cap[u];
+    int32_t stride = capu + 1;
+    int can = o->new_ratio[u] != 0;
+    o->table[u] = (OptValue*)xmalloc((size_t)states * (size_t)stride * sizeof(OptValue));
+    o->chosen[u] = (uint8_t*)xmalloc((size_t)states * (size_t)stride);
+
+    for (int32_t st = 0; st < states; st++) {
+        int32_t cs1 = can ? opt_kid_state(o, u, st, 1) : -1;
+        int32_t cap0 = opt_fold(o, w, u + 1, ft->end[u], opt_kid_state(o, u, st, 0), opt_state_gain(o, u, st, 0), w->res0, NULL);
+        int32_t cap1 = (cs1 >= 0) ? opt_fold(o, w, u + 1, ft->end[u], cs1, opt_state_gain(o, u, st, 1), w->res1, NULL) : 0;
+        OptValue* t = o->table[u] + (size_t)st * (size_t)stride;
+        uint8_t* ch = o->chosen[u] + (size_t)st * (size_t)stride;
+        for (int32_t b = 0; b <= capu; b++) {
+            t[b] = w->res0[b < cap0 ? b : cap0];
+            ch[b] = 0;
+            if (cs1 >= 0 && b >= 1) {
+                OptValue v = w->res1[b - 1 < cap1 ? b - 1 : cap1];
+                if (opt_better(o->op.goal, v, t[b])) {
+                    t[b] = v;
+                    ch[b] = 1;
+                }
+            }
+        }
+    }
+}
+
+static void opt_scratch_init(OptScratch* w, int budget) {
+    size_t sz = (size_t)(budget + 1) * sizeof(OptValue);
+    w->acc = (OptValue*)xmalloc(sz);
+    w->tmp = (OptValue*)xmalloc(sz);
+    w->res0 = (OptValue*)xmalloc(sz);
+    w->res1 = (OptValue*)xmalloc(sz);
+}
+
+static void opt_scratch_free(OptScratch* w) {
+    free(w->acc);
+    free(w->tmp);
+    free(w->res0);
+    free(w->res1);
+}
+
+// nit uzima podstabla ispod OLT-ova i računa im tablice odozdo (obrnuti preorder)
+static void* opt_worker(void* arg) {
+    OptState* o = (OptState*)arg;
+    OptScratch w;
+    opt_scratch_init(&w, o->op.budget);
+    for (;;) {
+        int t = atomic_fetch_add(&o->next, 1);
+        if (t >= o->task_n) break;
+        int32_t r = o->tasks[t];
+        for (int32_t i = o->ft->end[r] - 1; i >= r; i--) {
+            if (o->ft->type[i] != NODE_ONT) opt_node(o, &w, i);
+        }
+    }
+    opt_scratch_free(&w);
+    return NULL;
+}
+
+// optimizator omjera splittera: najviše budget splittera smije dobiti manji dopušteni omjer
+// (ne manji od broja izravne djece). Gubitak splittera raste s omjerom pa je za promijenjeni
+// splitter uvijek najbolji najmanji dopušteni omjer - pretraga se svodi na izbor skupa splittera,
+// što se rješava točno dinamičkim programiranjem po stablu (ranac po budžetu). Rezultat se
+// provjerava inkrementalnom evaluacijom, a promjene se pišu u formatu za --updates.
+static void run_optimize(FlatTopo* ft, const OptParams* op, int threads) {
+    IncEngine e;
+    double t0 = now_sec();
+    inc_init(&e, ft);
+    size_t n = (size_t)ft->n;
+
+    OptState o;
+    memset(&o, 0, sizeof(o));
+    o.ft = ft;
+    o.es = &e.es;
+    o.ont_before = e.ont_before;
+    o.op = *op;
+    o.new_ratio = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    o.gain = (double*)xmalloc((n ? n : 1) * sizeof(double));
+    o.gain_q = (int64_t*)xmalloc((n ? n : 1) * sizeof(int64_t));
+    o.set_off = (int64_t*)xmalloc((n ? n : 1) * sizeof(int64_t));
+    o.set_len = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    o.kid_off = (int64_t*)xmalloc((n ? n : 1) * sizeof(int64_t));
+    o.kid_len = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    o.sum_cap = 1024;
+    o.sums = (int64_t*)xmalloc(o.sum_cap * sizeof(int64_t));
+    o.sum_k = (int32_t*)xmalloc(o.sum_cap * sizeof(int32_t));
+    o.sums[0] = 0;              // skup {0}: OLT-ovi na vrhu (iznad njih nema promjena)
+    o.sum_k[0] = 0;
+    o.sum_n = 1;
+    o.cap = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    o.table = (OptValue**)xmalloc((n ? n : 1) * sizeof(OptValue*));
+    o.chosen = (uint8_t**)xmalloc((n ? n : 1) * sizeof(uint8_t*));
+    memset(o.table, 0, n * sizeof(OptValue*));
+    memset(o.chosen, 0, n * sizeof(uint8_t*));
+
+    // kandidati: najmanji dopušteni omjer >= broj izravne djece i manji od trenutnog; splitter ispod
+    // kvara (DOWN) nije kandidat jer manji gubitak ništa ne mijenja
+    int32_t candidates = 0;
+    double min_before = HUGE_VAL;
+    for (int32_t i = 0; i < ft->n; i++) {
+        o.new_ratio[i] = 0;
+        o.gain[i] = 0.0;
+        o.gain_q[i] = 0;
+        int32_t p = ft->parent[i];
+        o.set_off[i] = (p < 0) ? 0 : o.kid_off[p];
+        o.set_len[i] = (p < 0) ? 1 : o.kid_len[p];
+        o.kid_off[i] = o.set_off[i];
+        o.kid_len[i] = o.set_len[i];
+        if (ft->type[i] == NODE_ONT) {
+            int32_t k = e.ont_before[i];
+            if (e.es.ont_status[k] != ONT_DOWN && e.es.ont_margin[k] < min_before) min_before = e.es.ont_margin[k];
+            continue;
+        }
+        if (ft->type[i] != NODE_SPLITTER || e.es.down[i]) continue;
+        int32_t ports = 0;
+        for (int32_t c = i + 1; c < ft->end[i]; c = ft->end[c]) ports++;
+        int best = 0;
+        for (int r = 0; r < op->ratio_n; r++) {
+            int q = op->ratios[r];
+            if (q >= ports && q < ft->ratio[i] && (best == 0 || q < best)) best = q;
+        }
+        if (best) {
+            o.new_ratio[i] = best;
+            o.gain[i] = splitter_loss_db(ft->ratio[i]) - splitter_loss_db(best);
+            o.gain_q[i] = llround(o.gain[i] * OPT_GAIN_SCALE);
+            candidates++;
+            opt_kid_set(&o, i, op->budget);
+        }
+    }
+    if (op->budget > candidates) o.op.budget = candidates;
+    int32_t budget = o.op.budget;
+
+    // cap[u] = min(budget, broj kandidata u podstablu)
+    for (int32_t i = ft->n - 1; i >= 0; i--) {
+        if (ft->type[i] == NODE_ONT) continue;
+        int32_t k = (o.new_ratio[i] != 0);
+        for (int32_t c = i + 1; c < ft->end[i]; c = ft->end[c]) {
+            if (ft->type[c] != NODE_ONT) k += o.cap[c];
+        }
+        o.cap[i] = k < budget ? k : budget;
+    }
+
+    // tablice rastu s brojem različitih zbrojeva predaka i budžetom; prevelike se odbijaju unaprijed
+    uint64_t table_bytes = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (ft->type[i] == NODE_ONT) continue;
+        table_bytes += (uint64_t)o.set_len[i] * (uint64_t)(o.cap[i] + 1) * (sizeof(OptValue) + 1);
+    }
+    if (table_bytes > OPT_TABLE_MAX) {
+        char msg[160];
+        snprintf(msg, sizeof(msg), "--optimize: tablice bi zauzele %.1f GB (najvise %.1f GB); smanjite budzet",
+            (double)table_bytes / 1e9, (double)OPT_TABLE_MAX / 1e9);
+        die(msg);
+    }
+
+    o.tasks = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    o.task_n = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) {
+        for (int32_t c = r + 1; c < ft->end[r]; c = ft->end[c]) {
+            if (ft->type[c] != NODE_ONT) o.tasks[o.task_n++] = c;
+        }
+    }
+    atomic_init(&o.next, 0);
+    double t_init = now_sec() - t0;
+
+    double t1 = now_sec();
+    if (threads > o.task_n) threads = o.task_n ? o.task_n : 1;
+    if (threads <= 1) {
+        opt_worker(&o);
+    } else {
+        pthread_t* tids = (pthread_t*)xmalloc((size_t)threads * sizeof(pthread_t));
+        for (int i = 0; i < threads; i++) {
+            if (pthread_create(&tids[i], NULL, opt_worker, &o) != 0) {
+                die("Nije moguce pokrenuti nit");
+            }
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(tids[i], NULL);
+        }
+        free(tids);
+    }
+
+    // OLT-ovi na vrhu, pa spajanje svih OLT-ova (budžet je zajednički)
+    OptScratch w;
+    opt_scratch_init(&w, budget);
+    int32_t root_n = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) root_n++;
+    int32_t* roots = (int32_t*)xmalloc((size_t)(root_n ? root_n : 1) * sizeof(int32_t));
+    root_n = 0;
+    for (int32_t r = 0; r < ft->n; r = ft->end[r]) roots[root_n++] = r;
+    for (int32_t k = root_n - 1; k >= 0; k--) {
+        opt_node(&o, &w, roots[k]);
+    }
+    OptValue* curve = (OptValue*)xmalloc((size_t)(budget + 1) * sizeof(OptValue));
+    int32_t* split = (int32_t*)xmalloc((size_t)(root_n ? root_n : 1) * (size_t)(budget + 1) * sizeof(int32_t));
+    int32_t capr = opt_fold(&o, &w, 0, ft->n, 0, 0.0, curve, split);
+    double t_search = now_sec() - t1;
+
+    printf("Kandidata: %d splittera, budzet: %d, cilj: %s, niti: %d\n", candidates, budget,
+        op->goal == 0 ? "najmanje FAIL" : "najveca najmanja margina", threads);
+    printf("Pocetno stanje: FAIL=%d, najmanja margina %.4f dB (evaluacija %.3f ms)\n", e.all.fail_count,
+        min_before == HUGE_VAL ? 0.0 : min_before, t_init * 1e3);
+    printf("\nBudzet  FAIL  najmanja margina\n");
+    for (int32_t b = 0; b <= capr; b++) {
+        printf("%6d  %4d  %.4f dB\n", b, curve[b].fails, curve[b].margin == HUGE_VAL ? 0.0 : curve[b].margin);
+    }
+
+    // rekonstrukcija odozgo: (čvor, stanje, budžet) na stogu, podjela budžeta se ponovno računa s split.
+    // Uzima se najmanji budžet koji postiže najbolji rezultat (bez suvišnih promjena).
+    int32_t best_b = capr;
+    while (best_b > 0 && !opt_better(op->goal, curve[best_b], curve[best_b - 1])) best_b--;
+    OptFrame* stk = (OptFrame*)xmalloc((n ? n : 1) * sizeof(OptFrame));
+    int32_t* kids = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    int32_t* changes = (int32_t*)xmalloc((size_t)(budget ? budget : 1) * sizeof(int32_t));
+    int32_t change_n = 0;
+    int32_t top = 0;
+    int32_t rem = best_b;
+    for (int32_t k = root_n - 1; k >= 0; k--) {
+        int32_t b2 = split[(size_t)k * (size_t)(budget + 1) + (size_t)rem];
+        stk[top].node = roots[k];
+        stk[top].state = 0;
+        stk[top].budget = b2;
+        top++;
+        rem -= b2;
+    }
+    int32_t* kid_split = NULL;
+    size_t kid_split_cap = 0;
+    while (top > 0) {
+        OptFrame f = stk[--top];
+        int32_t u = f.node;
+        int32_t b = f.budget < o.cap[u] ? f.budget : o.cap[u];
+        int x = o.chosen[u][(size_t)f.state * (size_t)(o.cap[u] + 1) + (size_t)b];
+        if (x) changes[change_n++] = u;
+        int32_t cs = opt_kid_state(&o, u, f.state, x);
+
+        int32_t kn = 0;
+        for (int32_t c = u + 1; c < ft->end[u]; c = ft->end[c]) {
+            if (ft->type[c] != NODE_ONT) kids[kn++] = c;
+        }
+        if (kn == 0) continue;
+        size_t need = (size_t)kn * (size_t)(budget + 1);
+        if (need > kid_split_cap) {
+            kid_split_cap = need;
+            free(kid_split);
+            kid_split = (int32_t*)xmalloc(kid_split_cap * sizeof(int32_t));
+        }
+        double g = opt_state_gain(&o, u, f.state, x);
+        int32_t capf = opt_fold(&o, &w, u + 1, ft->end[u], cs, g, w.acc, kid_split);
+        int32_t r = b - x < capf ? b - x : capf;
+        for (int32_t k = kn - 1; k >= 0; k--) {
+            int32_t b2 = kid_split[(size_t)k * (size_t)(budget + 1) + (size_t)r];
+            stk[top].node = kids[k];
+            stk[top].state = cs;
+            stk[top].budget = b2;
+            top++;
+            r -= b2;
+        }
+    }
+    qsort(changes, (size_t)change_n, sizeof(int32_t), cmp_int32);
+
+    // provjera: svaki zapisani redak se ponovno čita kao u --updates (selektor preko flat_select)
+    // i primjenjuje inkrementalno, pa datoteka sigurno pogađa iste splittere
+    FILE* f = fopen("optimize_changes.txt", "w");
+    if (!f) {
+        die("Nemoguce je otvoriti optimize_changes.txt za pisanje.");
+    }
+    fprintf(f, "# --optimize: budzet %d, cilj %s (ulaz za --updates)\n", budget, op->goal == 0 ? "fail" : "margin");
+    printf("\nPromjene (%d):\n", change_n);
+    char path[512];
+    for (int32_t k = 0; k < change_n; k++) {
+        int32_t u = changes[k];
+        flat_path(ft, u, path, sizeof(path));
+        printf("  %s: 1:%d -> 1:%d (-%.2f dB za %d ONT-ova)\n", path, ft->ratio[u], o.new_ratio[u], o.gain[u],
+            e.ont_before[ft->end[u]] - e.ont_before[u]);
+    }
+    for (int32_t k = 0; k < change_n; k++) {
+        int32_t u = changes[k];
+        // uz više OLT-ova na vrhu isto ime može postojati pod svakim, pa se navodi OLT#k/IME
+        char line[600];
+        int32_t olt = flat_root_ordinal(ft, flat_root_of(ft, u));
+        int len;
+        if (ft->name_len[u] > 0 && olt > 0) {
+            len = snprintf(line, sizeof(line), "splitter=OLT#%d/%.*s ratio=%d", olt, ft->name_len[u], ft->name[u], o.new_ratio[u]);
+        } else if (ft->name_len[u] > 0) {
+            len = snprintf(line, sizeof(line), "splitter=%.*s ratio=%d", ft->name_len[u], ft->name[u], o.new_ratio[u]);
+        } else {
+            len = snprintf(line, sizeof(line), "node=%d ratio=%d", u, o.new_ratio[u]);
+        }
+        if (len < 0 || len >= (int)sizeof(line)) {
+            die("--optimize: predugo ime splittera");
+        }
+        fprintf(f, "%s\n", line);
+
+        const char* sel = line;
+        if (flat_select(ft, &sel, line + len) != u) {
+            die("--optimize: zapis promjene ne pokazuje na odabrani splitter");
+        }
+        inc_set(&e, u, sel, line + len);
+        inc_update(&e, u);
+    }
+    STATS_FILE("optimize_changes.txt", ftell(f));
+    fclose(f);
+
+    double min_after = HUGE_VAL;
+    for (int32_t k = 0; k < ft->ont_count; k++) {
+        if (e.es.ont_status[k] != ONT_DOWN && e.es.ont_margin[k] < min_after) min_after = e.es.ont_margin[k];
+    }
+    printf("\nPredvideno: FAIL=%d, najmanja margina %.4f dB\n", curve[best_b].fails,
+        curve[best_b].margin == HUGE_VAL ? 0.0 : curve[best_b].margin);
+    printf("Provjereno: FAIL=%d, najmanja margina %.4f dB\n", e.all.fail_count, min_after == HUGE_VAL ? 0.0 : min_after);
+    printf("Pretraga: %.3f s\n", t_search);
+    printf("\nStvorene datoteke:\n");
+    printf(" - optimize_changes.txt\n");
+
+    for (int32_t i = 0; i < ft->n; i++) {
+        free(o.table[i]);
+        free(o.chosen[i]);
+    }
+    free(kid_split);
+    free(changes);
+    free(kids);
+    free(stk);
+    free(split);
+    free(curve);
+    free(roots);
+    opt_scratch_free(&w);
+    free(o.tasks);
+    free(o.table);
+    free(o.chosen);
+    free(o.cap);
+    free(o.gain_q);
+    free(o.sums);
+    free(o.sum_k);
+    free(o.set_off);
+    free(o.set_len);
+    free(o.kid_off);
+    free(o.kid_len);
+    free(o.gain);
+    free(o.new_ratio);
+    inc_free(&e);
+}
+
+// duboka kopija nizova (imena i dalje pokazuju u istu mapiranu topologiju)
+static void flat_clone(const FlatTopo* src, FlatTopo* dst) {
+    size_t n = (size_t)(src->n > 0 ? src->n : 1);
+    size_t m = (size_t)(src->ont_count > 0 ? src->ont_count : 1);
+    size_t o = (size_t)(src->olt_count > 0 ? src->olt_count : 1);
+    *dst = *src;
+    dst->mapped = 0;
+#define FLAT_CLONE(field, count) \
+    dst->field = xmalloc((count) * sizeof(*src->field)); \
+    memcpy((void*)dst->field, src->field, (count) * sizeof(*src->field))
+    FLAT_CLONE(type, n);
+    FLAT_CLONE(faulty, n);
+    FLAT_CLONE(parent, n);
+    FLAT_CLONE(end, n);
+    FLAT_CLONE(link_loss, n);
+    FLAT_CLONE(len_km, n);
+    FLAT_CLONE(conn, n);
+    FLAT_CLONE(splices, n);
+    FLAT_CLONE(extra, n);
+    FLAT_CLONE(ont_id, n);
+    FLAT_CLONE(ratio, n);
+    FLAT_CLONE(name, n);
+    FLAT_CLONE(name_len, n);
+    FLAT_CLONE(ont_node, m);
+    FLAT_CLONE(ont_parent, m);
+    FLAT_CLONE(ont_len, m);
+    FLAT_CLONE(ont_conn, m);
+    FLAT_CLONE(ont_sp, m);
+    FLAT_CLONE(ont_extra, m);
+    FLAT_CLONE(ont_faulty, m);
+    FLAT_CLONE(olt_tx_dbm, o);
+    FLAT_CLONE(olt_rxmin_dbm, o);
+    FLAT_CLONE(ont_slot, (size_t)src->ont_mask + 1);
+    FLAT_CLONE(spl_slot, (size_t)src->spl_mask + 1);
+#undef FLAT_CLONE
+}
+
+#ifndef _WIN32
+// čitatelj ulazi u aktivnu repliku; ponovna provjera nakon prijave sprječava ulazak u repliku
+// koju je pisac upravo proglasio neaktivnom
+static ServeReplica* serve_acquire(ServeState* st) {
+    for (;;) {
+        int a = atomic_load(&st->active);
+        atomic_fetch_add(&st->rep[a].readers, 1);
+        if (atomic_load(&st->active) == a) {
+            return &st->rep[a];
+        }
+        atomic_fetch_sub(&st->rep[a].readers, 1);
+    }
+}
+
+static void serve_release(ServeReplica* r) {
+    atomic_fetch_sub(&r->readers, 1);
+}
+
+// pisac čeka da repliku napuste upiti koji su je zatekli (upiti su kratki pa se samo popušta CPU)
+static void serve_wait_readers(ServeReplica* r) {
+    while (atomic_load(&r->readers) != 0) {
+        sched_yield();
+    }
+}
+
+static void serve_stats_line(TextBuf* out, const SubtreeStats* st) {
+    char line[256];
+    int len = snprintf(line, sizeof(line), "OK onts=%d ok=%d fail=%d down=%d avg_rx=%.4f avg_loss=%.4f best_rx=%.4f worst_rx=%.4f\n",
+        st->ont_count, st->ok_count, st->fail_count, st->down_count,
+        st->ont_count ? st->sum_rx / st->ont_count : 0.0, st->ont_count ? st->sum_loss / st->ont_count : 0.0,
+        st->ont_count ? st->best_rx : 0.0, st->ont_count ? st->worst_rx : 0.0);
+    textbuf_append(out, line, (size_t)len);
+}
+
+static void serve_ont_line(TextBuf* out, const ServeReplica* r, int32_t i, const char* prefix) {
+    const FlatTopo* ft = &r->ft;
+    int32_t k = r->e.ont_before[i];
+    char path[512];
+    char line[768];
+    flat_path(ft, i, path, sizeof(path));
+    int len = snprintf(line, sizeof(line), "%sont=%d margin=%.4f rx=%.4f loss=%.4f dist=%.4f status=%s path=%s\n",
+        prefix, ft->ont_id[i], r->e.es.ont_margin[k], r->e.es.ont_rx[k], r->e.es.ont_loss[k], r->e.es.ont_dist[k],
+        ONT_STATUS_NAME[r->e.es.ont_status[k]], path);
+    textbuf_append(out, line, (size_t)len > sizeof(line) - 1 ? sizeof(line) - 1 : (size_t)len);
+}
+
+static void serve_error(TextBuf* out, const char* msg) {
+    textbuf_append(out, "ERR ", 4);
+    textbuf_append(out, msg, strlen(msg));
+    textbuf_append(out, "\n", 1);
+}
+
+// upiti (čitanje aktivne replike):
+//   ont <id> | splitter <ime> | stats [selektor] | worst <N> [selektor]
+static void serve_query(ServeState* st, const char* cmd, size_t cmd_len, const char* s, const char* end, TextBuf* out) {
+    ServeReplica* r = serve_acquire(st);
+    const FlatTopo* ft = &r->ft;
+    while (s < end && (*s == ' ' || *s == '\t')) s++;
+
+    if (cmd_len == 3 && memcmp(cmd, "ont", 3) == 0) {
+        int32_t i = flat_find(ft, "ont", 3, s, end);
+        if (i < 0) {
+            serve_error(out, "ONT nije pronaden");
+        } else {
+            serve_ont_line(out, r, i, "OK ");
+        }
+    } else if (cmd_len == 8 && memcmp(cmd, "splitter", 8) == 0) {
+        int32_t i = flat_find(ft, "splitter", 8, s, end);
+        if (i < 0) {
+            serve_error(out, "splitter nije pronaden");
+        } else {
+            serve_stats_line(out, &r->e.st[i]);
+        }
+    } else if (cmd_len == 5 && memcmp(cmd, "stats", 5) == 0) {
+        if (s == end) {
+            serve_stats_line(out, &r->e.all);
+        } else {
+            int32_t i = flat_select(ft, &s, end);
+            if (i < 0) {
+                serve_error(out, "cvor nije pronaden");
+            } else {
+                serve_stats_line(out, &r->e.st[i]);
+            }
+        }
+    } else if (cmd_len == 5 && memcmp(cmd, "worst", 5) == 0) {
+        // N dolazi od klijenta: samo znamenke, a hrpa nikad nije veća od broja ONT-ova podstabla
+        const char* q = s;
+        long long want = 0;
+        while (q < end && *q != ' ' && *q != '\t') {
+            if (*q < '0' || *q > '9') {
+                want = -1;
+                break;
+            }
+            if (want < 1000000000LL) want = want * 10 + (*q - '0');   // zasićuje, ionako se reže na broj ONT-ova
+            q++;
+        }
+        while (q < end && *q != ' ' && *q != '\t') q++;
+        s = q;
+        while (s < end && (*s == ' ' || *s == '\t')) s++;
+        int32_t lo = 0, hi = ft->n;
+        if (s < end) {
+            int32_t i = flat_select(ft, &s, end);
+            lo = i;
+            hi = (i >= 0) ? ft->end[i] : -1;
+        }
+        if (want <= 0 || lo < 0) {
+            serve_error(out, want <= 0 ? "neispravan N" : "cvor nije pronaden");
+        } else {
+            // ONT-ovi podstabla su uzastopni pa se prolazi samo njihov raspon
+            int32_t onts = r->e.ont_before[hi] - r->e.ont_before[lo];
+            TopN top;
+            topn_init(&top, want < onts ? (int)want : onts);
+            for (int32_t k = r->e.ont_before[lo]; k < r->e.ont_before[hi]; k++) {
+                OntResult res;
+                res.node = ft->ont_node[k];
+                res.ont_id = ft->ont_id[res.node];
+                res.rx_dbm = r->e.es.ont_rx[k];
+                res.margin_db = r->e.es.ont_margin[k];
+                topn_push(&top, &res);
+            }
+            topn_sort(&top);
+            char line[64];
+            int len = snprintf(line, sizeof(line), "OK n=%d\n", top.n);
+            textbuf_append(out, line, (size_t)len);
+            for (int j = 0; j < top.n; j++) {
+                serve_ont_line(out, r, top.arr[j].node, "");
+            }
+            free(top.arr);
+        }
+    } else {
+        serve_error(out, "nepoznata naredba");
+    }
+    serve_release(r);
+}
+
+// set <selektor> key=val ...: ista promjena ide na obje replike, čitatelji nikad ne čekaju
+static void serve_update(ServeState* st, const char* s, const char* end, TextBuf* out) {
+    pthread_mutex_lock(&st->write_mu);
+    int a = atomic_load(&st->active);
+    ServeReplica* ra = &st->rep[a];
+    ServeReplica* rb = &st->rep[1 - a];
+
+    int32_t u = flat_select(&rb->ft, &s, end);
+    if (u < 0) {
+        pthread_mutex_unlock(&st->write_mu);
+        serve_error(out, "cvor nije pronaden");
+        return;
+    }
+    serve_wait_readers(rb);
+    inc_set(&rb->e, u, s, end);
+    inc_update(&rb->e, u);
+    atomic_store(&st->active, 1 - a);
+
+    serve_wait_readers(ra);
+    inc_set(&ra->e, u, s, end);
+    inc_update(&ra->e, u);
+
+    char line[160];
+    int len = snprintf(line, sizeof(line), "OK node=%d subtree=%d ok=%d fail=%d down=%d\n",
+        u, rb->ft.end[u] - u, rb->e.all.ok_count, rb->e.all.fail_count, rb->e.all.down_count);
+    pthread_mutex_unlock(&st->write_mu);
+    textbuf_append(out, line, (size_t)len);
+}
+
+// jedna veza: naredbe po linijama, odgovor počinje s OK ili ERR
+static void* serve_conn_thread(void* arg) {
+    ServeConn* c = (ServeConn*)arg;
+    ServeState* st = c->st;
+    TextBuf in = { NULL, 0, 0 };
+    TextBuf out = { NULL, 0, 0 };
+    int open = 1;
+    int stop = 0;
+
+    while (open) {
+        if (in.len >= SERVE_LINE_MAX) {
+            // linija bez kraja: klijent ne smije neograničeno puniti memoriju poslužitelja
+            static const char msg[] = "ERR linija je preduga\n";
+            ssize_t w = write(c->fd, msg, sizeof(msg) - 1);
+            (void)w;            // veza se ionako zatvara
+            break;
+        }
+        textbuf_reserve(&in, 4096);
+        ssize_t got = read(c->fd, in.data + in.len, in.cap - in.len - 1);
+        if (got <= 0) break;
+        in.len += (size_t)got;
+
+        size_t done = 0;
+        for (;;) {
+            char* nl = (char*)memchr(in.data + done, '\n', in.len - done);
+            if (!nl) break;
+            const char* s = in.data + done;
+            const char* le = nl;
+            done = (size_t)(nl - in.data) + 1;
+            while (le > s && is_space(le[-1])) le--;
+            while (s < le && is_space(*s)) s++;
+            if (s == le) continue;
+
+            const char* cmd = s;
+            while (s < le && *s != ' ' && *s != '\t') s++;
+            size_t cmd_len = (size_t)(s - cmd);
+            out.len = 0;
+            if (cmd_len == 3 && memcmp(cmd, "set", 3) == 0) {
+                serve_update(st, s, le, &out);
+            } else if (cmd_len == 4 && memcmp(cmd, "quit", 4) == 0) {
+                open = 0;
+                break;
+            } else if (cmd_len == 8 && memcmp(cmd, "shutdown", 8) == 0) {
+                textbuf_append(&out, "OK\n", 3);
+                stop = 1;
+                open = 0;
+            } else {
+                serve_query(st, cmd, cmd_len, s, le, &out);
+            }
+
+            size_t off = 0;
+            while (off < out.len) {
+                ssize_t w = write(c->fd, out.data + off, out.len - off);
+                if (w <= 0) {
+                    open = 0;
+                    break;
+                }
+                off += (size_t)w;
+            }
+            if (!open) break;
+        }
+        memmove(in.data, in.data + done, in.len - done);
+        in.len -= done;
+    }
+
+    close(c->fd);
+    free(in.data);
+    free(out.data);
+    free(c);
+    if (stop) {
+        // odgovor je već poslan; accept u glavnoj niti se prekida
+        atomic_store(&st->stop, 1);
+        shutdown(st->listen_fd, SHUT_RDWR);
+    }
+    return NULL;
+}
+
+// poslužitelj: topologija se učita jednom, upiti i promjene stižu preko Unix socketa
+static void run_serve(const FlatTopo* ft, const char* sock_path) {
+    ServeState st;
+    memset(&st, 0, sizeof(st));
+    for (int r = 0; r < 2; r++) {
+        flat_clone(ft, &st.rep[r].ft);
+        inc_init(&st.rep[r].e, &st.rep[r].ft);
+        atomic_init(&st.rep[r].readers, 0);
+    }
+    atomic_init(&st.active, 0);
+    atomic_init(&st.stop, 0);
+    pthread_mutex_init(&st.write_mu, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) {
+        die("Putanja socketa je preduga");
+    }
+    strcpy(addr.sun_path, sock_path);
+
+    st.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (st.listen_fd < 0) {
+        die("Nemoguce je stvoriti socket");
+    }
+    unlink(sock_path);
+    if (bind(st.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(st.listen_fd, 64) != 0) {
+        die("Nemoguce je otvoriti socket za slusanje");
+    }
+    printf("Posluzitelj spreman na %s (ONT: %d, cvorova: %d)\n", sock_path, ft->ont_count, ft->n);
+    fflush(stdout);
+
+    // bez slobodnih opisnika ili dretvi poslužitelj ne umire nego kratko pričeka da se veze zatvore
+    const struct timespec backoff = { 0, 100 * 1000 * 1000 };
+    while (!atomic_load(&st.stop)) {
+        int fd = accept(st.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (atomic_load(&st.stop)) break;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                nanosleep(&backoff, NULL);
+            }
+            continue;
+        }
+        ServeConn* c = (ServeConn*)xmalloc(sizeof(ServeConn));
+        c->st = &st;
+        c->fd = fd;
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, serve_conn_thread, c) != 0) {
+            close(fd);
+            free(c);
+            nanosleep(&backoff, NULL);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+
+    close(st.listen_fd);
+    unlink(sock_path);
+    printf("Posluzitelj zaustavljen\n");
+    // ostale veze mogu još čitati replike pa se one oslobađaju tek izlaskom iz procesa
+}
+#else
+static void run_serve(const FlatTopo* ft, const char* sock_path) {
+    (void)ft;
+    (void)sock_path;
+    die("--serve zahtijeva Unix domain sockete (nije podrzano na Windowsima)");
+}
+#endif
+
+static void scenario_set_init(ScenarioSet* set) {
+    memset(set, 0, sizeof(*set));
+}
+
+static void scenario_set_free(ScenarioSet* set) {
+    free(set->arr);
+    free(set->edits);
+    memset(set, 0, sizeof(*set));
+}
+
+static Scenario* scenario_new(ScenarioSet* set, const char* name, size_t name_len, const LossParams* lp) {
+    if (set->n == set->cap) {
+        size_t newcap = set->cap ? set->cap * 2 : 64;
+        Scenario* p = (Scenario*)realloc(set->arr, newcap * sizeof(Scenario));
+        if (!p) {
+            die("Nema slobodne memorije (realloc)");
+        }
+        STATS_ALLOC(newcap * sizeof(Scenario));
+        set->arr = p;
+        set->cap = newcap;
+    }
+    Scenario* sc = &set->arr[set->n++];
+    memset(sc, 0, sizeof(*sc));
+    if (name_len > sizeof(sc->name) - 1) name_len = sizeof(sc->name) - 1;
+    memcpy(sc->name, name, name_len);
+    sc->lp = *lp;
+    sc->edit_first = set->edit_n;
+    return sc;
+}
+
+// promjene scenarija su uvijek zadnje dodane pa je dovoljan raspon u zajedničkom nizu
+static void scenario_add_edit(ScenarioSet* set, Scenario* sc, int32_t node, const char* kv, const char* kv_end) {
+    if (set->edit_n == set->edit_cap) {
+        size_t newcap = set->edit_cap ? set->edit_cap * 2 : 64;
+        ScenarioEdit* p = (ScenarioEdit*)realloc(set->edits, newcap * sizeof(ScenarioEdit));
+        if (!p) {
+            die("Nema slobodne memorije (realloc)");
+        }
+        STATS_ALLOC(newcap * sizeof(ScenarioEdit));
+        set->edits = p;
+        set->edit_cap = newcap;
+    }
+    ScenarioEdit* e = &set->edits[set->edit_n++];
+    e->node = node;
+    e->kv = kv;
+    e->kv_end = kv_end;
+    sc->edit_count++;
+}
+
+static int is_loss_key(const char* key, size_t key_len) {
+    return (key_len == 5 && memcmp(key, "atten", 5) == 0) ||
+           (key_len == 9 && memcmp(key, "conn_loss", 9) == 0) ||
+           (key_len == 11 && memcmp(key, "splice_loss", 11) == 0) ||
+           (key_len == 8 && memcmp(key, "ins_loss", 8) == 0);
+}
+
+static int is_selector(const char* key, size_t key_len) {
+    return (key_len == 3 && memcmp(key, "ont", 3) == 0) ||
+           (key_len == 4 && memcmp(key, "node", 4) == 0) ||
+           (key_len == 8 && memcmp(key, "splitter", 8) == 0);
+}
+
+// jedna linija = jedan scenarij:  IME [atten=..] [conn_loss=..] [splice_loss=..] [ins_loss=..]
+//                                 [selektor key=val ...] [selektor key=val ...] ...
+// selektor je ont=, splitter= (npr. S3*) ili node=; only_ratio=N sužava odabir na splittere 1:N.
+// Umjesto imena može stajati each_splitter[=uzorak]: po jedan scenarij za svaki takav splitter.
+static void read_scenarios(const char* filename, const FlatTopo* ft, MappedFile* mf, ScenarioSet* set) {
+    map_file(filename, mf);
+    const char* p = mf->data;
+    const char* end = p ? p + mf->len : NULL;
+    LossParams base = loss_params_default();
+
+    while (p < end) {
+        const char* line = p;
+        const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        p = (eol < end) ? eol + 1 : end;
+
+        const char* le = eol;
+        while (le > line && is_space(le[-1])) le--;
+        const char* s = line;
+        while (s < le && is_space(*s)) s++;
+        if (s == le || *s == '#') continue;
+
+        const char* name = s;
+        while (s < le && *s != ' ' && *s != '\t') s++;
+        const char* name_end = s;
+
+        // parametri gubitaka vrijede za cijelu liniju
+        LossParams lp = base;
+        const char* q = s;
+        const char *key, *val, *val_end;
+        size_t key_len;
+        while (next_kv(&q, le, &key, &key_len, &val, &val_end)) {
+            if (key_len == 5 && memcmp(key, "atten", 5) == 0) {
+                lp.atten_db_per_km = parse_double(val, val_end);
+            } else if (key_len == 9 && memcmp(key, "conn_loss", 9) == 0) {
+                lp.conn_loss_db = parse_double(val, val_end);
+            } else if (key_len == 11 && memcmp(key, "splice_loss", 11) == 0) {
+                lp.splice_loss_db = parse_double(val, val_end);
+            } else if (key_len == 8 && memcmp(key, "ins_loss", 8) == 0) {
+                lp.splitter_ins_db = parse_double(val, val_end);
+            }
+        }
+
+        // each_splitter[=uzorak] -> jedan scenarij po splitteru
+        const char* each = NULL;
+        const char* each_end = NULL;
+        if (name_end - name >= 13 && memcmp(name, "each_splitter", 13) == 0) {
+            if (name_end - name == 13) {
+                each = "*";
+                each_end = each + 1;
+            } else if (name[13] == '=') {
+                each = name + 14;
+                each_end = name_end;
+            }
+        }
+        // tokeni prije prvog selektora (kod each_splitter se odnose na sam splitter)
+        const char* own_end = s;
+        q = s;
+        while (next_kv(&q, le, &key, &key_len, &val, &val_end) && !is_selector(key, key_len)) {
+            if (!each && !is_loss_key(key, key_len)) {
+                die("Scenarij: prije prvog selektora dopusteni su samo atten, conn_loss, splice_loss i ins_loss");
+            }
+            own_end = q;
+        }
+
+        int32_t count = each ? ft->n : 1;
+        for (int32_t target = 0; target < count; target++) {
+            Scenario* sc;
+            if (each) {
+                if (!flat_match(ft, target, "splitter", 8, each, each_end)) continue;
+                sc = scenario_new(set, ft->name[target], (size_t)ft->name_len[target], &lp);
+                scenario_add_edit(set, sc, target, s, own_end);
+            } else {
+                sc = scenario_new(set, name, (size_t)(name_end - name), &lp);
+            }
+
+            // grupe "selektor key=val ..." do sljedećeg selektora
+            q = s;
+            const char* sel = NULL;
+            const char* sel_end = NULL;
+            const char* sel_val = NULL;
+            size_t sel_len = 0;
+            const char* group = NULL;
+            for (;;) {
+                const char* before = q;
+                int more = next_kv(&q, le, &key, &key_len, &val, &val_end);
+                if (!more || is_selector(key, key_len)) {
+                    if (sel) {
+                        // zatvara prethodnu grupu: tokeni [group, before)
+                        int only_ratio = 0;
+                        const char* g = group;
+                        const char *k2, *v2, *v2e;
+                        size_t k2_len;
+                        while (next_kv(&g, before, &k2, &k2_len, &v2, &v2e)) {
+                            if (k2_len == 10 && memcmp(k2, "only_ratio", 10) == 0) {
+                                only_ratio = parse_int(v2, v2e);
+                            }
+                        }
+                        for (int32_t i = 0; i < ft->n; i++) {
+                            if (!flat_match(ft, i, sel, sel_len, sel_val, sel_end)) continue;
+                            if (only_ratio && ft->ratio[i] != only_ratio) continue;
+                            scenario_add_edit(set, sc, i, group, before);
+                        }
+                    }
+                    if (!more) break;
+                    sel = key;
+                    sel_len = key_len;
+                    sel_val = val;
+                    sel_end = val_end;
+                    group = q;
+                }
+            }
+        }
+    }
+}
+
+// privatne kopije samo onih nizova koje scenarij mijenja; ostalo se dijeli s ft
+static void scenario_scratch_init(ScenarioScratch* w, const FlatTopo* ft) {
+    size_t n = (size_t)(ft->n > 0 ? ft->n : 1);
+    size_t m = (size_t)(ft->ont_count > 0 ? ft->ont_count : 1);
+    size_t o = (size_t)(ft->olt_count > 0 ? ft->olt_count : 1);
+    memset(w, 0, sizeof(*w));
+    w->view = *ft;
+    w->view.link_loss = (double*)xmalloc(n * sizeof(double));
+    w->view.faulty = (uint8_t*)xmalloc(n);
+    w->view.ont_len = (double*)xmalloc(m * sizeof(double));
+    w->view.ont_conn = (int32_t*)xmalloc(m * sizeof(int32_t));
+    w->view.ont_sp = (int32_t*)xmalloc(m * sizeof(int32_t));
+    w->view.ont_extra = (double*)xmalloc(m * sizeof(double));
+    w->view.ont_faulty = (int32_t*)xmalloc(m * sizeof(int32_t));
+    w->view.olt_tx_dbm = (double*)xmalloc(o * sizeof(double));
+    w->view.olt_rxmin_dbm = (double*)xmalloc(o * sizeof(double));
+    memcpy(w->view.link_loss, ft->link_loss, (size_t)ft->n * sizeof(double));
+    memcpy(w->view.faulty, ft->faulty, (size_t)ft->n);
+    memcpy(w->view.ont_len, ft->ont_len, (size_t)ft->ont_count * sizeof(double));
+    memcpy(w->view.ont_conn, ft->ont_conn, (size_t)ft->ont_count * sizeof(int32_t));
+    memcpy(w->view.ont_sp, ft->ont_sp, (size_t)ft->ont_count * sizeof(int32_t));
+    memcpy(w->view.ont_extra, ft->ont_extra, (size_t)ft->ont_count * sizeof(double));
+    memcpy(w->view.ont_faulty, ft->ont_faulty, (size_t)ft->ont_count * sizeof(int32_t));
+    memcpy(w->view.olt_tx_dbm, ft->olt_tx_dbm, (size_t)ft->olt_count * sizeof(double));
+    memcpy(w->view.olt_rxmin_dbm, ft->olt_rxmin_dbm, (size_t)ft->olt_count * sizeof(double));
+
+    eval_state_init(&w->es, ft);
+    w->cur_lp = loss_params_default();
+    w->slot = (int32_t*)xmalloc(n * sizeof(int32_t));
+    for (size_t i = 0; i < n; i++) w->slot[i] = -1;
+}
+
+static void scenario_scratch_free(ScenarioScratch* w) {
+    free(w->view.link_loss);
+    free(w->view.faulty);
+    free(w->view.ont_len);
+    free(w->view.ont_conn);
+    free(w->view.ont_sp);
+    free(w->view.ont_extra);
+    free(w->view.ont_faulty);
+    free(w->view.olt_tx_dbm);
+    free(w->view.olt_rxmin_dbm);
+    eval_state_free(&w->es);
+    free(w->slot);
+    free(w->nodes);
+    free(w->touched);
+}
+
+// upisuje (izmijenjeni ili izvorni) čvor u privatne nizove pogleda; ord kao u flat_node_store
+static void scenario_store(ScenarioScratch* w, int32_t i, int32_t ord, const Node* n) {
+    FlatTopo* v = &w->view;
+    v->faulty[i] = (uint8_t)n->faulty;
+    v->link_loss[i] = node_link_loss_db(&w->cur_lp, n);
+    if (n->type == NODE_OLT) {
+        v->olt_tx_dbm[ord] = n->olt_tx_dbm;
+        v->olt_rxmin_dbm[ord] = n->gpon_rxmin_dbm;
+    } else if (n->type == NODE_ONT) {
+        v->ont_len[ord] = n->len_km;
+        v->ont_conn[ord] = n->connectors;
+        v->ont_sp[ord] = n->splices;
+        v->ont_extra[ord] = n->faulty ? n->extra_loss_db : 0.0;
+        v->ont_faulty[ord] = n->faulty;
+    }
+}
+
+// primijeni promjene, izračunaj kontekst + ONT kernel nad pogledom, pa vrati pogled u izvorno stanje
+static ScenarioResult scenario_eval(ScenarioScratch* w, const FlatTopo* ft, const int32_t* ord,
+    const ScenarioSet* set, const Scenario* sc) {
+    // novi parametri gubitaka: link_loss svih ne-ONT čvorova iznova (ONT-ove računa kernel)
+    if (memcmp(&w->cur_lp, &sc->lp, sizeof(LossParams)) != 0) {
+        w->cur_lp = sc->lp;
+        for (int32_t i = 0; i < ft->n; i++) {
+            if (ft->type[i] == NODE_ONT) continue;
+            Node n;
+            flat_node_load(ft, i, ord[i], &n);
+            w->view.link_loss[i] = node_link_loss_db(&w->cur_lp, &n);
+        }
+    }
+
+    // promjene se slažu po čvoru (više promjena istog čvora se zbrajaju)
+    w->touched_n = 0;
+    for (size_t e = sc->edit_first; e < sc->edit_first + sc->edit_count; e++) {
+        const ScenarioEdit* ed = &set->edits[e];
+        int32_t i = ed->node;
+        if (w->slot[i] < 0) {
+            if (w->touched_n == w->touched_cap) {
+                size_t newcap = w->touched_cap ? w->touched_cap * 2 : 64;
+                int32_t* t = (int32_t*)realloc(w->touched, newcap * sizeof(int32_t));
+                Node* nn = (Node*)realloc(w->nodes, newcap * sizeof(Node));
+                if (!t || !nn) {
+                    die("Nema slobodne memorije (realloc)");
+                }
+                STATS_ALLOC(newcap * (sizeof(int32_t) + sizeof(Node)));
+                w->touched = t;
+                w->nodes = nn;
+                w->touched_cap = newcap;
+            }
+            w->slot[i] = (int32_t)w->touched_n;
+            w->touched[w->touched_n] = i;
+            flat_node_load(ft, i, ord[i], &w->nodes[w->touched_n]);
+            w->touched_n++;
+        }
+        Node* n = &w->nodes[w->slot[i]];
+        apply_kv_all(n, ed->kv, ed->kv_end);
+        n->name = ft->name[i];
+        n->name_len = ft->name_len[i];
+    }
+    for (size_t t = 0; t < w->touched_n; t++) {
+        int32_t i = w->touched[t];
+        scenario_store(w, i, ord[i], &w->nodes[t]);
+    }
+
+    EvalState* es = &w->es;
+    es->lp = sc->lp;
+    flat_eval_context(&w->view, es, 0, ft->n, 0);
+    es->kernel(&w->view, &es->lp, es, 0, ft->ont_count);
+
+    ScenarioResult r;
+    r.st = stats_init();
+    r.worst_margin = 1e9;
+    r.worst_ont_id = -1;
+    for (int32_t k = 0; k < ft->ont_count; k++) {
+        SubtreeStats one = stats_ont(es->ont_status[k], es->ont_rx[k], es->ont_loss[k]);
+        stats_merge(&r.st, &one);
+        if (es->ont_margin[k] < r.worst_margin) {
+            r.worst_margin = es->ont_margin[k];
+            r.worst_ont_id = ft->ont_id[ft->ont_node[k]];
+        }
+    }
+
+    // povratak izvornih vrijednosti za sljedeći scenarij
+    for (size_t t = 0; t < w->touched_n; t++) {
+        int32_t i = w->touched[t];
+        Node n;
+        flat_node_load(ft, i, ord[i], &n);
+        scenario_store(w, i, ord[i], &n);
+        w->slot[i] = -1;
+    }
+    return r;
+}
+
+typedef struct {
+    const FlatTopo* ft;
+    const int32_t* ord;
+    const ScenarioSet* set;
+    ScenarioResult* results;
+    atomic_int next;
+} ScenarioPool;
+
+static void* scenario_worker(void* arg) {
+    ScenarioPool* pool = (ScenarioPool*)arg;
+    ScenarioScratch w;
+    scenario_scratch_init(&w, pool->ft);
+    for (;;) {
+        int i = atomic_fetch_add(&pool->next, 1);
+        if (i >= (int)pool->set->n) break;
+        pool->results[i] = scenario_eval(&w, pool->ft, pool->ord, pool->set, &pool->set->arr[i]);
+    }
+    scenario_scratch_free(&w);
+    return NULL;
+}
+
+// scenariji dijele kompilirano stablo; niti uzimaju scenarije redom, rezultati idu u redoslijedu datoteke
+static void run_scenarios(const FlatTopo* ft, const char* filename, int threads) {
+    MappedFile mf;
+    ScenarioSet set;
+    scenario_set_init(&set);
+    read_scenarios(filename, ft, &mf, &set);
+
+    // redni broj ONT-a / OLT-a po čvoru (za ONT i OLT stupce)
+    int32_t* ord = (int32_t*)xmalloc((size_t)(ft->n > 0 ? ft->n : 1) * sizeof(int32_t));
+    int32_t onts = 0, olts = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        ord[i] = (ft->type[i] == NODE_ONT) ? onts++ : (ft->type[i] == NODE_OLT) ? olts++ : -1;
+    }
+
+    ScenarioPool pool;
+    pool.ft = ft;
+    pool.ord = ord;
+    pool.set = &set;
+    pool.results = (ScenarioResult*)xmalloc((set.n ? set.n : 1) * sizeof(ScenarioResult));
+    atomic_init(&pool.next, 0);
+
+    if (threads > (int)set.n) threads = set.n ? (int)set.n : 1;
+    double t0 = now_sec();
+    if (threads <= 1) {
+        scenario_worker(&pool);
+    } else {
+        pthread_t* tids = (pthread_t*)xmalloc((size_t)threads * sizeof(pthread_t));
+        for (int i = 0; i < threads; i++) {
+            if (pthread_create(&tids[i], NULL, scenario_worker, &pool) != 0) {
+                die("Nije moguce pokrenuti nit");
+            }
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(tids[i], NULL);
+        }
+        free(tids);
+    }
+    double t1 = now_sec();
+
+    FILE* f = fopen("scenario_results.csv", "w");
+    if (!f) {
+        die("Nemoguce je otvoriti scenario_results.csv za pisanje.");
+    }
+    fprintf(f, "scenario,edits,ont_count,ok_count,fail_count,down_count,avg_rx_dbm,avg_loss_db,worst_rx_dbm,worst_margin_db,worst_ont_id\n");
+    for (size_t i = 0; i < set.n; i++) {
+        const ScenarioResult* r = &pool.results[i];
+        double avg_rx = r->st.ont_count ? r->st.sum_rx / r->st.ont_count : 0.0;
+        double avg_loss = r->st.ont_count ? r->st.sum_loss / r->st.ont_count : 0.0;
+        fprintf(f, "\"%s\",%zu,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%d\n",
+            set.arr[i].name, set.arr[i].edit_count, r->st.ont_count, r->st.ok_count, r->st.fail_count, r->st.down_count,
+            avg_rx, avg_loss, r->st.ont_count ? r->st.worst_rx : 0.0, r->st.ont_count ? r->worst_margin : 0.0, r->worst_ont_id);
+    }
+    STATS_FILE("scenario_results.csv", ftell(f));
+    fclose(f);
+
+    printf("Scenarija: %zu, niti: %d, vrijeme: %.3f s (%.1f scenarija/s)\n",
+        set.n, threads, t1 - t0, (t1 - t0) > 0 ? (double)set.n / (t1 - t0) : 0.0);
+    printf("\nStvorene datoteke:\n");
+    printf(" - scenario_results.csv\n");
+
+    free(pool.results);
+    free(ord);
+    scenario_set_free(&set);
+    unmap_file(&mf);
+}
+
+// Philox4x32-10 (Salmon et al.): brojač -> 4 nezavisna 32-bitna broja; isti (ključ, brojač)
+// uvijek daje isti rezultat pa uzorci ne ovise o broju niti ni o redoslijedu obrade
+static void philox4x32(uint32_t ctr[4], uint32_t k0, uint32_t k1) {
+    for (int r = 0; r < 10; r++) {
+        uint64_t p0 = (uint64_t)0xD2511F53u * ctr[0];
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * ctr[2];
+        uint32_t c0 = (uint32_t)(p1 >> 32) ^ ctr[1] ^ k0;
+        uint32_t c2 = (uint32_t)(p0 >> 32) ^ ctr[3] ^ k1;
+        ctr[1] = (uint32_t)p1;
+        ctr[3] = (uint32_t)p0;
+        ctr[0] = c0;
+        ctr[2] = c2;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+}
+
+// MC_LANES standardnih normalnih uzoraka za čvor u bloku pokusa (Box-Muller).
+// Petlje su po trakama (SoA) da ih prevoditelj može vektorizirati.
+static void mc_normals(uint64_t seed, uint32_t block, uint32_t node, double* z) {
+    uint32_t c[4][MC_LANES / 4];
+    for (int j = 0; j < MC_LANES / 4; j++) {
+        uint32_t ctr[4] = { block, node, (uint32_t)j, 0x4d43u };
+        philox4x32(ctr, (uint32_t)seed, (uint32_t)(seed >> 32));
+        c[0][j] = ctr[0];
+        c[1][j] = ctr[1];
+        c[2][j] = ctr[2];
+        c[3][j] = ctr[3];
+    }
+
+    double u[MC_LANES];
+    for (int j = 0; j < MC_LANES / 4; j++) {
+        for (int w = 0; w < 4; w++) {
+            u[j * 4 + w] = ((double)c[w][j] + 0.5) * (1.0 / 4294967296.0);   // (0, 1)
+        }
+    }
+    for (int b = 0; b < MC_LANES; b += 2) {
+        double r = sqrt(-2.0 * log(u[b]));
+        double a = 6.283185307179586 * u[b + 1];
+        z[b] = r * cos(a);
+        z[b + 1] = r * sin(a);
+    }
+}
+
+// P² ažuriranje za kvantil p
+static void p2_add(P2Quantile* s, double p, double x) {
+    if (s->count < 5) {
+        int i = s->count++;
+        // umetanje u sortirani niz prvih 5 uzoraka
+        while (i > 0 && s->q[i - 1] > x) {
+            s->q[i] = s->q[i - 1];
+            i--;
+        }
+        s->q[i] = x;
+        for (int j = 0; j < 5; j++) s->n[j] = j;
+        return;
+    }
+
+    int k;
+    if (x < s->q[0]) {
+        s->q[0] = x;
+        k = 0;
+    } else if (x >= s->q[4]) {
+        s->q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= s->q[k + 1]) k++;
+    }
+    for (int j = k + 1; j < 5; j++) s->n[j]++;
+    s->count++;
+
+    const double f[5] = { 0.0, p / 2.0, p, (1.0 + p) / 2.0, 1.0 };
+    for (int j = 1; j <= 3; j++) {
+        double d = (double)(s->count - 1) * f[j] - (double)s->n[j];
+        int right = s->n[j + 1] - s->n[j];
+        int left = s->n[j - 1] - s->n[j];
+        if ((d >= 1.0 && right > 1) || (d <= -1.0 && left < -1)) {
+            int ds = (d > 0) ? 1 : -1;
+            // parabolična (P²) procjena, a ako izlazi iz susjednih visina onda linearna
+            double qp = s->q[j] + (double)ds / (double)(s->n[j + 1] - s->n[j - 1]) *
+                ((double)(s->n[j] - s->n[j - 1] + ds) * (s->q[j + 1] - s->q[j]) / (double)(s->n[j + 1] - s->n[j]) +
+                 (double)(s->n[j + 1] - s->n[j] - ds) * (s->q[j] - s->q[j - 1]) / (double)(s->n[j] - s->n[j - 1]));
+            if (s->q[j - 1] < qp && qp < s->q[j + 1]) {
+                s->q[j] = qp;
+            } else {
+                s->q[j] = s->q[j] + (double)ds * (s->q[j + ds] - s->q[j]) / (double)(s->n[j + ds] - s->n[j]);
+            }
+            s->n[j] += ds;
+        }
+    }
+}
+
+static double p2_get(const P2Quantile* s, double p) {
+    if (s->count == 0) return 0.0;
+    if (s->count >= 5) return s->q[2];
+    return s->q[(int)((double)(s->count - 1) * p + 0.5)];   // malo uzoraka: sortirani su
+}
+
+static const double MC_QUANTILES[3] = { 0.05, 0.50, 0.95 };
+static void mc_close(const McPool* pool, McFrame* stk, int* top, int lanes) {
+    McFrame* f = &stk[*top];
+    McFrame* up = &stk[*top - 1];
+    int32_t row = pool->spl_row[f->node];
+    if (row >= 0) {
+        McAcc* acc = pool->acc;
+        for (int b = 0; b < lanes; b++) {
+            acc->spl_any[row] += (f->fail[b] > 0);
+            acc->spl_fail[row] += f->fail[b];
+            if (f->min_margin[b] < 1e300) {
+                for (int q = 0; q < 3; q++) {
+                    p2_add(&acc->spl_q[(size_t)row * 3 + q], MC_QUANTILES[q], f->min_margin[b]);
+                }
+            }
+        }
+    }
+    for (int b = 0; b < MC_LANES; b++) {
+        up->fail[b] += f->fail[b];
+        if (f->min_margin[b] < up->min_margin[b]) up->min_margin[b] = f->min_margin[b];
+    }
+    (*top)--;
+}
+
+// jedan zadatak: za svaki blok od MC_LANES pokusa linearni prolaz podstabla s eksplicitnim stogom
+FTTH_NO_FP_CONTRACT
+static void mc_run_task(const McPool* pool, const McTask* t) {
+    const FlatTopo* ft = pool->ft;
+    McAcc* acc = pool->acc;
+    int stk_cap = 64;
+    McFrame* stk = (McFrame*)xmalloc((size_t)stk_cap * sizeof(McFrame));
+    double z[MC_LANES];
+
+    for (long t0 = 0; t0 < pool->trials; t0 += MC_LANES) {
+        int lanes = (pool->trials - t0 < MC_LANES) ? (int)(pool->trials - t0) : MC_LANES;
+        uint32_t block = (uint32_t)(t0 / MC_LANES);
+
+        // bazni okvir: OLT na vrhu (bez gubitka)
+        int top = 0;
+        stk[0].node = t->root;
+        stk[0].down = 0;
+        stk[0].tx = ft->olt_tx_dbm[t->root_olt];
+        stk[0].rxmin = ft->olt_rxmin_dbm[t->root_olt];
+        for (int b = 0; b < MC_LANES; b++) {
+            stk[0].path[b] = 0.0;
+            stk[0].fail[b] = 0;
+            stk[0].min_margin[b] = 1e308;
+        }
+
+        int32_t k = t->ont_k;
+        int32_t olt_k = t->olt_k;
+        for (int32_t i = t->lo; i < t->hi; i++) {
+            while (top > 0 && ft->end[stk[top].node] <= i) {
+                mc_close(pool, stk, &top, lanes);
+            }
+            if (top + 1 == stk_cap) {
+                stk_cap *= 2;
+                McFrame* ns = (McFrame*)realloc(stk, (size_t)stk_cap * sizeof(McFrame));
+                if (!ns) {
+                    die("Nema slobodne memorije");
+                }
+                stk = ns;
+            }
+            McFrame* p = &stk[top];
+            NodeType type = (NodeType)ft->type[i];
+
+            if (type == NODE_OLT) {
+                McFrame* f = &stk[++top];
+                f->node = i;
+                f->down = p->down;
+                f->tx = ft->olt_tx_dbm[olt_k];
+                f->rxmin = ft->olt_rxmin_dbm[olt_k];
+                olt_k++;
+                for (int b = 0; b < MC_LANES; b++) {
+                    f->path[b] = p->path[b];
+                    f->fail[b] = 0;
+                    f->min_margin[b] = 1e308;
+                }
+                continue;
+            }
+
+            mc_normals(pool->seed, block, (uint32_t)i, z);
+            double mean = pool->mean[i];
+            double sd = pool->sd[i];
+
+            if (type == NODE_ONT) {
+                int down = p->down | ft->ont_faulty[k];
+                int64_t fails = 0;
+                for (int b = 0; b < lanes; b++) {
+                    double loss = p->path[b] + (mean + sd * z[b]);
+                    double rx = p->tx - loss;
+                    double margin = rx - p->rxmin;
+                    int fail = down | (rx < p->rxmin);
+                    fails += fail;
+                    p->fail[b] += fail;
+                    if (margin < p->min_margin[b]) p->min_margin[b] = margin;
+                    for (int q = 0; q < 3; q++) {
+                        p2_add(&acc->ont_q[(size_t)k * 3 + q], MC_QUANTILES[q], margin);
+                    }
+                }
+                acc->ont_fail[k] += fails;
+                k++;
+                continue;
+            }
+
+            McFrame* f = &stk[++top];
+            f->node = i;
+            f->down = p->down | ft->faulty[i];
+            f->tx = p->tx;
+            f->rxmin = p->rxmin;
+            for (int b = 0; b < MC_LANES; b++) {
+                f->path[b] = p->path[b] + (mean + sd * z[b]);
+                f->fail[b] = 0;
+                f->min_margin[b] = 1e308;
+            }
+        }
+        while (top > 0) {
+            mc_close(pool, stk, &top, lanes);
+        }
+    }
+    free(stk);
+}
+
+static void* mc_worker(void* arg) {
+    McPool* pool = (McPool*)arg;
+    for (;;) {
+        int t = atomic_fetch_add(&pool->next, 1);
+        if (t >= pool->task_count) break;
+        mc_run_task(pool, &pool->tasks[t]);
+    }
+    return NULL;
+}
+
+// Monte Carlo: gubitak svakog linka je normalna varijabla sa srednjom vrijednošću iz LossParams i
+// varijancom len²·σa² + conn·σc² + sp·σs² (+ σi² za splitter), jer je zbroj nezavisnih normalnih
+// komponenti opet normalan - po čvoru i pokusu dovoljan je jedan uzorak
+static void run_monte_carlo(const FlatTopo* ft, long trials, uint64_t seed, const LossParams* lp, const McDist* dist, int threads) {
+    size_t n = (size_t)(ft->n > 0 ? ft->n : 1);
+    double* mean = (double*)xmalloc(n * sizeof(double));
+    double* sd = (double*)xmalloc(n * sizeof(double));
+    int32_t ord = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        Node nd;
+        flat_node_load(ft, i, (ft->type[i] == NODE_OLT) ? ord++ : 0, &nd);
+        mean[i] = node_link_loss_db(lp, &nd);
+        double var = nd.len_km * nd.len_km * dist->atten_sd * dist->atten_sd
+            + (double)nd.connectors * dist->conn_sd * dist->conn_sd
+            + (double)nd.splices * dist->splice_sd * dist->splice_sd;
+        if (nd.type == NODE_SPLITTER && nd.splitter_ratio > 1) {
+            var += dist->ins_sd * dist->ins_sd;
+        }
+        sd[i] = sqrt(var);
+    }
+
+    int32_t* spl_row = (int32_t*)xmalloc(n * sizeof(int32_t));
+    int32_t spl_count = flat_splitter_rows(ft, spl_row);
+    size_t m = (size_t)(ft->ont_count > 0 ? ft->ont_count : 1);
+    size_t sc = (size_t)(spl_count > 0 ? spl_count : 1);
+    McAcc acc;
+    acc.ont_fail = (int64_t*)calloc(m, sizeof(int64_t));
+    acc.ont_q = (P2Quantile*)calloc(m * 3, sizeof(P2Quantile));
+    acc.spl_any = (int64_t*)calloc(sc, sizeof(int64_t));
+    acc.spl_fail = (int64_t*)calloc(sc, sizeof(int64_t));
+    acc.spl_q = (P2Quantile*)calloc(sc * 3, sizeof(P2Quantile));
+    if (!acc.ont_fail || !acc.ont_q || !acc.spl_any || !acc.spl_fail || !acc.spl_q) {
+        die("Nema slobodne memorije");
+    }
+    STATS_ALLOC((m + 2 * sc) * sizeof(int64_t) + (m + sc) * 3 * sizeof(P2Quantile));
+
+    // zadaci kao u flat_evaluate_parallel: djeca OLT-a na vrhu
+    McPool pool;
+    pool.ft = ft;
+    pool.mean = mean;
+    pool.sd = sd;
+    pool.spl_row = spl_row;
+    pool.trials = trials;
+    pool.seed = seed;
+    pool.acc = &acc;
+    pool.tasks = (McTask*)xmalloc(n * sizeof(McTask));
+    pool.task_count = 0;
+    atomic_init(&pool.next, 0);
+
+    int32_t onts = 0, olts = 0, root = 0, root_olt = 0;
+    for (int32_t i = 0; i < ft->n; i++) {
+        int32_t p = ft->parent[i];
+        if (p < 0) {
+            root = i;
+            root_olt = olts;
+        } else if (p == root) {
+            McTask* t = &pool.tasks[pool.task_count++];
+            t->lo = i;
+            t->hi = ft->end[i];
+            t->root = root;
+            t->root_olt = root_olt;
+            t->ont_k = onts;
+            t->olt_k = olts;
+        }
+        onts += (ft->type[i] == NODE_ONT);
+        olts += (ft->type[i] == NODE_OLT);
+    }
+
+    if (threads > pool.task_count) threads = pool.task_count > 0 ? pool.task_count : 1;
+    double t0 = now_sec();
+    if (threads <= 1) {
+        mc_worker(&pool);
+    } else {
+        pthread_t* tids = (pthread_t*)xmalloc((size_t)threads * sizeof(pthread_t));
+        for (int i = 0; i < threads; i++) {
+            if (pthread_create(&tids[i], NULL, mc_worker, &pool) != 0) {
+                die("Nije moguce pokrenuti nit");
+            }
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(tids[i], NULL);
+        }
+        free(tids);
+    }
+    double t1 = now_sec();
+
+    // ispis: ONT-ovi u preorderu, splitteri redom kao u splitter_results.csv
+    FILE* f = fopen("mc_ont_results.csv", "w");
+    if (!f) {
+        die("Nemoguce je otvoriti mc_ont_results.csv za pisanje.");
+    }
+    fprintf(f, "ont_id,p_fail,margin_p05_db,margin_p50_db,margin_p95_db,path\n");
+    double expected_fail = 0.0;
+    for (int32_t k = 0; k < ft->ont_count; k++) {
+        char path[512];
+        double pf = (double)acc.ont_fail[k] / (double)trials;
+        expected_fail += pf;
+        flat_path(ft, ft->ont_node[k], path, sizeof(path));
+        fprintf(f, "%d,%.6f,%.4f,%.4f,%.4f,\"%s\"\n", ft->ont_id[ft->ont_node[k]], pf,
+            p2_get(&acc.ont_q[(size_t)k * 3 + 0], MC_QUANTILES[0]),
+            p2_get(&acc.ont_q[(size_t)k * 3 + 1], MC_QUANTILES[1]),
+            p2_get(&acc.ont_q[(size_t)k * 3 + 2], MC_QUANTILES[2]), path);
+    }
+    STATS_FILE("mc_ont_results.csv", ftell(f));
+    fclose(f);
+
+    f = fopen("mc_splitter_results.csv", "w");
+    if (!f) {
+        die("Nemoguce je otvoriti mc_splitter_results.csv za pisanje.");
+    }
+    fprintf(f, "name,ratio,p_any_fail,mean_fail_onts,worst_margin_p05_db,worst_margin_p50_db,worst_margin_p95_db\n");
+    int32_t* by_row = (int32_t*)xmalloc(sc * sizeof(int32_t));
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (spl_row[i] >= 0) by_row[spl_row[i]] = i;
+    }
+    for (int32_t r = 0; r < spl_count; r++) {
+        int32_t i = by_row[r];
+        if (ft->name_len[i] > 0) {
+            fprintf(f, "\"%.*s\",", ft->name_len[i], ft->name[i]);
+        } else {
+            fprintf(f, "\"(unnamed)\",");
+        }
+        fprintf(f, "%d,%.6f,%.4f,%.4f,%.4f,%.4f\n", ft->ratio[i],
+            (double)acc.spl_any[r] / (double)trials, (double)acc.spl_fail[r] / (double)trials,
+            p2_get(&acc.spl_q[(size_t)r * 3 + 0], MC_QUANTILES[0]),
+            p2_get(&acc.spl_q[(size_t)r * 3 + 1], MC_QUANTILES[1]),
+            p2_get(&acc.spl_q[(size_t)r * 3 + 2], MC_QUANTILES[2]));
+    }
+    STATS_FILE("mc_splitter_results.csv", ftell(f));
+    fclose(f);
+
+    double samples = (double)trials * (double)ft->n;
+    printf("Monte Carlo: %ld pokusa, %d ONT, niti: %d, vrijeme: %.3f s (%.1f M uzoraka/s)\n",
+        trials, ft->ont_count, threads, t1 - t0, (t1 - t0) > 0 ? samples / (t1 - t0) / 1e6 : 0.0);
+    printf("Ocekivani broj ONT-ova ispod RXmin: %.2f od %d\n", expected_fail, ft->ont_count);
+    printf("\nStvorene datoteke:\n");
+    printf(" - mc_ont_results.csv\n");
+    printf(" - mc_splitter_results.csv\n");
+
+    free(by_row);
+    free(pool.tasks);
+    free(acc.ont_fail);
+    free(acc.ont_q);
+    free(acc.spl_any);
+    free(acc.spl_fail);
+    free(acc.spl_q);
+    free(spl_row);
+    free(mean);
+    free(sd);
+}
+
+// generiranje csv datoteke za splittere
+static void path_list_push(PathList* pl, const char* s) {
+    if (pl->n == pl->cap) {
+        size_t newcap = pl->cap ? pl->cap * 2 : 16;
+        char** p = (char**)realloc(pl->arr, newcap * sizeof(char*));
+
+        if (!p) {
+            die("Nema slobodne memorije (realloc)");
+        }
+        STATS_ALLOC(newcap * sizeof(char*));
+        pl->arr = p;
+        pl->cap = newcap;
+    }
+    size_t len = strlen(s);
+    char* c = (char*)xmalloc(len + 1);
+    memcpy(c, s, len + 1);
+    pl->arr[pl->n++] = c;
+}
+
+static int path_cmp(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// dodaje datoteku ili sve *.txt datoteke direktorija (sortirano po imenu, da redoslijed shardova
+// ne ovisi o datotečnom sustavu); vraća 1 ako je path direktorij
+static int path_list_add_input(PathList* pl, const char* path) {
+    size_t first = pl->n;
+    char full[4096];
+#ifdef _WIN32
+    DWORD attr = GetFileAttributesA(path);
+    if (attr == INVALID_FILE_ATTRIBUTES || !(attr & FILE_ATTRIBUTE_DIRECTORY)) {
+        path_list_push(pl, path);
+        return 0;
+    }
+    // bez završnih separatora, da "ulaz\" ne daje "ulaz\\a.txt"
+    int dir_len = (int)strlen(path);
+    while (dir_len > 1 && (path[dir_len - 1] == '\\' || path[dir_len - 1] == '/')) dir_len--;
+    snprintf(full, sizeof(full), "%.*s\\*.txt", dir_len, path);
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(full, &fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                snprintf(full, sizeof(full), "%.*s\\%s", dir_len, path, fd.cFileName);
+                path_list_push(pl, full);
+            }
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+#else
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        path_list_push(pl, path);
+        return 0;
+    }
+    DIR* d = opendir(path);
+    if (!d) {
+        die("Nemoguce je otvoriti direktorij topologija");
+    }
+    // bez završnih separatora, da "ulaz/" ne daje "ulaz//a.txt"
+    int dir_len = (int)strlen(path);
+    while (dir_len > 1 && path[dir_len - 1] == '/') dir_len--;
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL) {
+        size_t len = strlen(e->d_name);
+        if (len < 5 || strcmp(e->d_name + len - 4, ".txt") != 0) continue;
+        snprintf(full, sizeof(full), "%.*s/%s", dir_len, path, e->d_name);
+        if (stat(full, &st) == 0 && S_ISREG(st.st_mode)) {
+            path_list_push(pl, full);
+        }
+    }
+    closedir(d);
+#endif
+    qsort(pl->arr + first, pl->n - first, sizeof(char*), path_cmp);
+    return 1;
+}
+
+static void path_list_free(PathList* pl) {
+    for (size_t i = 0; i < pl->n; i++) {
+        free(pl->arr[i]);
+    }
+    free(pl->arr);
+    pl->arr = NULL;
+    pl->n = 0;
+    pl->cap = 0;
+}
+
+// učita, evaluira i oslobodi jedan shard; OLT-ovi na vrhu evaluiraju se kao zasebni rasponi
+// pa svaki dobije svoju statistiku
+static void shard_run(ShardPool* pool, int32_t s) {
+    ShardResult* res = &pool->res[s];
+    Topology topo;
+    FlatTopo ft;
+    flat_load(pool->files->arr[s], &topo, &ft);
+
+    res->node_count = topo.node_count;
+    res->st = stats_init();
+    res->olt_n = 0;
+    int roots = 0;
+    for (int32_t r = 0; r < ft.n; r = ft.end[r]) {
+        roots++;
+    }
+    res->olts = (OltSummary*)xmalloc((size_t)(roots ? roots : 1) * sizeof(OltSummary));
+
+    EvalState es;
+    eval_state_init(&es, &ft);
+    SplitterList splitters;
+    splitter_list_init(&splitters);
+    // shard ne može dati više najgorih od svojih ONT-ova, pa ni hrpa ne treba biti veća
+    TopN top;
+    topn_init(&top, pool->top_cap < ft.ont_count ? pool->top_cap : ft.ont_count);
+    EvalSink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.splitters = &splitters;
+    sink.top = &top;
+
+    int32_t olt_k = 0, ont_k = 0;
+    for (int32_t r = 0; r < ft.n; r = ft.end[r]) {
+        OltSummary* o = &res->olts[res->olt_n++];
+        o->olt = res->olt_n;
+        o->tx_dbm = ft.olt_tx_dbm[olt_k];
+        o->rxmin_dbm = ft.olt_rxmin_dbm[olt_k];
+        o->st = stats_init();
+
+        // splitter zapisi se ovdje ne ispisuju; lista se samo reciklira
+        splitters.n = 0;
+        flat_eval_range(&ft, &es, r, ft.end[r], NULL, "", olt_k, ont_k, &sink, &o->st);
+        stats_merge(&res->st, &o->st);
+
+        for (int32_t i = r; i < ft.end[r]; i++) {
+            if (ft.type[i] == NODE_OLT) olt_k++;
+        }
+        ont_k += o->st.ont_count;
+    }
+
+    topn_sort(&top);
+    res->top_n = top.n;
+    res->top = (ShardTop*)xmalloc((size_t)(top.n ? top.n : 1) * sizeof(ShardTop));
+    for (int i = 0; i < top.n; i++) {
+        res->top[i].r = top.arr[i];
+        res->top[i].shard = s;
+        char path[512];
+        flat_path(&ft, top.arr[i].node, path, sizeof(path));
+        size_t len = strlen(path);
+        res->top[i].path = (char*)xmalloc(len + 1);
+        memcpy(res->top[i].path, path, len + 1);
+    }
+
+    free(top.arr);
+    free(splitters.arr);
+    eval_state_free(&es);
+    flat_free(&ft);
+    unmap_file(&topo.src);
+}
+
+// radna nit: u memoriji je najviše jedan shard po niti
+static void* shard_worker(void* arg) {
+    ShardPool* pool = (ShardPool*)arg;
+    for (;;) {
+        int s = atomic_fetch_add(&pool->next, 1);
+        if (s >= (int)pool->files->n) break;
+        shard_run(pool, s);
+    }
+    return NULL;
+}
+
+// globalni poredak najgorih: margina, pa shard, pa preorder unutar sharda
+static int cmp_shard_top(const void* a, const void* b) {
+    const ShardTop* x = (const ShardTop*)a;
+    const ShardTop* y = (const ShardTop*)b;
+    if (x->r.margin_db < y->r.margin_db) return -1;
+    if (x->r.margin_db > y->r.margin_db) return 1;
+    if (x->shard != y->shard) return (x->shard < y->shard) ? -1 : 1;
+    return (x->r.node > y->r.node) - (x->r.node < y->r.node);
+}
+
+static const char OLT_CSV_HEADER[] = "shard,olt,tx_dbm,rxmin_dbm,ont_count,ok_count,fail_count,down_count,avg_rx_dbm,avg_loss_db,worst_rx_dbm\n";
+
+// redak olt_results.csv; source je datoteka topologije iz koje OLT dolazi
+static void olt_csv_row(FILE* f, const char* source, const OltSummary* o) {
+    double avg_rx = o->st.ont_count ? o->st.sum_rx / o->st.ont_count : 0.0;
+    double avg_loss = o->st.ont_count ? o->st.sum_loss / o->st.ont_count : 0.0;
+    fprintf(f, "\"%s\",%d,%.2f,%.2f,%d,%d,%d,%d,%.4f,%.4f,%.4f\n",
+        source, o->olt, o->tx_dbm, o->rxmin_dbm, o->st.ont_count, o->st.ok_count,
+        o->st.fail_count, o->st.down_count, avg_rx, avg_loss, o->st.ont_count ? o->st.worst_rx : 0.0);
+}
+
+// olt_results.csv za jednu datoteku s više OLT-ova na vrhu (isti format kao kod shardova)
+static void write_olt_csv(const char* filename, const char* source, const OltSummary* olts, int olt_n) {
+    FILE* f = fopen(filename, "w");
+    if (!f) {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Nemoguce je otvoriti %s za pisanje.", filename);
+        die(msg);
+    }
+    fputs(OLT_CSV_HEADER, f);
+    for (int i = 0; i < olt_n; i++) {
+        olt_csv_row(f, source, &olts[i]);
+    }
+    STATS_FILE(filename, ftell(f));
+    fclose(f);
+}
+
+// više datoteka topologije (svaka s jednim ili više OLT-ova): shardovi se obrađuju paralelno,
+// a rezultati se spajaju redom datoteka -> izlaz ne ovisi o broju niti
+static void run_shards(const PathList* files, int threads, int top_n) {
+    int count = (int)files->n;
+    if (count == 0) {
+        die("Nema datoteka topologije");
+    }
+
+    ShardPool pool;
+    pool.files = files;
+    pool.res = (ShardResult*)xmalloc((size_t)count * sizeof(ShardResult));
+    memset(pool.res, 0, (size_t)count * sizeof(ShardResult));
+    pool.top_cap = top_n;
+    atomic_init(&pool.next, 0);
+
+    double t0 = now_sec();
+    if (threads > count) threads = count;
+    pthread_t* tids = (pthread_t*)xmalloc((size_t)threads * sizeof(pthread_t));
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, shard_worker, &pool) != 0) {
+            die("Nemoguce je pokrenuti dretvu");
+        }
+    }
+    shard_worker(&pool);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+    double t1 = now_sec();
+
+    FILE* f = fopen("olt_results.csv", "w");
+    if (!f) {
+        die("Nemoguce je otvoriti olt_results.csv za pisanje.");
+    }
+    fputs(OLT_CSV_HEADER, f);
+
+    SubtreeStats all = stats_init();
+    size_t node_total = 0;
+    int olt_total = 0, top_total = 0;
+    for (int s = 0; s < count; s++) {
+        const ShardResult* res = &pool.res[s];
+        for (int j = 0; j < res->olt_n; j++) {
+            olt_csv_row(f, files->arr[s], &res->olts[j]);
+        }
+        stats_merge(&all, &res->st);
+        node_total += res->node_count;
+        olt_total += res->olt_n;
+        top_total += res->top_n;
+    }
+    STATS_FILE("olt_results.csv", ftell(f));
+    fclose(f);
+
+    // svaki shard je dao svojih N najgorih pa je globalnih N sigurno među njima
+    ShardTop* tops = (ShardTop*)xmalloc((size_t)(top_total ? top_total : 1) * sizeof(ShardTop));
+    int k = 0;
+    for (int s = 0; s < count; s++) {
+        memcpy(tops + k, pool.res[s].top, (size_t)pool.res[s].top_n * sizeof(ShardTop));
+        k += pool.res[s].top_n;
+    }
+    qsort(tops, (size_t)top_total, sizeof(ShardTop), cmp_shard_top);
+
+    printf("Shardova: %d, OLT-ova: %d, cvorova: %zu, niti: %d, vrijeme: %.3f s\n",
+        count, olt_total, node_total, threads, t1 - t0);
+    printf("\n=== SUMMARY ===\n");
+    print_stats(&all);
+
+    int shown = top_total < top_n ? top_total : top_n;
+    printf("\nTOP %d najgorih ONT-ova (po margin):\n", top_n);
+    for (int i = 0; i < shown; i++) {
+        printf(
+            "ONT %d | margin = %.2f dB | RX = %.2f dBm | %s: %s\n",
+            tops[i].r.ont_id,
+            tops[i].r.margin_db,
+            tops[i].r.rx_dbm,
+            files->arr[tops[i].shard],
+            tops[i].path
+        );
+    }
+
+    printf("\nStvorene datoteke:\n");
+    printf(" - olt_results.csv\n");
+
+    for (int s = 0; s < count; s++) {
+        for (int i = 0; i < pool.res[s].top_n; i++) {
+            free(pool.res[s].top[i].path);
+        }
+        free(pool.res[s].olts);
+        free(pool.res[s].top);
+    }
+    free(tops);
+    free(pool.res);
+}
+
+static void write_splitter_csv(const char* filename, const SplitterList* sl) {
+    CsvWriter w;
+    csv_writer_open(&w, filename, 0);
+
+    static const char HEADER[] = "name,ratio,ont_count,ok_count,fail_count,down_count,avg_rx_dbm,avg_loss_db,worst_rx_dbm\n";
+    csv_writer_append(&w, HEADER, sizeof(HEADER) - 1);
+    for (size_t i = 0; i < sl->n; i++) {
+        csv_splitter_row(&w.buf, &sl->arr[i]);
+        csv_writer_maybe_flush(&w);
+    }
+    csv_writer_close(&w);
+}
+
+// jedan redak splitter_results.csv
+static void csv_splitter_row(TextBuf* b, const SplitterRecord* r) {
+    size_t name_len = strlen(r->name);
+    textbuf_reserve(b, name_len + 5 * 16 + 3 * FIXED4_MAX + 8);
+    char* p = b->data + b->len;
+    *p++ = '"';
+    memcpy(p, r->name, name_len);
+    p += name_len;
+    *p++ = '"';
+    *p++ = ','; p = fmt_int(p, r->ratio);
+    *p++ = ','; p = fmt_int(p, r->ont_count);
+    *p++ = ','; p = fmt_int(p, r->ok_count);
+    *p++ = ','; p = fmt_int(p, r->fail_count);
+    *p++ = ','; p = fmt_int(p, r->down_count);
+    *p++ = ','; p = fmt_fixed4(p, r->avg_rx);
+    *p++ = ','; p = fmt_fixed4(p, r->avg_loss);
+    *p++ = ','; p = fmt_fixed4(p, r->worst_rx);
+    *p++ = '\n';
+    b->len = (size_t)(p - b->data);
+}
+
+static void ont_columns_init(OntColumns* c, int32_t n) {
+    size_t m = (size_t)(n > 0 ? n : 1);
+    c->ont_id = (int32_t*)xmalloc(m * sizeof(int32_t));
+    c->dist = (double*)xmalloc(m * sizeof(double));
+    c->loss = (double*)xmalloc(m * sizeof(double));
+    c->rx = (double*)xmalloc(m * sizeof(double));
+    c->margin = (double*)xmalloc(m * sizeof(double));
+    c->status = (uint8_t*)xmalloc(m);
+}
+
+static void ont_columns_free(OntColumns* c) {
+    free(c->ont_id);
+    free(c->dist);
+    free(c->loss);
+    free(c->rx);
+    free(c->margin);
+    free(c->status);
+}
+
+// stupčasta binarna datoteka: zaglavlje, opisi stupaca, pa svaki stupac kao neprekinut niz
+// u izvornom poretku bajtova stroja, poravnat na 64 B; Python ga učitava s numpy.memmap bez parsiranja.
+// dtype oznake se pišu s '<'; na big-endian stroju se zamjenjuju s '>' pa numpy čita ispravno.
+static void write_bin_file(const char* filename, const char* magic, uint64_t rows, int column_count,
+    const char* const* names, const char* const* dtypes, const size_t* widths, const void* const* data) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Nemoguce je otvoriti %s za pisanje.", filename);
+        die(msg);
+    }
+    const uint16_t probe = 1;
+    int big_endian = (*(const uint8_t*)&probe == 0);
+
+    BinHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, sizeof(h.magic));
+    h.version = 1;
+    h.column_count = (uint32_t)column_count;
+    h.row_count = rows;
+    fwrite(&h, sizeof(h), 1, f);
+
+    uint64_t off = sizeof(BinHeader) + (uint64_t)column_count * sizeof(BinColumn);
+    for (int c = 0; c < column_count; c++) {
+        BinColumn col;
+        memset(&col, 0, sizeof(col));
+        strncpy(col.name, names[c], sizeof(col.name) - 1);
+        strncpy(col.dtype, dtypes[c], sizeof(col.dtype) - 1);
+        if (big_endian && col.dtype[0] == '<') {
+            col.dtype[0] = '>';
+        }
+        off = (off + 63) & ~(uint64_t)63;
+        col.offset = off;
+        fwrite(&col, sizeof(col), 1, f);
+        off += rows * widths[c];
+    }
+
+    static const char zeros[64] = {0};
+    uint64_t pos = sizeof(BinHeader) + (uint64_t)column_count * sizeof(BinColumn);
+    for (int c = 0; c < column_count; c++) {
+        uint64_t start = (pos + 63) & ~(uint64_t)63;
+        fwrite(zeros, 1, (size_t)(start - pos), f);
+        size_t bytes = (size_t)rows * widths[c];
+        if (bytes && fwrite(data[c], 1, bytes, f) != bytes) {
+            die("Greska pri pisanju binarne datoteke");
+        }
+        pos = start + bytes;
+    }
+
+    STATS_FILE(filename, pos);
+    if (fclose(f) != 0) {
+        die("Greska pri zatvaranju binarne datoteke");
+    }
+}
+
+// redak svakog splittera u splitter_results (postorder, isti stog kao u flat_eval_range);
+// ostali čvorovi dobivaju -1. Vraća broj splittera.
+static int32_t flat_splitter_rows(const FlatTopo* ft, int32_t* row) {
+    int32_t* stk = (int32_t*)xmalloc((size_t)(ft->n > 0 ? ft->n : 1) * sizeof(int32_t));
+    int top = -1;
+    int32_t next_row = 0;
+    for (int32_t i = 0; i <= ft->n; i++) {
+        while (top >= 0 && (i == ft->n || ft->end[stk[top]] <= i)) {
+            int32_t c = stk[top--];
+            row[c] = (ft->type[c] == NODE_SPLITTER) ? next_row++ : -1;
+        }
+        if (i < ft->n) {
+            if (ft->type[i] == NODE_ONT) {
+                row[i] = -1;
+            } else {
+                stk[++top] = i;
+            }
+        }
+    }
+    free(stk);
+    return next_row;
+}
+
+// ont_results.bin i splitter_results.bin; "splitter"/"parent" je redak najbližeg splittera-pretka
+// u splitter_results (-1 ako ga nema)
+static void write_results_bin(const FlatTopo* ft, const OntColumns* oc, const SplitterList* sl) {
+    int32_t* row = (int32_t*)xmalloc((size_t)(ft->n > 0 ? ft->n : 1) * sizeof(int32_t));
+    if ((size_t)flat_splitter_rows(ft, row) != sl->n) {
+        die("Broj splittera ne odgovara rezultatima");
+    }
+
+    // najbliži splitter-predak (roditelj se u preorderu uvijek obradi prije djeteta)
+    int32_t* up = (int32_t*)xmalloc((size_t)(ft->n > 0 ? ft->n : 1) * sizeof(int32_t));
+    for (int32_t i = 0; i < ft->n; i++) {
+        int32_t p = ft->parent[i];
+        up[i] = (p < 0) ? -1 : (ft->type[p] == NODE_SPLITTER ? row[p] : up[p]);
+    }
+
+    int32_t* ont_splitter = (int32_t*)xmalloc((size_t)(ft->ont_count > 0 ? ft->ont_count : 1) * sizeof(int32_t));
+    for (int32_t k = 0; k < ft->ont_count; k++) {
+        ont_splitter[k] = up[ft->ont_node[k]];
+    }
+
+    static const char* const ont_names[] = { "ont_id", "total_dist_km", "total_loss_db", "rx_dbm", "margin_db", "status", "splitter" };
+    static const char* const ont_dtypes[] = { "<i4", "<f8", "<f8", "<f8", "<f8", "u1", "<i4" };
+    static const size_t ont_widths[] = { 4, 8, 8, 8, 8, 1, 4 };
+    const void* ont_data[] = { oc->ont_id, oc->dist, oc->loss, oc->rx, oc->margin, oc->status, ont_splitter };
+    write_bin_file("ont_results.bin", "FTTHONT1", (uint64_t)ft->ont_count, 7, ont_names, ont_dtypes, ont_widths, ont_data);
+
+    // splitter stupci iz zapisa (ime kao fiksnih 64 bajta)
+    size_t m = sl->n ? sl->n : 1;
+    char* s_name = (char*)xmalloc(m * 64);
+    int32_t* s_int = (int32_t*)xmalloc(m * 6 * sizeof(int32_t));
+    double* s_dbl = (double*)xmalloc(m * 3 * sizeof(double));
+    int32_t* s_ratio = s_int;
+    int32_t* s_ont = s_int + m;
+    int32_t* s_ok = s_int + 2 * m;
+    int32_t* s_fail = s_int + 3 * m;
+    int32_t* s_down = s_int + 4 * m;
+    int32_t* s_parent = s_int + 5 * m;
+    double* s_avg_rx = s_dbl;
+    double* s_avg_loss = s_dbl + m;
+    double* s_worst_rx = s_dbl + 2 * m;
+
+    for (size_t j = 0; j < sl->n; j++) {
+        const SplitterRecord* r = &sl->arr[j];
+        memcpy(s_name + j * 64, r->name, 64);
+        s_ratio[j] = r->ratio;
+        s_ont[j] = r->ont_count;
+        s_ok[j] = r->ok_count;
+        s_fail[j] = r->fail_count;
+        s_down[j] = r->down_count;
+        s_avg_rx[j] = r->avg_rx;
+        s_avg_loss[j] = r->avg_loss;
+        s_worst_rx[j] = r->worst_rx;
+    }
+    for (int32_t i = 0; i < ft->n; i++) {
+        if (ft->type[i] == NODE_SPLITTER) {
+            s_parent[row[i]] = up[i];
+        }
+    }
+
+    static const char* const spl_names[] = { "name", "ratio", "ont_count", "ok_count", "fail_count", "down_count",
+        "avg_rx_dbm", "avg_loss_db", "worst_rx_dbm", "parent" };
+    static const char* const spl_dtypes[] = { "S64", "<i4", "<i4", "<i4", "<i4", "<i4", "<f8", "<f8", "<f8", "<i4" };
+    static const size_t spl_widths[] = { 64, 4, 4, 4, 4, 4, 8, 8, 8, 4 };
+    const void* spl_data[] = { s_name, s_ratio, s_ont, s_ok, s_fail, s_down, s_avg_rx, s_avg_loss, s_worst_rx, s_parent };
+    write_bin_file("splitter_results.bin", "FTTHSPL1", (uint64_t)sl->n, 10, spl_names, spl_dtypes, spl_widths, spl_data);
+
+    free(s_name);
+    free(s_int);
+    free(s_dbl);
+    free(ont_splitter);
+    free(up);
+    free(row);
+}
+
+// nizovi FlatTopo u snapshotu: (polje, broj elemenata); n/m/o = čvorovi/ONT-ovi/OLT-ovi,
+// os/ss = slotovi indeksa. Imena se spremaju zasebno (name_off + tablica imena).
+#define SNAP_ARRAYS(X) \
+    X(type, n) X(faulty, n) X(parent, n) X(end, n) X(link_loss, n) X(len_km, n) X(conn, n) \
+    X(splices, n) X(extra, n) X(ont_id, n) X(ratio, n) X(name_len, n) \
+    X(ont_node, m) X(ont_parent, m) X(ont_len, m) X(ont_conn, m) X(ont_sp, m) X(ont_extra, m) \
+    X(ont_faulty, m) X(olt_tx_dbm, o) X(olt_rxmin_dbm, o) X(ont_slot, os) X(spl_slot, ss)
+#define SNAP_COUNT_ONE(f, cnt) + 1
+#define SNAP_ARRAY_COUNT (0 SNAP_ARRAYS(SNAP_COUNT_ONE) + 2)   // + name_off i tablica imena
+#define SNAP_VERSION 2
+
+// 64-bitni hash po riječima (8 B po množenju): provjera cijelog snapshota u djeliću učitavanja.
+// h je stanje prethodnog dijela; dijelovi duljine djeljive s 8 daju isto kao jedan poziv
+static uint64_t snap_checksum(uint64_t h, const uint8_t* p, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001B3ull;
+        h ^= h >> 29;
+    }
+    for (; i < len; i++) {
+        h = (h ^ p[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+// checksum cijele datoteke (len >= sizeof(SnapHeader)); zaglavlje se računa s checksum = 0
+static uint64_t snap_file_checksum(const uint8_t* base, size_t len) {
+    SnapHeader h;
+    memcpy(&h, base, sizeof(h));
+    h.checksum = 0;
+    uint64_t sum = snap_checksum(0x9E3779B97F4A7C15ull ^ (uint64_t)len, (const uint8_t*)&h, sizeof(h));
+    return snap_checksum(sum, base + sizeof(h), len - sizeof(h));
+}
+
+// sprema kompilirano stablo (s indeksima) tako da se učitava samo mapiranjem datoteke
+static void write_snapshot(const char* filename, const FlatTopo* ft) {
+    size_t n = (size_t)ft->n, m = (size_t)ft->ont_count, o = (size_t)ft->olt_count;
+    size_t os = (size_t)ft->ont_mask + 1, ss = (size_t)ft->spl_mask + 1;
+
+    // tablica imena: svako različito ime jednom, name_off[i] = pomak u tablici (-1 bez imena)
+    int32_t* name_off = (int32_t*)xmalloc((n ? n : 1) * sizeof(int32_t));
+    uint32_t cap = index_cap(ft->n);
+    int32_t* slot = (int32_t*)xmalloc(cap * sizeof(int32_t));
+    memset(slot, 0xFF, cap * sizeof(int32_t));
+    TextBuf names = { NULL, 0, 0 };
+    for (size_t i = 0; i < n; i++) {
+        name_off[i] = -1;
+        int32_t len = ft->name_len[i];
+        if (len <= 0) continue;
+        uint32_t h = hash_name(ft->name[i], len) & (cap - 1);
+        for (; slot[h] >= 0; h = (h + 1) & (cap - 1)) {
+            int32_t j = slot[h];
+            if (ft->name_len[j] == len && memcmp(ft->name[j], ft->name[i], (size_t)len) == 0) break;
+        }
+        if (slot[h] >= 0) {
+            name_off[i] = name_off[slot[h]];
+        } else {
+            slot[h] = (int32_t)i;
+            name_off[i] = (int32_t)names.len;
+            textbuf_append(&names, ft->name[i], (size_t)len);
+        }
+    }
+    free(slot);
+
+    const void* src[SNAP_ARRAY_COUNT];
+    size_t bytes[SNAP_ARRAY_COUNT];
+    int k = 0;
+#define SNAP_SRC(f, cnt) src[k] = ft->f; bytes[k] = (cnt) * sizeof(*ft->f); k++;
+    SNAP_ARRAYS(SNAP_SRC)
+#undef SNAP_SRC
+    src[k] = name_off;
+    bytes[k] = n * sizeof(int32_t);
+    k++;
+    src[k] = names.data;
+    bytes[k] = names.len;
+    k++;
+
+    uint64_t offset[SNAP_ARRAY_COUNT];
+    uint64_t pos = sizeof(SnapHeader) + sizeof(offset);
+    for (int a = 0; a < SNAP_ARRAY_COUNT; a++) {
+        pos = (pos + 63) & ~(uint64_t)63;
+        offset[a] = pos;
+        pos += bytes[a];
+    }
+    size_t total = (size_t)((pos + 63) & ~(uint64_t)63);
+
+    uint8_t* buf = (uint8_t*)xmalloc(total);
+    memset(buf, 0, total);
+    memcpy(buf + sizeof(SnapHeader), offset, sizeof(offset));
+    for (int a = 0; a < SNAP_ARRAY_COUNT; a++) {
+        if (bytes[a]) memcpy(buf + offset[a], src[a], bytes[a]);
+    }
+
+    SnapHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "FTTHSNAP", 8);
+    h.version = SNAP_VERSION;
+    h.endian = 0x01020304u;
+    h.file_size = total;
+    h.n = ft->n;
+    h.ont_count = ft->ont_count;
+    h.olt_count = ft->olt_count;
+    h.array_count = SNAP_ARRAY_COUNT;
+    h.ont_mask = ft->ont_mask;
+    h.spl_mask = ft->spl_mask;
+    h.name_bytes = names.len;
+    memcpy(buf, &h, sizeof(h));
+    h.checksum = snap_file_checksum(buf, total);
+    memcpy(buf, &h, sizeof(h));
+
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        die("Nemoguce je stvoriti datoteku snapshota");
+    }
+    if (fwrite(buf, 1, total, f) != total || fclose(f) != 0) {
+        die("Greska pri pisanju snapshota");
+    }
+    STATS_FILE(filename, total);
+    printf("Snapshot %s: %d cvorova, %d ONT-ova, %.1f MB\n", filename, ft->n, ft->ont_count, (double)total / 1e6);
+
+    free(buf);
+    free(names.data);
+    free(name_off);
+}
+
+static int snapshot_is(const char* filename) {
+    char magic[8];
+#ifndef _WIN32
+    // iz cijevi se ne smije ništa pročitati unaprijed (snapshot je uvijek obična datoteka)
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+#endif
+    FILE* f = fopen(filename, "rb");
+    if (!f) return 0;
+    size_t got = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    return got == sizeof(magic) && memcmp(magic, "FTTHSNAP", 8) == 0;
+}
+
+// mapira snapshot i postavlja nizove FlatTopo izravno u mapiranje (bez parsiranja i alokacije
+// po čvoru); alocira se samo niz pokazivača na imena
+static void snapshot_load(const char* filename, Topology* topo, FlatTopo* ft) {
+    topo->root = NULL;
+    topo->line_count = 0;
+    arena_init(&topo->arena);
+    map_file_ex(filename, &topo->src, 1);
+
+    const uint8_t* base = (const uint8_t*)topo->src.data;
+    size_t len = topo->src.len;
+    SnapHeader h;
+    uint64_t offset[SNAP_ARRAY_COUNT];
+    if (len < sizeof(h) + sizeof(offset)) {
+        die("Snapshot je prekratak");
+    }
+    memcpy(&h, base, sizeof(h));
+    if (memcmp(h.magic, "FTTHSNAP", 8) != 0 || h.endian != 0x01020304u) {
+        die("Datoteka nije snapshot ovog racunala");
+    }
+    if (h.version != SNAP_VERSION || h.array_count != SNAP_ARRAY_COUNT) {
+        die("Nepodrzana verzija snapshota");
+    }
+    if (h.file_size != len || snap_file_checksum(base, len) != h.checksum) {
+        die("Snapshot je ostecen (checksum)");
+    }
+    memcpy(offset, base + sizeof(h), sizeof(offset));
+    if (h.n < 0 || h.ont_count < 0 || h.olt_count < 0) {
+        die("Snapshot je ostecen (zaglavlje)");
+    }
+
+    memset(ft, 0, sizeof(*ft));
+    ft->n = h.n;
+    ft->ont_count = h.ont_count;
+    ft->olt_count = h.olt_count;
+    ft->ont_mask = h.ont_mask;
+    ft->spl_mask = h.spl_mask;
+    ft->mapped = 1;
+    size_t n = (size_t)h.n, m = (size_t)h.ont_count, o = (size_t)h.olt_count;
+    size_t os = (size_t)h.ont_mask + 1, ss = (size_t)h.spl_mask + 1;
+
+    int k = 0;
+#define SNAP_DST(f, cnt) \
+    if (offset[k] % 64 != 0 || offset[k] + (cnt) * sizeof(*ft->f) > len) die("Snapshot je ostecen (nizovi)"); \
+    ft->f = (void*)(base + offset[k]); k++;
+    SNAP_ARRAYS(SNAP_DST)
+#undef SNAP_DST
+    const int32_t* name_off = (const int32_t*)(base + offset[k]);
+    const char* names = (const char*)(base + offset[k + 1]);
+    if (offset[k] + n * sizeof(int32_t) > len || offset[k + 1] + h.name_bytes > len) {
+        die("Snapshot je ostecen (imena)");
+    }
+
+    // checksum ne štiti od datoteke koju je netko drugi sastavio: end/parent/imena se koriste
+    // kao indeksi bez provjere pa se ovdje provjeravaju jednom
+    for (size_t i = 0; i < n; i++) {
+        int32_t e = ft->end[i], p = ft->parent[i];
+        if (e <= (int32_t)i || e > h.n || p < -1 || p >= (int32_t)i || (p >= 0 && ft->end[p] < e)) {
+            die("Snapshot je ostecen (struktura stabla)");
+        }
+        if (ft->name_len[i] < 0 || (name_off[i] < 0 && ft->name_len[i] > 0) ||
+            (name_off[i] >= 0 && (uint64_t)name_off[i] + (uint64_t)ft->name_len[i] > h.name_bytes)) {
+            die("Snapshot je ostecen (imena)");
+        }
+    }
+
+    // vrsta čvora bira nizove po rednom broju OLT-a/ONT-a, a ONT stupci i indeksi sadrže
+    // indekse čvorova: k-ti ONT stupac mora biti k-ti ONT u preorderu, a slot -1 ili čvor
+    int32_t olts = 0, onts = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (ft->type[i] > NODE_ONT || (ft->parent[i] < 0 && ft->type[i] != NODE_OLT)) {
+            die("Snapshot je ostecen (vrste cvorova)");
+        }
+        if (ft->type[i] == NODE_OLT) {
+            olts++;
+        } else if (ft->type[i] == NODE_ONT) {
+            if (onts >= h.ont_count || ft->ont_node[onts] != (int32_t)i || ft->ont_parent[onts] != ft->parent[i] ||
+                ft->end[i] != (int32_t)i + 1) {
+                die("Snapshot je ostecen (ONT stupci)");
+            }
+            onts++;
+        }
+    }
+    if (olts != h.olt_count || onts != h.ont_count) {
+        die("Snapshot je ostecen (broj OLT/ONT cvorova)");
+    }
+    // bez praznog slota traženje nepostojećeg ključa ne bi završilo
+    int ont_empty = 0, spl_empty = 0;
+    for (size_t i = 0; i < os; i++) {
+        if (ft->ont_slot[i] < -1 || ft->ont_slot[i] >= h.n) die("Snapshot je ostecen (indeksi)");
+        ont_empty |= (ft->ont_slot[i] < 0);
+    }
+    for (size_t i = 0; i < ss; i++) {
+        if (ft->spl_slot[i] < -1 || ft->spl_slot[i] >= h.n) die("Snapshot je ostecen (indeksi)");
+        spl_empty |= (ft->spl_slot[i] < 0);
+    }
+    if (!ont_empty || !spl_empty) {
+        die("Snapshot je ostecen (indeksi)");
+    }
+
+    ft->name = (const char**)xmalloc((n ? n : 1) * sizeof(const char*));
+    for (size_t i = 0; i < n; i++) {
+        ft->name[i] = (name_off[i] >= 0) ? names + name_off[i] : NULL;
+    }
+    topo->node_count = n;
+}
+
+// K najgorih ONT-ova po splitteru (redoslijed splittera isti kao u splitter_results.csv)
+static void write_splitter_worst_csv(const char* filename, const SplitterWorstList* wl, const FlatTopo* ft) {
+    FILE* f = fopen(filename, "w");
+    if (!f) {
+        die("Nemoguce je otvoriti splitter_worst.csv za pisanje.");
+    }
+
+    fprintf(f, "splitter,ratio,rank,ont_id,margin_db,rx_dbm,path\n");
+    for (size_t i = 0; i < wl->n; i++) {
+        const SplitterWorst* w = &wl->arr[i];
+        char path[512];
+        flat_path(ft, w->r.node, path, sizeof(path));
+        if (ft->name_len[w->splitter] > 0) {
+            fprintf(f, "\"%.*s\",", ft->name_len[w->splitter], ft->name[w->splitter]);
+        } else {
+            fprintf(f, "\"(unnamed)\",");
+        }
+        fprintf(f, "%d,%d,%d,%.4f,%.4f,\"%s\"\n",
+            ft->ratio[w->splitter], w->rank, w->r.ont_id, w->r.margin_db, w->r.rx_dbm, path);
+    }
+    STATS_FILE(filename, ftell(f));
+    fclose(f);
+}
+
+// ispis na konzolu; uz više OLT-ova na vrhu po jedan redak za svaki
+static void print_summary(const SubtreeStats* all, const OltSummary* olts, int olt_n) {
+    printf("\n=== SUMMARY ===\n");
+    if (olt_n == 1) {
+        printf("OLT TX: %.2f dBm | GPON RXmin: %.2f dBm\n", olts[0].tx_dbm, olts[0].rxmin_dbm);
+    }
+    for (int i = 0; olt_n > 1 && i < olt_n; i++) {
+        const OltSummary* o = &olts[i];
+        printf("OLT#%d TX: %.2f dBm | GPON RXmin: %.2f dBm | ONT: %d OK: %d FAIL: %d DOWN: %d\n",
+            o->olt, o->tx_dbm, o->rxmin_dbm, o->st.ont_count, o->st.ok_count, o->st.fail_count, o->st.down_count);
+    }
+    print_stats(all);
+}
+
+static void print_stats(const SubtreeStats* all) {
+    printf("ONT total: %d\n", all->ont_count);
+    printf("OK:   %d\n", all->ok_count);
+    printf("FAIL: %d\n", all->fail_count);
+    printf("DOWN: %d\n", all->down_count);
+
+    if (all->ont_count > 0) {
+        printf("AVG RX:   %.2f dBm\n", all->sum_rx / all->ont_count);
+        printf("AVG LOSS: %.2f dB\n", all->sum_loss / all->ont_count);
+        printf("BEST RX:  %.2f dBm\n", all->best_rx);
+        printf("WORST RX: %.2f dBm\n", all->worst_rx);
+        printf("Note: Margin = RX - RXmin; PASS if RX >= RXmin and not DOWN.\n");
+    }
+}
+
+// sortiranje ONT-ova uzlazno po optičkoj margini (kod jednake margine ranije u preorderu ide prvi)
+int cmp_margin(const void* a, const void* b) {
+    OntResult* x = (OntResult*)a;
+    OntResult* y = (OntResult*)b;
+
+    if (x->margin_db < y->margin_db) return -1;
+    if (x->margin_db > y->margin_db) return 1;
+    if (x->node < y->node) return -1;
+    if (x->node > y->node) return 1;
+    return 0;
+}
+
+// parsira linije [begin, end) u stablo u areni komada. continues = komad nastavlja raniji dio
+// datoteke pa linije dubine 1 prije prvog OLT-a idu pod zamjenski head. ONT-ovi bez id-a se
+// samo pamte; id dobivaju nakon svih komada (parse_assign_ont_ids).
+static void parse_chunk(ParseChunk* c, int continues) {
+    int stack_cap = 64;
+    Node** stack = (Node**)xmalloc((size_t)stack_cap * sizeof(Node*));  //stack[depth] = zadnji cvor na depth
+    int max_depth = -1;
+    node_defaults(&c->head, NODE_OLT);
+    if (continues) {
+        stack[0] = &c->head;
+        max_depth = 0;
+    }
+
+    const char* p = c->begin;
+    const char* end = c->end;
+
+    while (p < end) {
+        const char* line = p;
+        const char* eol = (const char*)memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        p = (eol < end) ? eol + 1 : end;
+        c->line_count++;
+
+        const char *s, *le;
+        int depth = topo_line(line, eol, &s, &le);
+        if (depth < 0) continue;
+
+        Node* n = node_new(&c->arena, NODE_ONT); // vrstu postavlja parse_line
+        parse_line(n, s, le);
+        c->node_count++;
+
+        if (n->type == NODE_ONT && n->ont_id < 0) {
+            if (c->auto_n == c->auto_cap) {
+                c->auto_cap = c->auto_cap ? c->auto_cap * 2 : 1024;
+                Node** a = (Node**)realloc(c->auto_ont, c->auto_cap * sizeof(Node*));
+                if (!a) {
+                    die("Nema slobodne memorije");
+                }
+                c->auto_ont = a;
+            }
+            c->auto_ont[c->auto_n++] = n;
+        }
+
+        if (depth == 0) {
+            // OLT mora biti na samom vrhu
+            if (n->type != NODE_OLT) {
+                die("Najgornji cvor mora biti OLT!");
+            }
+            if (c->last_root) {
+                c->last_root->sibling = n;
+            } else {
+                c->root = n;
+            }
+            c->last_root = n;
+            stack[0] = n;
+        } else {
+            Node* parent = (depth - 1 <= max_depth) ? stack[depth - 1] : NULL;
+            if (!parent) {
+                die("Kriva identacija / Fali roditelj");
+            }
+            node_add_child(parent, n);
+            if (depth == stack_cap) {
+                stack_cap *= 2;
+                Node** ns = (Node**)realloc(stack, (size_t)stack_cap * sizeof(Node*));
+                if (!ns) {
+                    die("Nema slobodne memorije");
+                }
+                stack = ns;
+            }
+            stack[depth] = n;
+        }
+
+        // dublji čvorovi iz stacka više nisu roditelji
+        max_depth = depth;
+    }
+    free(stack);
+}
+
+// ONT-ovi bez id-a redom (kao u datoteci) dobivaju id 1, 2, ...; sudar sa zadanim id-om
+// prijavljuje flat_index_build kao duplikat. Oslobađa popise komada.
+static void parse_assign_ont_ids(ParseChunk* chunks, int count) {
+    int32_t next = 1;
+    for (int k = 0; k < count; k++) {
+        ParseChunk* c = &chunks[k];
+        for (size_t j = 0; j < c->auto_n; j++) {
+            c->auto_ont[j]->ont_id = next++;
+        }
+        free(c->auto_ont);
+        c->auto_ont = NULL;
+    }
+}
+
+// čitanje datoteke topologije: datoteka se mapira i parsira na mjestu, bez fgets/kopiranja linija
+static void read_topology(const char* filename, Topology* topo) {
+    map_file(filename, &topo->src);
+    parse_topology(topo);
+}
+
+// parsira već učitani topo->src
+static void parse_topology(Topology* topo) {
+    ParseChunk c;
+    memset(&c, 0, sizeof(c));
+    c.begin = topo->src.data;
+    c.end = c.begin ? c.begin + topo->src.len : NULL;
+    parse_chunk(&c, 0);
+    parse_assign_ont_ids(&c, 1);
+
+    topo->root = c.root;
+    topo->arena = c.arena;
+    topo->line_count = c.line_count;
+    topo->node_count = c.node_count;
+
+    if (!topo->root) {
+        die("Nema OLT cvora u ftth_topology.txt");
+    }
+}
+
+// prvi početak linije od p nadalje s uvlakom 0 ili 2 (OLT ili splitter ispod OLT-a): tu se
+// datoteka smije prerezati jer linija ne ovisi o dubljem stogu prethodnog komada
+static const char* parse_split_point(const char* p, const char* end) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    p = nl ? nl + 1 : end;
+    while (p < end) {
+        int spaces = 0;
+        while (spaces < 3 && p + spaces < end && p[spaces] == ' ') spaces++;
+        if ((spaces == 0 || spaces == 2) && p + spaces < end && !is_space(p[spaces]) && p[spaces] != '#') {
+            return p;
+        }
+        nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+        p = nl ? nl + 1 : end;
+    }
+    return end;
+}
+
+static void* parse_worker(void* arg) {
+    ParsePool* pool = (ParsePool*)arg;
+    for (;;) {
+        int k = atomic_fetch_add(&pool->next, 1);
+        if (k >= pool->count) break;
+        parse_chunk(&pool->chunks[k], k > 0);
+    }
+    return NULL;
+}
+
+// paralelno čitanje: datoteka se reže na granicama OLT / splittera prve razine, komadi se parsiraju
+// u zasebne arene, a zatim se redom spajaju (djeca s početka komada nastavljaju listu djece zadnjeg
+// OLT-a) i ONT-ovima bez id-a se dodjeljuju brojevi kao u slijednom čitanju. Stablo je isto.
+static void read_topology_parallel(const char* filename, Topology* topo, int threads) {
+    map_file(filename, &topo->src);
+    const char* data = topo->src.data;
+    size_t len = topo->src.len;
+
+    // nekoliko komada po niti (ujednačavanje), ali ne manjih od PARSE_CHUNK_MIN
+    size_t want = (size_t)threads * 4;
+    if (want > len / PARSE_CHUNK_MIN) want = len / PARSE_CHUNK_MIN;
+    if (threads < 2 || want < 2) {
+        parse_topology(topo);
+        return;
+    }
+
+    ParsePool pool;
+    pool.chunks = (ParseChunk*)xmalloc(want * sizeof(ParseChunk));
+    memset(pool.chunks, 0, want * sizeof(ParseChunk));
+    pool.count = 0;
+    atomic_init(&pool.next, 0);
+    const char* start = data;
+    for (size_t k = 1; k <= want; k++) {
+        const char* cut = (k == want) ? data + len : parse_split_point(data + len / want * k, data + len);
+        if (cut <= start) continue;
+        pool.chunks[pool.count].begin = start;
+        pool.chunks[pool.count].end = cut;
+        pool.count++;
+        start = cut;
+    }
+
+    if (threads > pool.count) threads = pool.count;
+    pthread_t* tids = (pthread_t*)xmalloc((size_t)threads * sizeof(pthread_t));
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, parse_worker, &pool) != 0) {
+            die("Nemoguce je pokrenuti dretvu");
+        }
+    }
+    parse_worker(&pool);
+    for (int i = 1; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    topo->root = NULL;
+    topo->line_count = 0;
+    topo->node_count = 0;
+    arena_init(&topo->arena);
+    Node* last_root = NULL;
+    parse_assign_ont_ids(pool.chunks, pool.count);
+    for (int k = 0; k < pool.count; k++) {
+        ParseChunk* c = &pool.chunks[k];
+        if (c->head.child) {
+            if (!last_root) {
+                die("Kriva identacija / Fali roditelj");
+            }
+            if (last_root->child) {
+                last_root->last_child->sibling = c->head.child;
+            } else {
+                last_root->child = c->head.child;
+            }
+            last_root->last_child = c->head.last_child;
+        }
+        if (c->root) {
+            if (last_root) {
+                last_root->sibling = c->root;
+            } else {
+                topo->root = c->root;
+            }
+            last_root = c->last_root;
+        }
+        topo->line_count += c->line_count;
+        topo->node_count += c->node_count;
+        arena_append(&topo->arena, &c->arena);
+    }
+    free(pool.chunks);
+
+    if (!topo->root) {
+        die("Nema OLT cvora u ftth_topology.txt");
+    }
+}
+
+static void topology_free(Topology* topo) {
+    arena_release(&topo->arena);
+    topo->root = NULL;
+    unmap_file(&topo->src);
+}
+
+// referentni parser (za --bench-parse): izvorno čitanje prije mapiranja, bez izmjena -
+// ltrim/rtrim, strtok_r, strcmp po ključu i strtod, calloc po čvoru i dijete na kraj liste braće
+static RefNode* ref_node_new(NodeType t) {
+    RefNode* n = (RefNode*)calloc(1, sizeof(RefNode));
+    if (!n) {
+        die("Nema slobodne memorije");
+    }
+    n->type = t;
+    n->splitter_ratio = 0;
+    n->ont_id = -1;
+    n->olt_tx_dbm = 3.0;
+    n->gpon_rxmin_dbm = -27.0;
+    n->faulty = 0;
+    n->extra_loss_db = 0.0;
+    n->name[0] = '\0';
+    return n;
+}
+
+static void ref_node_add_child(RefNode* parent, RefNode* child) {
+    if (!parent->child) {
+        parent->child = child;
+        return;
+    }
+    RefNode* cur = parent->child;
+    while (cur->sibling) {
+        cur = cur->sibling;
+    }
+    cur->sibling = child;
+}
+
+// brisanje razmaka s lijeve strane stringa
+static char* ref_ltrim(char* s) {
+    while (*s && isspace((unsigned char)*s)) {
+        s++;
+    }
+    return s;
+}
+
+// brisanje razmaka s desne strane stringa
+static void ref_rtrim(char* s) {
+    size_t n = strlen(s);
+    while (n && isspace((unsigned char)s[n - 1])) {
+        s[--n] = '\0';
+    }
+}
+
+// broji razmake (određuje dubinu stabla)
+static int ref_leading_spaces(const char* s) {
+    int c = 0;
+    while (*s == ' ') {
+        c++;
+        s++;
+    }
+    return c;
+}
+
+static NodeType ref_parse_type(const char* tok) {
+    if (strcmp(tok, "OLT") == 0) {
+        return NODE_OLT;
+    }
+    if (strcmp(tok, "SPLITTER") == 0) {
+        return NODE_SPLITTER;
+    }
+    if (strcmp(tok, "ONT") == 0) {
+        return NODE_ONT;
+    }
+    die("Nepoznati node type (ocekivani su OLT/SPLITTER/ONT)");
+    return NODE_ONT;
+}
+
+// key=value
+static void ref_apply_kv(RefNode* n, const char* key, const char* val) {
+    if (strcmp(key, "len") == 0) {
+        n->len_km = strtod(val, NULL);
+    } else if (strcmp(key, "km") == 0) {
+        n->len_km = strtod(val, NULL);
+    } else if (strcmp(key, "conn") == 0) {
+        n->connectors = (int)strtol(val, NULL, 10);
+    } else if (strcmp(key, "sp") == 0) {
+        n->splices = (int)strtol(val, NULL, 10);
+    } else if (strcmp(key, "ratio") == 0) {
+        n->splitter_ratio = (int)strtol(val, NULL, 10);
+    } else if (strcmp(key, "name") == 0) {
+        strncpy(n->name, val, sizeof(n->name) - 1);
+        n->name[sizeof(n->name) - 1] = '\0';
+    } else if (strcmp(key, "id") == 0) {
+        n->ont_id = (int)strtol(val, NULL, 10);
+    } else if (strcmp(key, "tx") == 0) {
+        n->olt_tx_dbm = strtod(val, NULL);
+    } else if (strcmp(key, "rxmin") == 0) {
+        n->gpon_rxmin_dbm = strtod(val, NULL);
+    } else if (strcmp(key, "faulty") == 0) {
+        n->faulty = strtol(val, NULL, 10) ? 1 : 0;
+    } else if (strcmp(key, "extra") == 0) {
+        n->extra_loss_db = strtod(val, NULL);
+    }
+    // nepoznati "key" su ignorirani
+}
+
+// parsira 1 liniju topologije
+static void ref_parse_line(RefNode* n, char* line_no_indent) {
+    // Tokenizira po razmaku: TYPE key=val key=val ...
+    char* save = NULL;
+    char* tok = strtok_r(line_no_indent, " \t", &save);
+    if (!tok) {
+        die("Prazna linija topologije");
+    }
+    n->type = ref_parse_type(tok);
+
+    while ((tok = strtok_r(NULL, " \t", &save)) != NULL) {
+        char* eq = strchr(tok, '=');
+        if (!eq) continue; // ignorira neispravne tokene
+        *eq = '\0';
+
+        const char* key = tok;
+        const char* val = eq + 1;
+        ref_apply_kv(n, key, val);
+    }
+}
+
+// referentno čitanje kao prije mapiranja (za --bench-parse). Stog predaka raste s dubinom (kao
+// u parse_chunk), a preskočena razina uvlake je greška kao u izvornom čitanju. Vraća broj čvorova.
+static size_t read_topology_stdio(const char* filename, size_t* line_count) {
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        die("Nemoguce je otvoriti datoteku ftth_topology.txt");
+    }
+    RefNode** nodes = NULL;     // svi čvorovi, za oslobađanje bez rekurzije
+    size_t node_n = 0, node_cap = 0;
+    int stack_cap = 64;
+    RefNode** stack = (RefNode**)xmalloc((size_t)stack_cap * sizeof(RefNode*));  //stack[depth] = zadnji cvor na depth
+    int max_depth = -1;
+
+    char line[1024];
+    size_t lines = 0;
+    int auto_ont_id = 1;
+
+    while (fgets(line, sizeof(line), f)) {
+        lines++;
+        ref_rtrim(line);
+        char* p = ref_ltrim(line);
+
+        if (*p == '\0') continue;
+        if (*p == '#') continue;
+
+        int spaces = ref_leading_spaces(line);
+        if (spaces % 2 != 0) {
+            die("Uvlaka mora biti paran broj razmaka");
+        }
+
+        int depth = spaces / 2;
+        char tmp[1024];
+        strncpy(tmp, p, sizeof(tmp) - 1);
+        tmp[sizeof(tmp) - 1] = '\0';
+
+        RefNode* n = ref_node_new(NODE_ONT); // vrstu postavlja parse_line
+        ref_parse_line(n, tmp);
+        if (node_n == node_cap) {
+            node_cap = node_cap ? node_cap * 2 : 1024;
+            RefNode** nn = (RefNode**)realloc(nodes, node_cap * sizeof(RefNode*));
+            if (!nn) {
+                die("Nema slobodne memorije");
+            }
+            nodes = nn;
+        }
+        nodes[node_n++] = n;
+
+        if (n->type == NODE_ONT) {
+            if (n->ont_id < 0) {
+                n->ont_id = auto_ont_id++;
+            }
+        }
+
+        if (depth == 0) {
+            // OLT mora biti na samom vrhu
+            if (n->type != NODE_OLT) {
+                die("Najgornji cvor mora biti OLT!");
+            }
+        } else {
+            RefNode* parent = (depth - 1 <= max_depth) ? stack[depth - 1] : NULL;
+            if (!parent) {
+                die("Kriva identacija / Fali roditelj");
+            }
+            ref_node_add_child(parent, n);
+        }
+        if (depth == stack_cap) {
+            stack_cap *= 2;
+            RefNode** ns = (RefNode**)realloc(stack, (size_t)stack_cap * sizeof(RefNode*));
+            if (!ns) {
+                die("Nema slobodne memorije");
+            }
+            stack = ns;
+        }
+        stack[depth] = n;
+        max_depth = depth;
+    }
+    fclose(f);
+
+    for (size_t i = 0; i < node_n; i++) {
+        free(nodes[i]);
+    }
+    free(nodes);
+    free(stack);
+    *line_count = lines;
+    return node_n;
+}
+
+// mjeri brzinu učitavanja topologije (linija/s) prema referentnom fgets/malloc čitanju; uz
+// --threads N i paralelno čitanje, uz provjeru da daje isto stablo
+static void bench_parse(const char* filename, int threads) {
+    size_t ref_lines = 0;
+    double r0 = now_sec();
+    size_t ref_nodes = read_topology_stdio(filename, &ref_lines);
+    double ref_sec = now_sec() - r0;
+
+    Topology topo;
+    double t0 = now_sec();
+    read_topology(filename, &topo);
+    double t1 = now_sec();
+    double sec = t1 - t0;
+
+    if (ref_nodes != topo.node_count) {
+        die("Referentno i mapirano citanje daju razlicit broj cvorova");
+    }
+    printf("Parse (fgets + malloc): %zu linija, %zu cvorova, %.3f s, %.0f linija/s, %.1f MB/s\n",
+        ref_lines, ref_nodes, ref_sec,
+        ref_sec > 0 ? (double)ref_lines / ref_sec : 0.0,
+        ref_sec > 0 ? (double)topo.src.len / ref_sec / 1e6 : 0.0);
+    printf("Parse: %zu linija, %zu cvorova, %.3f s, %.0f linija/s, %.1f MB/s (%.2fx)\n",
+        topo.line_count, topo.node_count, sec,
+        sec > 0 ? (double)topo.line_count / sec : 0.0,
+        sec > 0 ? (double)topo.src.len / sec / 1e6 : 0.0,
+        sec > 0 ? ref_sec / sec : 0.0);
+
+    if (threads > 1) {
+        Topology par;
+        double t2 = now_sec();
+        read_topology_parallel(filename, &par, threads);
+        double t3 = now_sec();
+        double psec = t3 - t2;
+        printf("Parse (%d niti): %.3f s, %.0f linija/s, %.1f MB/s (%.2fx)\n",
+            threads, psec,
+            psec > 0 ? (double)par.line_count / psec : 0.0,
+            psec > 0 ? (double)par.src.len / psec / 1e6 : 0.0,
+            psec > 0 ? sec / psec : 0.0);
+
+        // isto stablo <=> isti preorder nizovi
+        FlatTopo a, b;
+        flat_compile(topo.root, topo.node_count, &a);
+        flat_compile(par.root, par.node_count, &b);
+        size_t n = (size_t)a.n;
+        if (a.n != b.n || par.line_count != topo.line_count ||
+            memcmp(a.type, b.type, n) != 0 || memcmp(a.parent, b.parent, n * sizeof(int32_t)) != 0 ||
+            memcmp(a.end, b.end, n * sizeof(int32_t)) != 0 || memcmp(a.ont_id, b.ont_id, n * sizeof(int32_t)) != 0 ||
+            memcmp(a.link_loss, b.link_loss, n * sizeof(double)) != 0) {
+            die("Paralelno i slijedno citanje daju razlicito stablo");
+        }
+        flat_free(&a);
+        flat_free(&b);
+        topology_free(&par);
+    }
+
+    topology_free(&topo);
+}
+
+// splitmix64: mali, brzi i potpuno određen generator (ista sjemenka -> ista topologija)
+static uint64_t gen_next(uint64_t* s) {
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static double gen_uniform(uint64_t* s, double lo, double hi) {
+    return lo + (hi - lo) * (double)(gen_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static GenParams gen_params_default(void) {
+    GenParams gp;
+    gp.onts = 100000;
+    gp.seed = 1;
+    gp.olts = 1;
+    gp.depth = 2;
+    gp.fanout = 4;
+    // uz depth=2 ukupni omjer ide do 1:256; s 1:32 po razini gotovo ništa ne bi prošlo rxmin
+    gp.ratios[0] = 4;
+    gp.ratios[1] = 8;
+    gp.ratios[2] = 16;
+    gp.ratio_n = 3;
+    gp.faults = 0.01;
+    gp.tx_dbm = 3.0;
+    gp.rxmin_dbm = -27.0;
+    return gp;
+}
+
+static void gen_params_parse(GenParams* gp, const char* s) {
+    const char* end = s + strlen(s);
+    const char *key, *val, *val_end;
+    size_t key_len;
+    while (next_kv(&s, end, &key, &key_len, &val, &val_end)) {
+        if (key_len == 4 && memcmp(key, "onts", 4) == 0) {
+            gp->onts = (long)parse_double(val, val_end);    // dopušta i 1e7
+        } else if (key_len == 4 && memcmp(key, "seed", 4) == 0) {
+            gp->seed = (uint64_t)parse_double(val, val_end);
+        } else if (key_len == 4 && memcmp(key, "olts", 4) == 0) {
+            gp->olts = parse_int(val, val_end);
+        } else if (key_len == 5 && memcmp(key, "depth", 5) == 0) {
+            gp->depth = parse_int(val, val_end);
+        } else if (key_len == 6 && memcmp(key, "fanout", 6) == 0) {
+            gp->fanout = parse_int(val, val_end);
+        } else if (key_len == 6 && memcmp(key, "faults", 6) == 0) {
+            gp->faults = parse_double(val, val_end);
+        } else if (key_len == 2 && memcmp(key, "tx", 2) == 0) {
+            gp->tx_dbm = parse_double(val, val_end);
+        } else if (key_len == 5 && memcmp(key, "rxmin", 5) == 0) {
+            gp->rxmin_dbm = parse_double(val, val_end);
+        } else if (key_len == 6 && memcmp(key, "ratios", 6) == 0) {
+            // "8,16,32"
+            gp->ratio_n = 0;
+            const char* a = val;
+            while (a < val_end && gp->ratio_n < 8) {
+                const char* b = a;
+                while (b < val_end && *b != ',') b++;
+                int r = parse_int(a, b);
+                if (r > 0) gp->ratios[gp->ratio_n++] = r;
+                a = (b < val_end) ? b + 1 : b;
+            }
+        }
+    }
+    if (gp->onts < 1 || gp->olts < 1 || gp->fanout < 1 || gp->ratio_n < 1) {
+        die("Neispravni parametri generatora topologije");
+    }
+    if (gp->depth < 1 || gp->depth > GEN_MAX_DEPTH) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "depth generatora mora biti izmedu 1 i %d", GEN_MAX_DEPTH);
+        die(msg);
+    }
+}
+
+static void gen_flush(GenCtx* g, int force) {
+    if (g->buf.len >= CSV_FLUSH_BYTES || (force && g->buf.len)) {
+        if (fwrite(g->buf.data, 1, g->buf.len, g->f) != g->buf.len) {
+            die("Greska pri pisanju generirane topologije");
+        }
+        g->buf.len = 0;
+    }
+}
+
+// splitter na razini level (1 = dijete OLT-a); na zadnjoj razini dobiva ratio ONT-ova
+static void gen_splitter(GenCtx* g, int level, const char* prefix, int idx) {
+    const GenParams* gp = g->gp;
+    char name[GEN_NAME_MAX];    // dovoljno za GEN_MAX_DEPTH razina pa se imena ne krate (ni ne sudaraju)
+    snprintf(name, sizeof(name), "%s%s%d", prefix, level > 1 ? "_" : "S", idx);
+    int ratio = gp->ratios[gen_next(&g->rng) % (uint64_t)gp->ratio_n];
+
+    char line[2 * GEN_MAX_DEPTH + GEN_NAME_MAX + 128];
+    int len = snprintf(line, sizeof(line), "%*sSPLITTER name=%s ratio=%d len=%.2f conn=2 sp=%d",
+        level * 2, "", name, ratio, gen_uniform(&g->rng, 0.2, 3.0), (int)(gen_next(&g->rng) % 5));
+    if (gen_uniform(&g->rng, 0.0, 1.0) < gp->faults) {
+        len += snprintf(line + len, sizeof(line) - (size_t)len, " faulty=1 extra=%.1f", gen_uniform(&g->rng, 3.0, 20.0));
+    }
+    line[len++] = '\n';
+    textbuf_append(&g->buf, line, (size_t)len);
+
+    if (level < gp->depth) {
+        for (int c = 1; c <= gp->fanout && g->ont_left > 0; c++) {
+            gen_splitter(g, level + 1, name, c);
+        }
+        return;
+    }
+    for (int j = 0; j < ratio && g->ont_left > 0; j++) {
+        len = snprintf(line, sizeof(line), "%*sONT id=%ld len=%.2f conn=1 sp=%d",
+            (level + 1) * 2, "", g->next_id++, gen_uniform(&g->rng, 0.1, 2.0), (int)(gen_next(&g->rng) % 5));
+        if (gen_uniform(&g->rng, 0.0, 1.0) < gp->faults) {
+            len += snprintf(line + len, sizeof(line) - (size_t)len, " faulty=1 extra=%.1f", gen_uniform(&g->rng, 3.0, 20.0));
+        }
+        line[len++] = '\n';
+        textbuf_append(&g->buf, line, (size_t)len);
+        g->ont_left--;
+    }
+    gen_flush(g, 0);
+}
+
+// determinističan generator OLT/SPLITTER/ONT stabla u istom formatu kao ftth_topology.txt
+static void gen_topology(const char* filename, const GenParams* gp) {
+    GenCtx g;
+    g.gp = gp;
+    g.rng = gp->seed;
+    g.next_id = 1;
+    g.buf.data = NULL;
+    g.buf.len = 0;
+    g.buf.cap = 0;
+    g.f = fopen(filename, "wb");
+    if (!g.f) {
+        die("Nemoguce je stvoriti datoteku generirane topologije");
+    }
+
+    char line[128];
+    for (int o = 0; o < gp->olts; o++) {
+        g.ont_left = gp->onts / gp->olts + (o < gp->onts % gp->olts ? 1 : 0);
+        int len = snprintf(line, sizeof(line), "OLT tx=%.1f rxmin=%.1f\n", gp->tx_dbm, gp->rxmin_dbm);
+        textbuf_append(&g.buf, line, (size_t)len);
+
+        char prefix[32];
+        if (gp->olts > 1) {
+            snprintf(prefix, sizeof(prefix), "O%d", o + 1);
+        } else {
+            prefix[0] = '\0';
+        }
+        for (int s = 1; g.ont_left > 0; s++) {
+            gen_splitter(&g, 1, prefix, s);
+        }
+    }
+    gen_flush(&g, 1);
+    fclose(g.f);
+    free(g.buf.data);
+}
+
+// najveća zauzeta fizička memorija procesa do sada (0 ako nije dostupno)
+static size_t peak_rss_bytes(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return (size_t)pmc.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)ru.ru_maxrss;            // macOS: bajtovi
+#else
+    return (size_t)ru.ru_maxrss * 1024;     // Linux: KiB
+#endif
+#endif
+}
+
+// vrijeme svake faze normalnog pokretanja: parse, compile, evaluate (bez izlaza), sort TOP-N,
+// write (evaluacija s ispisom CSV-a u BENCH_NULL_FILE). Ukupno vrijeme broji evaluaciju jednom:
+// parse + compile + write + sort, kao u normalnom pokretanju.
+static void bench_phases(const char* filename, int threads, int bg_writer, BenchTimes* bt) {
+    memset(bt, 0, sizeof(*bt));
+    double t0 = now_sec();
+    Topology topo;
+    read_topology_parallel(filename, &topo, threads);
+    double t1 = now_sec();
+
+    FlatTopo ft;
+    flat_compile(topo.root, topo.node_count, &ft);
+    arena_release(&topo.arena);
+    topo.root = NULL;
+    double t2 = now_sec();
+
+    SplitterList splitters;
+    splitter_list_init(&splitters);
+    TopN top;
+    topn_init(&top, TOP_N);
+    EvalSink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.splitters = &splitters;
+    sink.top = &top;
+    if (threads > 1) {
+        flat_evaluate_parallel(&ft, threads, &sink);
+    } else {
+        flat_evaluate(&ft, &sink);
+    }
+    double t3 = now_sec();
+    topn_sort(&top);
+    double t4 = now_sec();
+
+    CsvWriter ont_csv;
+    csv_writer_open(&ont_csv, BENCH_NULL_FILE, bg_writer);
+    static const char ONT_CSV_HEADER[] = "ont_id,total_dist_km,total_loss_db,rx_dbm,margin_db,status,path\n";
+    csv_writer_append(&ont_csv, ONT_CSV_HEADER, sizeof(ONT_CSV_HEADER) - 1);
+    splitters.n = 0;
+    top.n = 0;
+    sink.csv = &ont_csv;
+    if (threads > 1) {
+        flat_evaluate_parallel(&ft, threads, &sink);
+    } else {
+        flat_evaluate(&ft, &sink);
+    }
+    csv_writer_close(&ont_csv);
+    write_splitter_csv(BENCH_NULL_FILE, &splitters);
+    double t5 = now_sec();
+
+    bt->parse = t1 - t0;
+    bt->compile = t2 - t1;
+    bt->evaluate = t3 - t2;
+    bt->sort = t4 - t3;
+    bt->write = t5 - t4;
+    bt->node_count = topo.node_count;
+    bt->ont_count = ft.ont_count;
+    bt->bytes = topo.src.len;
+
+    free(top.arr);
+    free(splitters.arr);
+    flat_free(&ft);
+    unmap_file(&topo.src);
+}
+
+static double bench_total(const BenchTimes* bt) {
+    return bt->parse + bt->compile + bt->write + bt->sort;
+}
+
+static void bench_print(const BenchTimes* bt) {
+    double m = (double)bt->ont_count;
+    double total = bench_total(bt);
+    printf("Cvorova: %zu, ONT: %d, ulaz: %.1f MB\n", bt->node_count, bt->ont_count, (double)bt->bytes / 1e6);
+    printf("parse:    %8.4f s  (%.1f MB/s)\n", bt->parse, bt->parse > 0 ? (double)bt->bytes / bt->parse / 1e6 : 0.0);
+    printf("compile:  %8.4f s\n", bt->compile);
+    printf("evaluate: %8.4f s  (%.2f M ONT/s)\n", bt->evaluate, bt->evaluate > 0 ? m / bt->evaluate / 1e6 : 0.0);
+    printf("sort:     %8.4f s\n", bt->sort);
+    printf("write:    %8.4f s  (%.2f M ONT/s, evaluacija + CSV)\n", bt->write, bt->write > 0 ? m / bt->write / 1e6 : 0.0);
+    printf("ukupno:   %8.4f s  (%.2f M ONT/s, parse + compile + write + sort)\n", total, total > 0 ? m / total / 1e6 : 0.0);
+    printf("Peak RSS: %.1f MB\n", (double)peak_rss_bytes() / 1e6);
+}
+
+// skaliranje: za svaku veličinu generira topologiju (ostali parametri iz --gen-opts), mjeri faze
+// i briše je. Peak RSS je za cijeli proces pa veličine treba zadati uzlazno.
+static void bench_scale(const char* sizes, const GenParams* base, int threads, int bg_writer) {
+    printf("%10s %9s %9s %9s %9s %9s %12s %10s\n",
+        "ONT", "parse_s", "compile_s", "eval_s", "sort_s", "write_s", "ONT/s", "peak_MB");
+    const char* p = sizes;
+    const char* end = sizes + strlen(sizes);
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ',')) p++;
+        const char* q = p;
+        while (q < end && *q != ' ' && *q != ',') q++;
+        if (q == p) break;
+
+        GenParams gp = *base;
+        gp.onts = (long)parse_double(p, q);
+        p = q;
+        if (gp.onts < 1) continue;
+
+        char filename[64];
+        snprintf(filename, sizeof(filename), "bench_%ld.txt", gp.onts);
+        gen_topology(filename, &gp);
+        BenchTimes bt;
+        bench_phases(filename, threads, bg_writer, &bt);
+        remove(filename);
+
+        double total = bench_total(&bt);
+        printf("%10d %9.4f %9.4f %9.4f %9.4f %9.4f %12.0f %10.1f\n",
+            bt.ont_count, bt.parse, bt.compile, bt.evaluate, bt.sort, bt.write,
+            total > 0 ? (double)bt.ont_count / total : 0.0, (double)peak_rss_bytes() / 1e6);
+    }
+}
+
+void generate_report(const SubtreeStats* stats, const OltSummary* olts, int olt_n, char (*top_paths)[512]) {
+    FILE* f = fopen("report.txt", "w");
+    if (!f) return;
+
+    fprintf(f, "FTTH/GPON SIMULATION REPORT\n\n");
+    if (olt_n == 1) {
+        fprintf(f, "OLT TX power: %.2f dBm\n", olts[0].tx_dbm);
+        fprintf(f, "GPON RX minimum: %.2f dBm\n\n", olts[0].rxmin_dbm);
+    } else {
+        for (int i = 0; i < olt_n; i++) {
+            const OltSummary* o = &olts[i];
+            fprintf(f, "OLT#%d TX power: %.2f dBm | GPON RX minimum: %.2f dBm | ONT: %d OK: %d FAIL: %d DOWN: %d\n",
+                o->olt, o->tx_dbm, o->rxmin_dbm, o->st.ont_count, o->st.ok_count, o->st.fail_count, o->st.down_count);
+        }
+        fprintf(f, "\n");
+    }
+
+    fprintf(f, "Total ONT count: %d\n", stats->ont_count);
+    fprintf(f, "OK connections: %d\n", stats->ok_count);
+    fprintf(f, "FAIL connections: %d\n", stats->fail_count);
+    fprintf(f, "DOWN connections: %d\n\n", stats->down_count);
+
+    fprintf(f, "Best RX power: %.2f dBm\n", stats->best_rx);
+    fprintf(f, "Worst RX power: %.2f dBm\n", stats->worst_rx);
+    fprintf(f, "Average RX power: %.2f dBm\n\n",
+            stats->sum_rx / stats->ont_count);
+
+    fprintf(f, "TOP %d worst ONT connections (by margin):\n", ont_top.cap);
+    for (int i = 0; i < ont_top.n; i++) {
+        fprintf(
+            f,
+            "ONT %d | margin = %.2f dB | RX = %.2f dBm | %s\n",
+            ont_top.arr[i].ont_id,
+            ont_top.arr[i].margin_db,
+            ont_top.arr[i].rx_dbm,
+            top_paths[i]
+        );
+    }
+
+    fprintf(f, "\nZakljucak:\n");
+    fprintf(f, "Veliki omjer dijeljenja(split ratio) i dugacke opticke udaljenosti smanjuju opticku marginu.\n");
+    fprintf(f, "Kriticni dijelovi mreze bi se trebali pratiti i sanirti po potrebi!\n");
+
+    STATS_FILE("report.txt", ftell(f));
+    fclose(f);
+}